@@ -35,6 +35,7 @@
  */
 typedef struct _cb		CB;
 typedef struct _csc		CSC;
+typedef struct _csr		CSR;
 typedef struct _conv	    	CONV;
 typedef struct _conv_win    	CONVWIN;
 typedef struct _event		EVENT;
@@ -42,14 +43,20 @@ typedef struct _excmd		EXCMD;
 typedef struct _exf		EXF;
 typedef struct _fref		FREF;
 typedef struct _gs		GS;
+typedef struct _lcache		LCACHE;
+typedef struct _lcline		LCLINE;
 typedef struct _lmark		LMARK;
 typedef struct _mark		MARK;
+typedef struct _miblk		MIBLK;
+typedef struct _mindex		MINDEX;
 typedef struct _msg		MSGS;
 typedef struct _option		OPTION;
 typedef struct _optlist		OPTLIST;
+typedef struct _rcvsnap		RCVSNAP;
 typedef struct _scr		SCR;
 typedef struct _script		SCRIPT;
 typedef struct _seq		SEQ;
+typedef struct _seqnode		SEQNODE;
 typedef struct _tag		TAG;
 typedef struct _tagf		TAGF;
 typedef struct _tagq		TAGQ;
@@ -100,6 +107,8 @@ typedef enum { SEQ_ABBREV, SEQ_COMMAND, SEQ_INPUT } seq_t;
 #include "gs.h"			/* Required by screen.h. */
 #include "log.h"		/* Required by screen.h */
 #include "screen.h"		/* Required by exf.h. */
+#include "lcache.h"		/* Required by exf.h. */
+#include "mindex.h"		/* Required by exf.h. */
 #include "exf.h"
 #include "mem.h"
 #ifndef USE_BUNDLED_DB
@@ -27,7 +27,8 @@ static const char sccsid[] = "$Id: cut.c,v 10.18 2001/06/25 15:19:09 skimo Exp $
 
 #include "common.h"
 
-static void	cb_rotate __P((SCR *));
+static void	*cb_alloc __P((SCR *, CBMEM **, size_t, size_t, size_t));
+static void	 cb_rotate __P((SCR *));
 
 /*
  * cut --
@@ -125,11 +126,8 @@ copyloop:
 		cbp->name = name;
 		CIRCLEQ_INIT(&cbp->textq);
 		LIST_INSERT_HEAD(&sp->wp->cutq, cbp, q);
-	} else if (!append) {
-		text_lfree(&cbp->textq);
-		cbp->len = 0;
-		cbp->flags = 0;
-	}
+	} else if (!append)
+		cut_free(cbp);
 
 
 #define	ENTIRE_LINE	0
@@ -176,9 +174,7 @@ copyloop:
 	return (0);
 
 cut_line_err:	
-	text_lfree(&cbp->textq);
-	cbp->len = 0;
-	cbp->flags = 0;
+	cut_free(cbp);
 	return (1);
 }
 
@@ -224,7 +220,7 @@ cb_rotate(SCR *sp)
 		}
 	if (del_cbp != NULL) {
 		LIST_REMOVE(del_cbp, q);
-		text_lfree(&del_cbp->textq);
+		cut_free(del_cbp);
 		free(del_cbp);
 	}
 }
@@ -246,20 +242,35 @@ cut_line(SCR *sp, db_recno_t lno, size_t fcno, size_t clen, CB *cbp)
 	if (db_get(sp, lno, DBG_FATAL, &p, &len))
 		return (1);
 
-	/* Create a TEXT structure that can hold the entire line. */
-	if ((tp = text_init(sp, NULL, 0, len)) == NULL)
-		return (1);
+	/* A length of 0 means the rest of the line. */
+	if (len == 0)
+		clen = 0;
+	else if (clen == 0)
+		clen = len - fcno;
 
 	/*
-	 * If the line isn't empty and it's not the entire line,
-	 * copy the portion we want, and reset the TEXT length.
+	 * Allocate a TEXT structure and room for the portion we want plus
+	 * a trailing <newline>.
 	 */
-	if (len != 0) {
-		if (clen == 0)
-			clen = len - fcno;
+#define	CB_TEXTMIN	(4 * sizeof(TEXT))
+#define	CB_TEXTMAX	(512 * sizeof(TEXT))
+#define	CB_LINEMIN	256
+#define	CB_LINEMAX	(64 * 1024)
+	if ((tp = cb_alloc(sp,
+	    &cbp->tmem, sizeof(TEXT), CB_TEXTMIN, CB_TEXTMAX)) == NULL)
+		return (1);
+	memset(tp, 0, sizeof(TEXT));
+	if ((tp->lb = cb_alloc(sp, &cbp->lmem,
+	    (clen + 1) * sizeof(CHAR_T), CB_LINEMIN, CB_LINEMAX)) == NULL)
+		return (1);
+	tp->lb_len = (clen + 1) * sizeof(CHAR_T);
+	if (clen != 0) {
 		MEMCPYW(tp->lb, p + fcno, clen);
-		tp->len = clen;
+		if (MEMCHR(tp->lb, '\n', clen) != NULL)
+			F_SET(cbp, CB_NEWLINE);
 	}
+	tp->lb[clen] = '\n';
+	tp->len = clen;
 
 	/* Append to the end of the cut buffer. */
 	CIRCLEQ_INSERT_TAIL(&cbp->textq, tp, q);
@@ -281,16 +292,68 @@ cut_close(WIN *wp)
 
 	/* Free cut buffer list. */
 	while ((cbp = wp->cutq.lh_first) != NULL) {
-		if (cbp->textq.cqh_first != (void *)&cbp->textq)
-			text_lfree(&cbp->textq);
+		cut_free(cbp);
 		LIST_REMOVE(cbp, q);
 		free(cbp);
 	}
 
 	/* Free default cut storage. */
-	cbp = &wp->dcb_store;
-	if (cbp->textq.cqh_first != (void *)&cbp->textq)
-		text_lfree(&cbp->textq);
+	cut_free(&wp->dcb_store);
+}
+
+/*
+ * cut_free --
+ *	Discard the contents of a cut buffer.
+ *
+ * PUBLIC: void cut_free __P((CB *));
+ */
+void
+cut_free(CB *cbp)
+{
+	CBMEM *mp;
+
+	while ((mp = cbp->tmem) != NULL) {
+		cbp->tmem = mp->next;
+		free(mp);
+	}
+	while ((mp = cbp->lmem) != NULL) {
+		cbp->lmem = mp->next;
+		free(mp);
+	}
+	CIRCLEQ_INIT(&cbp->textq);
+	cbp->len = 0;
+	cbp->flags = 0;
+}
+
+/*
+ * cb_alloc --
+ *	Allocate len bytes of cut buffer memory.  Each new block is twice
+ *	the size of the last one, between min and max bytes, so that small
+ *	cuts stay small and large ones need few blocks.
+ */
+static void *
+cb_alloc(SCR *sp, CBMEM **headp, size_t len, size_t min, size_t max)
+{
+	CBMEM *mp;
+	size_t size;
+	void *p;
+
+	if ((mp = *headp) == NULL || mp->size - mp->len < len) {
+		size = mp == NULL ? min :
+		    mp->size < max / 2 ? mp->size * 2 : max;
+		if (size < len)
+			size = len;
+		MALLOC(sp, mp, CBMEM *, sizeof(CBMEM) + size);
+		if (mp == NULL)
+			return (NULL);
+		mp->len = 0;
+		mp->size = size;
+		mp->next = *headp;
+		*headp = mp;
+	}
+	p = (char *)(mp + 1) + mp->len;
+	mp->len += len;
+	return (p);
 }
 
 /*
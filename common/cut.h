@@ -12,15 +12,32 @@
 typedef struct _texth TEXTH;		/* TEXT list head structure. */
 CIRCLEQ_HEAD(_texth, _text);
 
+/*
+ * Cut buffer memory.  The TEXT structures and lines of a cut buffer are
+ * carved out of a few large blocks, which are freed all at once.  Lines
+ * are stored one after another, each followed by a <newline>, so a run
+ * of them is a block of text that can be put into the file as a whole.
+ */
+typedef struct _cbmem CBMEM;
+struct _cbmem {
+	CBMEM	*next;			/* Next (older) block. */
+	size_t	 len;			/* Bytes used. */
+	size_t	 size;			/* Bytes in the block. */
+	/* The block follows the structure. */
+};
+
 /* Cut buffers. */
 struct _cb {
 	LIST_ENTRY(_cb) q;		/* Linked list of cut buffers. */
 	TEXTH	 textq;			/* Linked list of TEXT structures. */
+	CBMEM	*tmem;			/* TEXT structure memory. */
+	CBMEM	*lmem;			/* Line memory. */
 	/* XXXX Needed ? Can non ascii-chars be cut buffer names ? */
 	CHAR_T	 name;			/* Cut buffer name. */
 	size_t	 len;			/* Total length of cut text. */
 
 #define	CB_LMODE	0x01		/* Cut was in line mode. */
+#define	CB_NEWLINE	0x02		/* A line contains a <newline>. */
 	u_int8_t flags;
 };
 
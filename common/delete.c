@@ -43,13 +43,9 @@ del(SCR *sp, MARK *fm, MARK *tm, int lmode)
 
 	/* Case 1 -- delete in line mode. */
 	if (lmode) {
-		for (lno = tm->lno; lno >= fm->lno; --lno) {
-			if (db_delete(sp, lno))
-				return (1);
-			++sp->rptlines[L_DELETED];
-			if (lno % INTERRUPT_CHECK == 0 && INTERRUPTED(sp))
-				break;
-		}
+		if (db_delete_block(sp, fm->lno, tm->lno - fm->lno + 1))
+			return (1);
+		sp->rptlines[L_DELETED] += tm->lno - fm->lno + 1;
 		goto done;
 	}
 
@@ -67,14 +63,9 @@ del(SCR *sp, MARK *fm, MARK *tm, int lmode)
 		} else
 			eof = 1;
 		if (eof) {
-			for (lno = tm->lno; lno > fm->lno; --lno) {
-				if (db_delete(sp, lno))
-					return (1);
-				++sp->rptlines[L_DELETED];
-				if (lno %
-				    INTERRUPT_CHECK == 0 && INTERRUPTED(sp))
-					break;
-			}
+			if (db_delete_block(sp, fm->lno + 1, tm->lno - fm->lno))
+				return (1);
+			sp->rptlines[L_DELETED] += tm->lno - fm->lno;
 			if (db_get(sp, fm->lno, DBG_FATAL, &p, &len))
 				return (1);
 			GET_SPACE_RETW(sp, bp, blen, fm->cno);
@@ -141,13 +132,9 @@ del(SCR *sp, MARK *fm, MARK *tm, int lmode)
 		goto err;
 
 	/* Delete the last and intermediate lines. */
-	for (lno = tm->lno; lno > fm->lno; --lno) {
-		if (db_delete(sp, lno))
-			goto err;
-		++sp->rptlines[L_DELETED];
-		if (lno % INTERRUPT_CHECK == 0 && INTERRUPTED(sp))
-			break;
-	}
+	if (db_delete_block(sp, fm->lno + 1, tm->lno - fm->lno))
+		goto err;
+	sp->rptlines[L_DELETED] += tm->lno - fm->lno;
 
 done:	rval = 0;
 	if (0)
@@ -37,11 +37,13 @@ static const char sccsid[] = "$Id: exf.c,v 10.72 2003/08/10 09:44:01 skimo Exp $
 #include <time.h>
 
 #include "common.h"
+#include "../vi/vi.h"
 
 static int	file_backup __P((SCR *, char *, char *));
 static void	file_cinit __P((SCR *));
 static void	file_comment __P((SCR *));
 static int	file_spath __P((SCR *, FREF *, struct stat *, int *));
+static int	file_wtmp __P((SCR *, char *, char **));
 
 /*
  * file_add --
@@ -176,13 +178,17 @@ file_init(SCR *sp, FREF *frp, char *rcv_name, int flags)
 
 	/*
 	 * Required EXF initialization:
-	 *	Flush the line caches.
+	 *	Set up the line cache, flush the line count cache.
 	 *	Default recover mail file fd to -1.
 	 *	Set initial EXF flag bits.
 	 */
 	CALLOC_RET(sp, ep, EXF *, 1, sizeof(EXF));
 	CIRCLEQ_INIT(&ep->scrq);
-	sp->c_lno = ep->c_nlines = OOBLNO;
+	if (lcache_init(sp, ep, O_VAL(sp, O_LINECACHE))) {
+		free(ep);
+		return (1);
+	}
+	ep->c_nlines = OOBLNO;
 	ep->rcv_fd = ep->fcntl_fd = -1;
 	F_SET(ep, F_FIRSTMODIFY);
 
@@ -248,6 +254,14 @@ file_init(SCR *sp, FREF *frp, char *rcv_name, int flags)
 			    "238|Warning: %s is not a regular file");
 	}
 
+	/*
+	 * The pagesize option, in kilobytes, overrides the guess.  DB page
+	 * offsets are 16 bits, so pages can't be larger than 32K.
+	 */
+	if (O_VAL(sp, O_PAGESIZE) != 0)
+		psize = (O_VAL(sp, O_PAGESIZE) > 32 ?
+		    32 : O_VAL(sp, O_PAGESIZE)) * 1024;
+
 	/* Set up recovery. */
 	if (rcv_name == NULL) {
 		/* ep->rcv_path NULL if rcv_tmp fails */
@@ -413,8 +427,13 @@ no_lock:
 	/* Report conversion errors again. */
 	F_CLR(sp, SC_CONV_ERROR);
 
-	/* Redraw the screen from scratch, schedule a welcome message. */
+	/*
+	 * Redraw the screen from scratch, schedule a welcome message.  The
+	 * screen's cached line layouts were for the old file.
+	 */
 	F_SET(sp, SC_SCR_REFORMAT | SC_STATUS);
+	if (sp->vi_private != NULL)
+		VI_SCR_CFLUSH(VIP(sp));
 
 	if (frp->lno == OOBLNO)
 		F_SET(sp, SC_SCR_TOP);
@@ -445,6 +464,11 @@ oerr:	if (F_ISSET(ep, F_RCV_ON))
 		(void)db_close(ep->db);
 		ep->db = NULL;
 	}
+	(void)lcache_end(sp, ep);
+	mindex_end(ep);
+
+	/* Finish any snapshot, keeping the last one. */
+	rcv_end(sp, ep);
 	free(ep);
 
 	return (open_err && !LF_ISSET(FS_OPENERR) ?
@@ -541,6 +565,9 @@ file_cinit(SCR *sp)
 	 * applied as well to files loaded using the tag commands, and we
 	 * follow that historic practice.  Also, all initial commands were
 	 * ex commands and were always executed on the last line of the file.
+	 * Finding the last line reads all of a file kept in the line store,
+	 * so a line number, e.g. "vi +10 file", which goes to the same line
+	 * from anywhere, is executed from the first line instead.
 	 *
 	 * Otherwise, if no initial command for this file:
 	 *    If in ex mode, move to the last line, first nonblank character.
@@ -555,11 +582,14 @@ file_cinit(SCR *sp)
 	nb = 0;
 	gp = sp->gp;
 	if (gp->c_option != NULL && !F_ISSET(sp->frp, FR_NEWFILE)) {
-		if (db_last(sp, &sp->lno))
-			return;
-		if (sp->lno == 0) {
-			sp->lno = 1;
-			sp->cno = 0;
+		len = strspn(gp->c_option, "0123456789");
+		if (len == 0 || gp->c_option[len] != '\0') {
+			if (db_last(sp, &sp->lno))
+				return;
+			if (sp->lno == 0) {
+				sp->lno = 1;
+				sp->cno = 0;
+			}
 		}
 		CHAR2INT(sp, gp->c_option, strlen(gp->c_option) + 1,
 			 wp, wlen);
@@ -709,6 +739,13 @@ file_end(SCR *sp, EXF *ep, int force)
 	/* Free up any marks. */
 	(void)mark_end(sp, ep);
 
+	/* Free up the line cache. */
+	(void)lcache_end(sp, ep);
+	mindex_end(ep);
+
+	/* Finish any snapshot, keeping the last one. */
+	rcv_end(sp, ep);
+
 	if (ep->env) {
 		DB_ENV *env;
 
@@ -772,10 +809,11 @@ file_write(SCR *sp, MARK *fm, MARK *tm, char *name, int flags)
 	FILE *fp;
 	FREF *frp;
 	MARK from, to;
+	db_recno_t lno;
 	size_t len;
 	u_long nlno, nch;
-	int fd, nf, noname, oflags, rval;
-	char *p, *s, *t, buf[MAXPATHLEN + 64];
+	int fd, nf, noname, oflags, rval, tmpwrite;
+	char *p, *s, *t, *tname, buf[MAXPATHLEN + 64];
 	const char *msgstr;
 
 	ep = sp->ep;
@@ -850,6 +888,13 @@ file_write(SCR *sp, MARK *fm, MARK *tm, char *name, int flags)
 		mtype = OLDFILE;
 	}
 
+	/*
+	 * The line store reads the file lazily; finish reading it before
+	 * it's truncated.
+	 */
+	if (db_last(sp, &lno))
+		return (1);
+
 	/* Set flags to create, write, and either append or truncate. */
 	oflags = O_CREAT | O_WRONLY |
 	    (LF_ISSET(FS_APPEND) ? O_APPEND : O_TRUNC);
@@ -859,9 +904,17 @@ file_write(SCR *sp, MARK *fm, MARK *tm, char *name, int flags)
 	    file_backup(sp, name, O_STR(sp, O_BACKUP)) && !LF_ISSET(FS_FORCE))
 		return (1);
 
-	/* Open the file. */
+	/*
+	 * Open the file.  If the "atomicwrite" option is set, and we're not
+	 * appending, write a temporary file and rename it to the file, so
+	 * that the file is never left partially written.
+	 */
+	tname = NULL;
 	SIGBLOCK;
-	if ((fd = open(name, oflags,
+	fd = O_ISSET(sp, O_ATOMICWRITE) && !LF_ISSET(FS_APPEND) ?
+	    file_wtmp(sp, name, &tname) : -1;
+	tmpwrite = fd != -1;
+	if (fd == -1 && (fd = open(name, oflags,
 	    S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)) < 0) {
 		msgq_str(sp, M_SYSERR, name, "%s");
 		SIGUNBLOCK;
@@ -899,6 +952,10 @@ file_write(SCR *sp, MARK *fm, MARK *tm, char *name, int flags)
 	if ((fp = fdopen(fd, LF_ISSET(FS_APPEND) ? "a" : "w")) == NULL) {
 		msgq_str(sp, M_SYSERR, name, "%s");
 		(void)close(fd);
+		if (tmpwrite) {
+			(void)unlink(tname);
+			free(tname);
+		}
 		return (1);
 	}
 
@@ -915,6 +972,31 @@ file_write(SCR *sp, MARK *fm, MARK *tm, char *name, int flags)
 
 	rval = ex_writefp(sp, name, fp, fm, tm, &nlno, &nch, 0);
 
+	/*
+	 * Replace the file with the temporary file, or discard it.  If the
+	 * file being edited was replaced, our lock is on the old file; lock
+	 * the new one.
+	 */
+	if (tmpwrite) {
+		if (!rval && rename(tname, name)) {
+			msgq_str(sp, M_SYSERR, name, "%s");
+			rval = 1;
+		}
+		if (rval)
+			(void)unlink(tname);
+		else if (noname && frp->tname == NULL && ep->fd != -1) {
+			(void)close(ep->fd);
+			if (ep->fcntl_fd != -1) {
+				(void)close(ep->fcntl_fd);
+				ep->fcntl_fd = -1;
+			}
+			if ((ep->fd = open(name, O_RDWR)) != -1)
+				(void)file_lock(sp,
+				    name, &ep->fcntl_fd, ep->fd, 1);
+		}
+		free(tname);
+	}
+
 	/*
 	 * Save the new last modification time -- even if the write fails
 	 * we re-init the time.  That way the user can clean up the disk
@@ -937,7 +1019,7 @@ file_write(SCR *sp, MARK *fm, MARK *tm, char *name, int flags)
 	 * complained about the actual error, reinforce it if data was lost.
 	 */
 	if (rval) {
-		if (!LF_ISSET(FS_APPEND))
+		if (!LF_ISSET(FS_APPEND) && !tmpwrite)
 			msgq_str(sp, M_ERR, name,
 			    "254|%s: WARNING: FILE TRUNCATED");
 		return (1);
@@ -1009,6 +1091,73 @@ file_write(SCR *sp, MARK *fm, MARK *tm, char *name, int flags)
 	return (0);
 }
 
+/*
+ * file_wtmp --
+ *	Create a temporary file in a file's directory, with the file's mode,
+ *	owner and group, to be renamed to the file once it's written.  Return
+ *	-1 if the file has to be written in place.
+ */
+static int
+file_wtmp(SCR *sp, char *name, char **tnamep)
+{
+	struct stat sb;
+	mode_t mode, omask;
+	size_t len;
+	int exists, fd;
+	char *p, *tname;
+
+	/*
+	 * Renaming over a symbolic link or a special file would replace it
+	 * with a regular file, and renaming over a file with other links
+	 * would break them.
+	 */
+	if (lstat(name, &sb)) {
+		if (errno != ENOENT)
+			return (-1);
+		exists = 0;
+	} else {
+		if (!S_ISREG(sb.st_mode) || sb.st_nlink > 1)
+			return (-1);
+		exists = 1;
+	}
+
+	/* The temporary file is ".name.XXXXXX", next to the file. */
+	len = strlen(name) + sizeof(".XXXXXX") + 1;
+	if ((tname = malloc(len)) == NULL)
+		return (-1);
+	if ((p = strrchr(name, '/')) == NULL)
+		p = name;
+	else
+		++p;
+	(void)snprintf(tname, len, "%.*s.%s.XXXXXX", (int)(p - name), name, p);
+	if ((fd = mkstemp(tname)) == -1) {
+		free(tname);
+		return (-1);
+	}
+
+	/* Chown first, it may clear the setuid and setgid bits. */
+	if (exists) {
+		if ((sb.st_uid != geteuid() || sb.st_gid != getegid()) &&
+		    fchown(fd, sb.st_uid, sb.st_gid))
+			goto err;
+		mode = sb.st_mode & 07777;
+	} else {
+		omask = umask(0);
+		(void)umask(omask);
+		mode = (S_IRUSR | S_IWUSR |
+		    S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH) & ~omask;
+	}
+	if (fchmod(fd, mode))
+		goto err;
+	*tnamep = tname;
+	return (fd);
+
+err:	(void)close(fd);
+	(void)unlink(tname);
+	free(tname);
+	return (-1);
+}
+
 /*
  * file_backup --
  *	Backup the about-to-be-written file.
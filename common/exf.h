@@ -23,6 +23,12 @@ struct _exf {
 	char	*env_path;		/* DB environment directory. */
 	DB	*db;			/* File db structure. */
 	db_recno_t	 c_nlines;	/* Cached lines in the file. */
+	LCACHE	 lcache;		/* Line cache. */
+	MINDEX	 mindex;		/* Motion index. */
+
+	int	 batch;			/* Batching line changes. */
+	db_recno_t	 b_start;	/* Batch: first replaced line. */
+	db_recno_t	 b_stop;	/* Batch: last replaced line. */
 
 	DB	*log;			/* Log db structure. */
 	db_recno_t	 l_high;	/* Log last + 1 record number. */
@@ -36,6 +42,14 @@ struct _exf {
 	dir_t	 lundo;			/* Last undo direction. */
 	WIN	*l_win;			/* Window owning transaction. */
 
+	char	*l_pend;		/* Log: pending line changes. */
+	size_t	 l_pendlen;		/* Log: pending line changes length. */
+	size_t	 l_pendblen;		/* Log: pending buffer length. */
+	CHAR_T	*l_bline;		/* Log: line before the change. */
+	size_t	 l_blinelen;		/* Log: line before the change length. */
+	size_t	 l_blineblen;		/* Log: line buffer length. */
+	db_recno_t	 l_blno;	/* Log: line before the change number. */
+
 	LIST_HEAD(_markh, _lmark) marks;/* Linked list of file MARK's. */
 
 	/*
@@ -57,13 +71,13 @@ struct _exf {
 	char	*rcv_path;		/* Recover file name. */
 	char	*rcv_mpath;		/* Recover mail file name. */
 	int	 rcv_fd;		/* Locked mail file descriptor. */
+	RCVSNAP	*rcv_snap;		/* Snapshot (:preserve) state. */
 
 	void	*lock;			/* Lock for log. */
 
 #define	F_DEVSET	0x001		/* mdev/minode fields initialized. */
 #define	F_FIRSTMODIFY	0x002		/* File not yet modified. */
 #define	F_MODIFIED	0x004		/* File is currently dirty. */
-#define	F_MULTILOCK	0x008		/* Multiple processes running, lock. */
 #define	F_NOLOG		0x010		/* Logging turned off. */
 #define	F_RCV_NORM	0x020		/* Don't delete recovery files. */
 #define	F_RCV_ON	0x040		/* Recovery is possible. */
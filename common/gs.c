@@ -120,7 +120,7 @@ win_end(WIN *wp)
 	cut_close(wp);
 
 	/* Free default buffer storage. */
-	(void)text_lfree(&wp->dcb_store.textq);
+	cut_free(&wp->dcb_store);
 
 #if defined(DEBUG) || defined(PURIFY) || defined(LIBRARY)
 	/* Free any temporary space. */
@@ -87,9 +87,8 @@ struct _gs {
 	FILE	*tracefp;		/* Trace file pointer. */
 #endif
 
-#define	MAX_BIT_SEQ	128		/* Max + 1 fast check character. */
 	LIST_HEAD(_seqh, _seq) seqq;	/* Linked list of maps, abbrevs. */
-	bitstr_t bit_decl(seqb, MAX_BIT_SEQ);
+	SEQNODE	seqt[SEQ_NTYPES];	/* Map, abbrev tries, by seq_t. */
 
 #define	MAX_FAST_KEY	255		/* Max fast check character.*/
 #define	KEY_LEN(sp, ch)							\
@@ -178,6 +177,9 @@ struct _gs {
 	void	*th_private;
 
 	int	(*run) __P((WIN *, void *(*)(void*), void *));
+					/* Run several, wait for them all. */
+	int	(*run_wait) __P((WIN *, void *(*)(void*), void **, int));
+	int	 nthreads;		/* Threads worth running at once. */
 
 	int	(*lock_init) __P((WIN *, void **));
 #define LOCK_INIT(wp,s)							    \
@@ -185,6 +187,9 @@ struct _gs {
 	int	(*lock_try) __P((WIN *, void **));
 #define LOCK_TRY(wp,s)							    \
 	wp->gp->lock_try(wp, &s->lock)
+	int	(*lock_lock) __P((WIN *, void **));
+#define LOCK_LOCK(wp,s)							    \
+	wp->gp->lock_lock(wp, &s->lock)
 	int	(*lock_unlock) __P((WIN *, void **));
 #define LOCK_UNLOCK(wp,s)						    \
 	wp->gp->lock_unlock(wp, &s->lock)
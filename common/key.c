@@ -529,6 +529,7 @@ v_event_get(SCR *sp, EVENT *argp, int timeout, u_int32_t flags)
 	EVENT *evp, ev;
 	GS *gp;
 	SEQ *qp;
+	SEQNODE *np;
 	int init_nomap, ispartial, istimeout, remap_cnt;
 	WIN *wp;
 
@@ -540,6 +541,7 @@ v_event_get(SCR *sp, EVENT *argp, int timeout, u_int32_t flags)
 		argp = &ev;
 
 retry:	istimeout = remap_cnt = 0;
+	np = NULL;
 
 	/*
 	 * If the queue isn't empty and we're timing out for characters,
@@ -625,12 +627,15 @@ newmap:	evp = &wp->i_event[wp->i_next];
 	 * return it forthwith.
 	 */
 	if (istimeout || FL_ISSET(evp->e_flags, CH_NOMAP) ||
-	    !LF_ISSET(EC_MAPCOMMAND | EC_MAPINPUT) ||
-	    evp->e_c < MAX_BIT_SEQ && !bit_test(gp->seqb, evp->e_c))
+	    !LF_ISSET(EC_MAPCOMMAND | EC_MAPINPUT))
 		goto nomap;
 
-	/* Search the map. */
-	qp = seq_find(sp, NULL, evp, NULL, wp->i_cnt,
+	/*
+	 * Search the map.  The search picks up where a partial match left
+	 * off, the characters it's already seen are still at the front of
+	 * the queue.
+	 */
+	qp = seq_find(sp, &np, evp, NULL, wp->i_cnt,
 	    LF_ISSET(EC_MAPCOMMAND) ? SEQ_COMMAND : SEQ_INPUT, &ispartial);
 
 	/*
@@ -725,6 +730,7 @@ not_digit:	argp->e_c = CH_NOT_DIGIT;
 		}
 		if (v_event_push(sp, NULL, qp->output, qp->olen, CH_MAPPED))
 			return (1);
+		np = NULL;
 		goto newmap;
 	}
 
@@ -0,0 +1,337 @@
+/*-
+ * Copyright (c) 1992, 1993, 1994
+ *	The Regents of the University of California.  All rights reserved.
+ * Copyright (c) 1992, 1993, 1994, 1995, 1996
+ *	Keith Bostic.  All rights reserved.
+ *
+ * See the LICENSE file for redistribution information.
+ */
+
+#include "config.h"
+
+#ifndef lint
+static const char sccsid[] = "$Id$";
+#endif /* not lint */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <bitstring.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+static LCLINE *lcache_find __P((LCACHE *, db_recno_t));
+
+/*
+ * The line cache holds the most recently retrieved lines of a file, in
+ * their internal representation, so that repainting a screen or moving
+ * back and forth between a few lines doesn't cost a database lookup and
+ * a character set conversion for each line.  It's shared by all of the
+ * screens editing the file.
+ *
+ * Lines are found through a hash table keyed by line number, and are
+ * reused in least recently used order.  When lines are inserted or
+ * deleted, the cached lines after the change are renumbered, like marks,
+ * rather than thrown away; that's O(cache size), but the cache is small.
+ *
+ * A line pointer returned by db_get() remains valid until the line is
+ * changed, or until the cache entry holding it is reused, i.e., until
+ * the "linecache" option's worth of other lines have been retrieved.
+ */
+
+/*
+ * lcache_init --
+ *	Set up the line cache.
+ *
+ * PUBLIC: int lcache_init __P((SCR *, EXF *, size_t));
+ */
+int
+lcache_init(SCR *sp, EXF *ep, size_t nlines)
+{
+	LCACHE *lcp;
+	LCLINE *lines, *lp;
+	struct _lchash *hash;
+	size_t cnt, hsize;
+
+	/*
+	 * !!!
+	 * ep MAY NOT BE THE SAME AS sp->ep, DON'T USE THE LATTER.
+	 *
+	 * The hash table is the smallest power of two holding every line.
+	 * Allocate before discarding any old cache, so a failure leaves the
+	 * old one in place.
+	 */
+	for (hsize = 1; hsize < nlines; hsize <<= 1)
+		continue;
+	CALLOC_RET(sp, lines, LCLINE *, nlines, sizeof(LCLINE));
+	CALLOC(sp, hash, struct _lchash *, hsize, sizeof(struct _lchash));
+	if (hash == NULL) {
+		free(lines);
+		return (1);
+	}
+
+	lcp = &ep->lcache;
+	(void)lcache_end(sp, ep);
+	lcp->lines = lines;
+	lcp->nlines = nlines;
+	lcp->hash = hash;
+	lcp->hmask = hsize - 1;
+
+	CIRCLEQ_INIT(&lcp->lru);
+	for (cnt = 0; cnt < hsize; ++cnt)
+		LIST_INIT(&hash[cnt]);
+	for (lp = lines, cnt = 0; cnt < nlines; ++cnt, ++lp) {
+		lp->lno = OOBLNO;
+		CIRCLEQ_INSERT_TAIL(&lcp->lru, lp, q);
+	}
+	return (0);
+}
+
+/*
+ * lcache_end --
+ *	Discard the line cache.
+ *
+ * PUBLIC: int lcache_end __P((SCR *, EXF *));
+ */
+int
+lcache_end(SCR *sp, EXF *ep)
+{
+	LCACHE *lcp;
+	LCLINE *lp;
+	size_t cnt;
+
+	/*
+	 * !!!
+	 * ep MAY NOT BE THE SAME AS sp->ep, DON'T USE THE LATTER.
+	 */
+	lcp = &ep->lcache;
+	if (lcp->lines != NULL) {
+		for (lp = lcp->lines, cnt = 0; cnt < lcp->nlines; ++cnt, ++lp)
+			if (lp->lp != NULL)
+				free(lp->lp);
+		free(lcp->lines);
+		lcp->lines = NULL;
+	}
+	if (lcp->hash != NULL) {
+		free(lcp->hash);
+		lcp->hash = NULL;
+	}
+	lcp->nlines = 0;
+	return (0);
+}
+
+/*
+ * lcache_get --
+ *	Look for a line in the line cache.
+ *
+ * PUBLIC: int lcache_get __P((EXF *, db_recno_t, CHAR_T **, size_t *));
+ */
+int
+lcache_get(EXF *ep, db_recno_t lno, CHAR_T **pp, size_t *lenp)
+{
+	LCACHE *lcp;
+	LCLINE *lp;
+
+	lcp = &ep->lcache;
+	if ((lp = lcache_find(lcp, lno)) == NULL)
+		return (1);
+
+	/* Move the line to the front of the LRU list. */
+	if (lp != lcp->lru.cqh_first) {
+		CIRCLEQ_REMOVE(&lcp->lru, lp, q);
+		CIRCLEQ_INSERT_HEAD(&lcp->lru, lp, q);
+	}
+	if (lenp != NULL)
+		*lenp = lp->len;
+	if (pp != NULL)
+		*pp = lp->lp;
+	return (0);
+}
+
+/*
+ * lcache_put --
+ *	Enter a line into the line cache, replacing any cached copy of the
+ *	line or, if there isn't one, the least recently used line.  Return
+ *	a pointer to the cached copy.
+ *
+ * PUBLIC: int lcache_put
+ * PUBLIC:    __P((SCR *, EXF *, db_recno_t, CHAR_T *, size_t, CHAR_T **));
+ */
+int
+lcache_put(SCR *sp, EXF *ep,
+    db_recno_t lno, CHAR_T *p, size_t len, CHAR_T **pp)
+{
+	LCACHE *lcp;
+	LCLINE *lp;
+
+	lcp = &ep->lcache;
+	if ((lp = lcache_find(lcp, lno)) == NULL)
+		lp = lcp->lru.cqh_last;
+	if (lp->lno != OOBLNO) {
+		LIST_REMOVE(lp, hq);
+		lp->lno = OOBLNO;
+	}
+
+	/*
+	 * Callers hand empty lines to routines, e.g. regexec(3), that don't
+	 * expect a NULL string, so always allocate something.
+	 */
+	BINC_RETW(sp, lp->lp, lp->blen, len == 0 ? 1 : len);
+	if (len != 0)
+		MEMCPYW(lp->lp, p, len);
+	lp->len = len;
+	lp->lno = lno;
+	LIST_INSERT_HEAD(LCACHE_HASH(lcp, lno), lp, hq);
+
+	if (lp != lcp->lru.cqh_first) {
+		CIRCLEQ_REMOVE(&lcp->lru, lp, q);
+		CIRCLEQ_INSERT_HEAD(&lcp->lru, lp, q);
+	}
+	if (pp != NULL)
+		*pp = lp->lp;
+	return (0);
+}
+
+/*
+ * lcache_insdel --
+ *	Update the line cache when a line is inserted, deleted or reset.
+ *	The line number is the number of the new, deleted or reset line.
+ *
+ * PUBLIC: void lcache_insdel __P((EXF *, lnop_t, db_recno_t));
+ */
+void
+lcache_insdel(EXF *ep, lnop_t op, db_recno_t lno)
+{
+	LCACHE *lcp;
+	LCLINE *lp;
+	size_t cnt;
+
+	lcp = &ep->lcache;
+	switch (op) {
+	case LINE_APPEND:
+	case LINE_INSERT:
+		lcache_ins(ep, lno, 1);
+		break;
+	case LINE_DELETE:
+		for (lp = lcp->lines, cnt = 0; cnt < lcp->nlines; ++cnt, ++lp)
+			if (lp->lno != OOBLNO && lp->lno >= lno) {
+				LIST_REMOVE(lp, hq);
+				if (lp->lno == lno) {
+					lp->lno = OOBLNO;
+					CIRCLEQ_REMOVE(&lcp->lru, lp, q);
+					CIRCLEQ_INSERT_TAIL(&lcp->lru, lp, q);
+				} else {
+					--lp->lno;
+					LIST_INSERT_HEAD(
+					    LCACHE_HASH(lcp, lp->lno), lp, hq);
+				}
+			}
+		break;
+	case LINE_RESET:
+		if ((lp = lcache_find(lcp, lno)) != NULL) {
+			LIST_REMOVE(lp, hq);
+			lp->lno = OOBLNO;
+			CIRCLEQ_REMOVE(&lcp->lru, lp, q);
+			CIRCLEQ_INSERT_TAIL(&lcp->lru, lp, q);
+		}
+		break;
+	}
+}
+
+/*
+ * lcache_ins --
+ *	Update the line cache when n lines are inserted, the first of them
+ *	as line lno.
+ *
+ * PUBLIC: void lcache_ins __P((EXF *, db_recno_t, db_recno_t));
+ */
+void
+lcache_ins(EXF *ep, db_recno_t lno, db_recno_t n)
+{
+	LCACHE *lcp;
+	LCLINE *lp;
+	size_t cnt;
+
+	lcp = &ep->lcache;
+	for (lp = lcp->lines, cnt = 0; cnt < lcp->nlines; ++cnt, ++lp)
+		if (lp->lno != OOBLNO && lp->lno >= lno) {
+			LIST_REMOVE(lp, hq);
+			lp->lno += n;
+			LIST_INSERT_HEAD(LCACHE_HASH(lcp, lp->lno), lp, hq);
+		}
+}
+
+/*
+ * lcache_del --
+ *	Update the line cache when n lines, starting with line lno, are
+ *	deleted.
+ *
+ * PUBLIC: void lcache_del __P((EXF *, db_recno_t, db_recno_t));
+ */
+void
+lcache_del(EXF *ep, db_recno_t lno, db_recno_t n)
+{
+	LCACHE *lcp;
+	LCLINE *lp;
+	size_t cnt;
+
+	lcp = &ep->lcache;
+	for (lp = lcp->lines, cnt = 0; cnt < lcp->nlines; ++cnt, ++lp)
+		if (lp->lno != OOBLNO && lp->lno >= lno) {
+			LIST_REMOVE(lp, hq);
+			if (lp->lno < lno + n) {
+				lp->lno = OOBLNO;
+				CIRCLEQ_REMOVE(&lcp->lru, lp, q);
+				CIRCLEQ_INSERT_TAIL(&lcp->lru, lp, q);
+			} else {
+				lp->lno -= n;
+				LIST_INSERT_HEAD(
+				    LCACHE_HASH(lcp, lp->lno), lp, hq);
+			}
+		}
+}
+
+/*
+ * lcache_flush --
+ *	Discard all of the cached lines, e.g., because the character set
+ *	conversion used to build them changed.
+ *
+ * PUBLIC: void lcache_flush __P((EXF *));
+ */
+void
+lcache_flush(EXF *ep)
+{
+	LCACHE *lcp;
+	LCLINE *lp;
+	size_t cnt;
+
+	lcp = &ep->lcache;
+	for (lp = lcp->lines, cnt = 0; cnt < lcp->nlines; ++cnt, ++lp)
+		if (lp->lno != OOBLNO) {
+			LIST_REMOVE(lp, hq);
+			lp->lno = OOBLNO;
+		}
+}
+
+/*
+ * lcache_find --
+ *	Return the cache entry for a line, if it's cached.
+ */
+static LCLINE *
+lcache_find(LCACHE *lcp, db_recno_t lno)
+{
+	LCLINE *lp;
+
+	if (lcp->nlines == 0)
+		return (NULL);
+	for (lp = LCACHE_HASH(lcp, lno)->lh_first;
+	    lp != NULL; lp = lp->hq.le_next)
+		if (lp->lno == lno)
+			return (lp);
+	return (NULL);
+}
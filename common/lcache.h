@@ -0,0 +1,40 @@
+/*-
+ * Copyright (c) 1992, 1993, 1994
+ *	The Regents of the University of California.  All rights reserved.
+ * Copyright (c) 1992, 1993, 1994, 1995, 1996
+ *	Keith Bostic.  All rights reserved.
+ *
+ * See the LICENSE file for redistribution information.
+ *
+ *	$Id$
+ */
+
+/*
+ * LCLINE --
+ *	A line in the per-file line cache.
+ */
+struct _lcline {
+	LIST_ENTRY(_lcline) hq;		/* Hash chain. */
+	CIRCLEQ_ENTRY(_lcline) q;	/* LRU list, most recent first. */
+	db_recno_t	 lno;		/* Line number, OOBLNO if unused. */
+	CHAR_T	*lp;			/* Line, in internal representation. */
+	size_t	 len;			/* Line length. */
+	size_t	 blen;			/* Line buffer length. */
+};
+
+/*
+ * LCACHE --
+ *	The per-file line cache, shared by all of the screens editing
+ *	the file.
+ */
+struct _lcache {
+	LCLINE	*lines;			/* Cache entries. */
+	size_t	 nlines;		/* Number of cache entries. */
+
+	LIST_HEAD(_lchash, _lcline) *hash;	/* Hash chains. */
+	db_recno_t	 hmask;		/* Hash table size - 1. */
+
+	CIRCLEQ_HEAD(_lclru, _lcline) lru;	/* LRU list. */
+};
+
+#define	LCACHE_HASH(lcp, lno)	(&(lcp)->hash[(lno) & (lcp)->hmask])
@@ -40,12 +40,27 @@ static const char sccsid[] = "$Id: log.c,v 10.26 2002/03/02 23:12:13 skimo Exp $
  *	LOG_LINE_RESET_F	db_recno_t		char *
  *	LOG_LINE_RESET_B	db_recno_t		char *
  *	LOG_MARK		LMARK
+ *	LOG_LINES		log_ent ...
  *
  * We do before image physical logging.  This means that the editor layer
  * MAY NOT modify records in place, even if simply deleting or overwriting
- * characters.  Since the smallest unit of logging is a line, we're using
- * up lots of space.  This may eventually have to be reduced, probably by
- * doing logical logging, which is a much cooler database phrase.
+ * characters.
+ *
+ * Since the smallest unit of logging is a line, that used up lots of
+ * space: changing one character of a long line logged the line twice.
+ * So appended, deleted and replaced lines are logged logically, as
+ * LOG_LINES records.  A LOG_LINES record holds a run of line changes,
+ * each a log_ent structure followed by the characters it deleted and the
+ * characters it inserted, followed by the size of the whole entry so the
+ * entries can be walked backward.  A replaced line is logged as the
+ * characters that changed between its common prefix and suffix with the
+ * line it replaced, so it's stored once, and only in part.  The line
+ * before a replacement is kept until the line after it is logged, and
+ * the changes are kept until the next record of another type is logged,
+ * or the LOG_LINES record grows to LOG_PENDMAX bytes, so a change of many
+ * lines is a few large records, not many small ones.  The LOG_LINE_*
+ * records holding whole lines are still written if the line before a
+ * replacement can't be kept, and can always be rolled forward and back.
  *
  * The implementation of the historic vi 'u' command, using roll-forward and
  * roll-back, is simple.  Each set of changes has a LOG_CURSOR_INIT record,
@@ -66,6 +81,10 @@ static const char sccsid[] = "$Id: log.c,v 10.26 2002/03/02 23:12:13 skimo Exp $
 static int	vi_log_get __P((SCR *sp, db_recno_t *lnop, size_t *size));
 static int	log_cursor1 __P((SCR *, int));
 static void	log_err __P((SCR *, char *, int));
+static int	log_flush __P((SCR *));
+static int	log_lines __P((SCR *, u_char *, size_t, undo_t));
+static int	log_lines_add __P((SCR *,
+		    u_int, db_recno_t, size_t, CHAR_T *, size_t, CHAR_T *, size_t));
 #if defined(DEBUG) && 0
 static void	log_trace __P((SCR *, char *, db_recno_t, u_char *));
 #endif
@@ -85,6 +104,28 @@ typedef struct {
 } log_t;
 #define CHAR_T_OFFSET ((char *)(((log_t*)0)->str) - (char *)0)
 
+/*
+ * A line change in a LOG_LINES record.  The entries are packed, so they're
+ * copied out of the record before they're used; the characters following
+ * them stay CHAR_T aligned.
+ */
+typedef struct {
+	db_recno_t lno;			/* Line number. */
+	size_t	 pre;			/* Unchanged leading characters. */
+	size_t	 dlen;			/* Characters deleted. */
+	size_t	 ilen;			/* Characters inserted. */
+	u_int	 type;			/* LOG_LINE_{APPEND_F,DELETE_B,RESET_F}. */
+} log_ent;
+typedef struct {
+    u_char  type;
+    log_ent ent[1];
+} log_lines_t;
+#define LINES_OFFSET ((char *)(((log_lines_t*)0)->ent) - (char *)0)
+#define	LOG_ENTSIZE(dlen, ilen)						\
+	(sizeof(log_ent) + ((dlen) + (ilen)) * sizeof(CHAR_T) + sizeof(size_t))
+
+#define	LOG_PENDMAX	(64 * 1024)	/* Largest pending LOG_LINES record. */
+
 /*
  * log_init --
  *	Initialize the logging subsystem.
@@ -107,6 +148,8 @@ log_init(SCR *sp, EXF *ep)
 	ep->l_cursor.lno = 1;		/* XXX Any valid recno. */
 	ep->l_cursor.cno = 0;
 	ep->l_high = ep->l_cur = 1;
+	ep->l_pendlen = 0;
+	ep->l_blno = OOBLNO;
 
 	if (db_create(&ep->log, 0, 0) != 0 ||
 	    db_open(ep->log, NULL, DB_RECNO,
@@ -145,6 +188,17 @@ log_end(SCR *sp, EXF *ep)
 		sp->wp->l_lp = NULL;
 	}
 	sp->wp->l_len = 0;
+	if (ep->l_pend != NULL) {
+		free(ep->l_pend);
+		ep->l_pend = NULL;
+	}
+	ep->l_pendlen = ep->l_pendblen = 0;
+	if (ep->l_bline != NULL) {
+		free(ep->l_bline);
+		ep->l_bline = NULL;
+	}
+	ep->l_blineblen = 0;
+	ep->l_blno = OOBLNO;
 	ep->l_cursor.lno = 1;		/* XXX Any valid recno. */
 	ep->l_cursor.cno = 0;
 	ep->l_high = ep->l_cur = 1;
@@ -201,6 +255,9 @@ log_cursor1(SCR *sp, int type)
 		return 1;
 	*/
 
+	if (log_flush(sp))
+		return (1);
+
 	BINC_RETC(sp, sp->wp->l_lp, sp->wp->l_len, sizeof(u_char) + sizeof(MARK));
 	sp->wp->l_lp[0] = type;
 	memmove(sp->wp->l_lp + sizeof(u_char), &ep->l_cursor, sizeof(MARK));
@@ -240,7 +297,7 @@ log_line(SCR *sp, db_recno_t lno, u_int action)
 {
 	DBT data, key;
 	EXF *ep;
-	size_t len;
+	size_t len, pre, suf;
 	CHAR_T *lp;
 	db_recno_t lcur;
 
@@ -290,9 +347,42 @@ log_line(SCR *sp, db_recno_t lno, u_int action)
 			len = 0;
 			lp = &nul;
 		}
+
+		/* Keep the line until the line after the change is logged. */
+		ep->l_blno = OOBLNO;
+		if ((ep->l_bline = binc(sp, ep->l_bline,
+		    &ep->l_blineblen, (len + 1) * sizeof(CHAR_T))) != NULL) {
+			MEMMOVEW(ep->l_bline, lp, len);
+			ep->l_blinelen = len;
+			ep->l_blno = lno;
+			return (0);
+		}
 	} else
 		if (db_get(sp, lno, DBG_FATAL, &lp, &len))
 			return (1);
+
+	/* Log the change, or the part of the line that changed. */
+	switch (action) {
+	case LOG_LINE_APPEND_F:
+		return (log_lines_add(sp, action, lno, 0, NULL, 0, lp, len));
+	case LOG_LINE_DELETE_B:
+		return (log_lines_add(sp, action, lno, 0, lp, len, NULL, 0));
+	case LOG_LINE_RESET_F:
+		if (ep->l_blno != lno)
+			break;
+		ep->l_blno = OOBLNO;
+		for (pre = 0; pre < len &&
+		    pre < ep->l_blinelen && lp[pre] == ep->l_bline[pre]; ++pre);
+		for (suf = 0; suf < len - pre && suf < ep->l_blinelen - pre &&
+		    lp[len - suf - 1] == ep->l_bline[ep->l_blinelen - suf - 1];
+		    ++suf);
+		return (log_lines_add(sp, action, lno, pre,
+		    ep->l_bline + pre, ep->l_blinelen - pre - suf,
+		    lp + pre, len - pre - suf));
+	}
+
+	if (log_flush(sp))
+		return (1);
 	BINC_RETC(sp,
 	    sp->wp->l_lp, sp->wp->l_len, 
 	    len * sizeof(CHAR_T) + CHAR_T_OFFSET);
@@ -344,6 +434,106 @@ log_line(SCR *sp, db_recno_t lno, u_int action)
 	return (0);
 }
 
+/*
+ * log_append --
+ *	Log a line appended as line lno, from the caller's copy of it, so
+ *	callers appending many lines don't read each one back to log it.
+ *
+ * PUBLIC: int log_append __P((SCR *, db_recno_t, CHAR_T *, size_t));
+ */
+int
+log_append(SCR *sp, db_recno_t lno, CHAR_T *p, size_t len)
+{
+	EXF *ep;
+
+	ep = sp->ep;
+	if (F_ISSET(ep, F_NOLOG))
+		return (0);
+
+	/* Kluge for vi, see log_line(). */
+	F_CLR(ep, F_UNDO);
+
+	/* Put out one initial cursor record per set of changes. */
+	if (ep->l_cursor.lno != OOBLNO) {
+		if (log_cursor1(sp, LOG_CURSOR_INIT))
+			return (1);
+		ep->l_cursor.lno = OOBLNO;
+		ep->l_win = sp->wp;
+	}
+	return (log_lines_add(sp, LOG_LINE_APPEND_F, lno, 0, NULL, 0, p, len));
+}
+
+/*
+ * log_lines_add --
+ *	Add a line change to the pending LOG_LINES record.
+ */
+static int
+log_lines_add(SCR *sp, u_int type, db_recno_t lno,
+    size_t pre, CHAR_T *dp, size_t dlen, CHAR_T *ip, size_t ilen)
+{
+	EXF *ep;
+	log_ent ent;
+	size_t esize;
+	char *p;
+
+	ep = sp->ep;
+	if (ep->l_pendlen == 0)
+		ep->l_pendlen = LINES_OFFSET;
+	esize = LOG_ENTSIZE(dlen, ilen);
+	BINC_RETC(sp, ep->l_pend, ep->l_pendblen, ep->l_pendlen + esize);
+	ep->l_pend[0] = LOG_LINES;
+
+	ent.lno = lno;
+	ent.pre = pre;
+	ent.dlen = dlen;
+	ent.ilen = ilen;
+	ent.type = type;
+	p = ep->l_pend + ep->l_pendlen;
+	memmove(p, &ent, sizeof(log_ent));
+	p += sizeof(log_ent);
+	MEMMOVEW(p, dp, dlen);
+	p += dlen * sizeof(CHAR_T);
+	MEMMOVEW(p, ip, ilen);
+	p += ilen * sizeof(CHAR_T);
+	memmove(p, &esize, sizeof(size_t));
+	ep->l_pendlen += esize;
+
+#if defined(DEBUG) && 0
+	vtrace(sp, "%lu: log_lines_add: %u: %lu {%u/%u/%u}\n",
+	    ep->l_cur, type, lno, pre, dlen, ilen);
+#endif
+	return (ep->l_pendlen >= LOG_PENDMAX ? log_flush(sp) : 0);
+}
+
+/*
+ * log_flush --
+ *	Put out the pending LOG_LINES record.
+ */
+static int
+log_flush(SCR *sp)
+{
+	DBT data, key;
+	EXF *ep;
+
+	ep = sp->ep;
+	if (ep->l_pendlen == 0)
+		return (0);
+
+	memset(&key, 0, sizeof(key));
+	key.data = &ep->l_cur;
+	key.size = sizeof(db_recno_t);
+	memset(&data, 0, sizeof(data));
+	data.data = ep->l_pend;
+	data.size = ep->l_pendlen;
+	ep->l_pendlen = 0;
+	if (ep->log->put(ep->log, NULL, &key, &data, 0) == -1)
+		LOG_ERR;
+
+	/* Reset high water mark. */
+	ep->l_high = ++ep->l_cur;
+	return (0);
+}
+
 /*
  * log_mark --
  *	Log a mark position.  For the log to work, we assume that there
@@ -371,6 +561,8 @@ log_mark(SCR *sp, LMARK *lmp)
 		ep->l_win = sp->wp;
 	}
 
+	if (log_flush(sp))
+		return (1);
 	BINC_RETC(sp, sp->wp->l_lp,
 	    sp->wp->l_len, sizeof(u_char) + sizeof(LMARK));
 	sp->wp->l_lp[0] = LOG_MARK;
@@ -454,6 +646,10 @@ log_backward(SCR *sp, MARK *rp)
 		return (1);
 	}
 
+	/* Put out any pending line changes. */
+	if (log_flush(sp))
+		return (1);
+
 	if (ep->l_cur == 1) {
 		msgq(sp, M_BERR, "011|No changes to undo");
 		return (1);
@@ -504,6 +700,11 @@ log_backward(SCR *sp, MARK *rp)
 			break;
 		case LOG_LINE_RESET_F:
 			break;
+		case LOG_LINES:
+			didop = 1;
+			if (log_lines(sp, p, size, UNDO_BACKWARD))
+				goto err;
+			break;
 		case LOG_LINE_RESET_B:
 			didop = 1;
 			memmove(&lno, p + sizeof(u_char), sizeof(db_recno_t));
@@ -563,6 +764,10 @@ log_setline(SCR *sp)
 		return (1);
 	}
 
+	/* Put out any pending line changes. */
+	if (log_flush(sp))
+		return (1);
+
 	if (ep->l_cur == 1)
 		return (1);
 
@@ -603,6 +808,10 @@ log_setline(SCR *sp)
 		case LOG_LINE_DELETE_B:
 		case LOG_LINE_RESET_F:
 			break;
+		case LOG_LINES:
+			if (log_lines(sp, p, size, UNDO_SETLINE))
+				goto err;
+			break;
 		case LOG_LINE_RESET_B:
 			memmove(&lno, p + sizeof(u_char), sizeof(db_recno_t));
 			if (lno == sp->lno &&
@@ -654,6 +863,10 @@ log_forward(SCR *sp, MARK *rp)
 		return (1);
 	}
 
+	/* Put out any pending line changes. */
+	if (log_flush(sp))
+		return (1);
+
 	if (ep->l_cur == ep->l_high) {
 		msgq(sp, M_BERR, "014|No changes to re-do");
 		return (1);
@@ -704,6 +917,11 @@ log_forward(SCR *sp, MARK *rp)
 			break;
 		case LOG_LINE_RESET_B:
 			break;
+		case LOG_LINES:
+			didop = 1;
+			if (log_lines(sp, p, size, UNDO_FORWARD))
+				goto err;
+			break;
 		case LOG_LINE_RESET_F:
 			didop = 1;
 			memmove(&lno, p + sizeof(u_char), sizeof(db_recno_t));
@@ -734,6 +952,131 @@ err:	F_CLR(ep, F_NOLOG);
 	return (1);
 }
 
+/*
+ * log_lines --
+ *	Roll a LOG_LINES record forward or backward, or, for 'U', roll back
+ *	its changes to the current line.
+ */
+static int
+log_lines(SCR *sp, u_char *p, size_t size, undo_t undo)
+{
+	EXF *ep;
+	log_ent ent;
+	db_recno_t last;
+	size_t esize, len, nlen, olen;
+	int fwd;
+	CHAR_T *dp, *ip, *lp, *np;
+	u_char *ebp, *endp;
+
+	ep = sp->ep;
+	ebp = p + LINES_OFFSET;
+	endp = p + size;
+
+	/*
+	 * Rolling forward, walk the entries in order, else in reverse.  If
+	 * the record only changes lines, each one once and in line order,
+	 * e.g., a :s over a range, the order doesn't matter: walk it forward
+	 * anyway, it's friendlier to the line store.
+	 */
+	fwd = 1;
+	if (undo != UNDO_FORWARD)
+		for (last = 0, ebp = p + LINES_OFFSET; ebp < endp;
+		    ebp += LOG_ENTSIZE(ent.dlen, ent.ilen)) {
+			memmove(&ent, ebp, sizeof(log_ent));
+			if (ent.type != LOG_LINE_RESET_F || ent.lno <= last) {
+				fwd = 0;
+				break;
+			}
+			last = ent.lno;
+		}
+	ebp = p + LINES_OFFSET;
+	for (;;) {
+		if (fwd) {
+			if (ebp >= endp)
+				break;
+			memmove(&ent, ebp, sizeof(log_ent));
+			esize = LOG_ENTSIZE(ent.dlen, ent.ilen);
+		} else {
+			if (endp <= ebp)
+				break;
+			memmove(&esize, endp - sizeof(size_t), sizeof(size_t));
+			endp -= esize;
+			memmove(&ent, endp, sizeof(log_ent));
+		}
+		dp = (CHAR_T *)((fwd ? ebp : endp) +
+		    sizeof(log_ent));
+		ip = dp + ent.dlen;
+
+		switch (ent.type) {
+		case LOG_LINE_APPEND_F:
+			if (undo == UNDO_SETLINE)
+				break;
+			if (undo == UNDO_FORWARD) {
+				if (db_insert(sp, ent.lno, ip, ent.ilen))
+					return (1);
+				++sp->rptlines[L_ADDED];
+			} else {
+				if (db_delete(sp, ent.lno))
+					return (1);
+				++sp->rptlines[L_DELETED];
+			}
+			break;
+		case LOG_LINE_DELETE_B:
+			if (undo == UNDO_SETLINE)
+				break;
+			if (undo == UNDO_FORWARD) {
+				if (db_delete(sp, ent.lno))
+					return (1);
+				++sp->rptlines[L_DELETED];
+			} else {
+				if (db_insert(sp, ent.lno, dp, ent.dlen))
+					return (1);
+				++sp->rptlines[L_ADDED];
+			}
+			break;
+		case LOG_LINE_RESET_F:
+			if (undo == UNDO_SETLINE && ent.lno != sp->lno)
+				break;
+
+			/*
+			 * Replace the changed characters.  The log buffer is
+			 * free, logging is off while the log is rolled.
+			 */
+			if (undo == UNDO_FORWARD) {
+				np = ip;
+				olen = ent.dlen;
+				nlen = ent.ilen;
+			} else {
+				np = dp;
+				olen = ent.ilen;
+				nlen = ent.dlen;
+			}
+			if (db_get(sp, ent.lno, DBG_FATAL, &lp, &len))
+				return (1);
+			if (ent.pre + olen > len)
+				abort();
+			BINC_RETW(sp, ep->l_bline,
+			    ep->l_blineblen, len - olen + nlen);
+			MEMMOVEW(ep->l_bline, lp, ent.pre);
+			MEMMOVEW(ep->l_bline + ent.pre, np, nlen);
+			MEMMOVEW(ep->l_bline + ent.pre + nlen,
+			    lp + ent.pre + olen, len - ent.pre - olen);
+			if (db_set(sp, ent.lno, ep->l_bline, len - olen + nlen))
+				return (1);
+			if (sp->rptlchange != ent.lno) {
+				sp->rptlchange = ent.lno;
+				++sp->rptlines[L_CHANGED];
+			}
+			break;
+		default:
+			abort();
+		}
+		if (fwd)
+			ebp += esize;
+	}
+	return (0);
+}
+
 /*
  * log_err --
  *	Try and restart the log on failure, i.e. if we run out of memory.
@@ -19,6 +19,7 @@
 #define	LOG_LINE_RESET_B	8
 #define	LOG_LINE_RESET_F	9
 #define	LOG_MARK		10	
+#define	LOG_LINES		11
 
 typedef enum { UNDO_FORWARD, UNDO_BACKWARD, UNDO_SETLINE } undo_t;
 
@@ -314,6 +314,18 @@ log_line(SCR *sp, db_recno_t lno, u_int action)
 	return (0);
 }
 
+/*
+ * log_append --
+ *	Log a line appended as line lno.  The line itself is logged by DB.
+ *
+ * PUBLIC: int log_append __P((SCR *, db_recno_t, CHAR_T *, size_t));
+ */
+int
+log_append(SCR *sp, db_recno_t lno, CHAR_T *p, size_t len)
+{
+	return (log_line(sp, lno, LOG_LINE_APPEND_F));
+}
+
 /*
  * log_mark --
  *	Log a mark position.  For the log to work, we assume that there
@@ -0,0 +1,1109 @@
+/*-
+ * Copyright (c) 1992, 1993, 1994
+ *	The Regents of the University of California.  All rights reserved.
+ * Copyright (c) 1992, 1993, 1994, 1995, 1996
+ *	Keith Bostic.  All rights reserved.
+ *
+ * See the LICENSE file for redistribution information.
+ */
+
+#include "config.h"
+
+#ifndef lint
+static const char sccsid[] = "$Id$";
+#endif /* not lint */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+#include <sys/stat.h>
+
+#include <bitstring.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+
+/*
+ * The line store is an in-memory alternative to the DB(3) recno access
+ * method for the lines of the file being edited.  It presents the same
+ * DB interface, so the db_XXX routines don't know which one they use.
+ *
+ * The file is read into memory in a single pass, and indexed by the
+ * offset of the start of each line; there's no per-line copying and no
+ * tree building.  New and changed lines are appended to an add buffer,
+ * made up of blocks that are never moved, so a line's address doesn't
+ * change for as long as it's in the store.  The file is described by an
+ * ordered table of pieces, each a run of consecutive lines from either
+ * the original text or the add buffer.  A change splits at most one
+ * piece, and adjacent pieces are merged when possible, so that a change
+ * to every line of a file, e.g., ":%s/a/b/", leaves a handful of pieces.
+ *
+ * Pieces carry the number of lines that precede them, so a line is found
+ * with a binary search of the piece table.  Changes renumber the pieces
+ * that follow the change, which is O(number of pieces).
+ *
+ * The original file is read rather than mmap(2)'d: vi rewrites files in
+ * place, and a write of the file being edited would truncate a mapping
+ * out from under us.
+ *
+ * Regular files are read and indexed lazily, a chunk at a time, as lines
+ * are asked for, so the first screen of a large file can be displayed
+ * without reading the rest of it.  Lines that haven't been read yet are
+ * always at the end of the file, so they're added to the end of the piece
+ * table as they're indexed.  Any request for a line the store doesn't yet
+ * have reads up to that line; a request for the last line reads the whole
+ * file.  The text buffer is allocated at the file's size when it's opened
+ * and never moves, so returned lines stay valid while more are read.  The
+ * file stays open until it has been read, and its size and modification
+ * time are checked before each chunk: if another program has changed it
+ * meanwhile, the rest of it can't be read, and reading it fails rather
+ * than mixing in the new text.
+ *
+ * There's no backing file for recovery to fall back on, so syncing the
+ * store writes all of its lines to the recovery file as a DB(3) recno
+ * file, which is what recovery reads.
+ */
+
+#define	LS_ORIG		0		/* Line is in the original text. */
+#define	LS_ADD		1		/* Line is in the add buffer. */
+
+#define	LS_BLKSIZE	(64 * 1024)	/* Add buffer block size. */
+#define	LS_RDSIZE	(256 * 1024)	/* Original text read size. */
+
+typedef struct _lsline {		/* A line in the add buffer. */
+	char	*p;			/* Line. */
+	size_t	 len;			/* Line length. */
+} LSLINE;
+
+typedef struct _lspiece {		/* A run of lines from one source. */
+	recno_t	 start;			/* Lines before this piece. */
+	recno_t	 first;			/* 0-N: first line in the source. */
+	recno_t	 nlines;		/* Number of lines. */
+	int	 src;			/* LS_ORIG or LS_ADD. */
+} LSPIECE;
+
+typedef struct _lstore {
+	int	 fd;			/* Original file, -1 once it's read. */
+	int	 fixed;			/* Text buffer is fixed size. */
+	off_t	 fsize;			/* Original file size. */
+	time_t	 fmtime;		/* Original file modification time. */
+	int	 stale;			/* Original file changed while read. */
+	char	*text;			/* Original text. */
+	size_t	 tlen;			/* Original text length. */
+	size_t	 talloc;		/* Original text allocated. */
+	size_t	 scan;			/* Offset of first unindexed line. */
+	size_t	*off;			/* Original line offsets. */
+	recno_t	 olines;		/* Original lines indexed. */
+	recno_t	 oalloc;		/* Original line offsets allocated. */
+
+	LSLINE	*alines;		/* Add buffer lines. */
+	recno_t	 nalines;		/* Add buffer line count. */
+	recno_t	 aalloc;		/* Add buffer lines allocated. */
+	char	**blks;			/* Add buffer blocks. */
+	size_t	 nblks;			/* Add buffer block count. */
+	size_t	 bused;			/* Bytes used in the last block. */
+	size_t	 bsize;			/* Size of the last block. */
+
+	LSPIECE	*pieces;		/* Piece table. */
+	size_t	 npieces;		/* Number of pieces. */
+	size_t	 palloc;		/* Pieces allocated. */
+	size_t	 phint;			/* Last piece found. */
+
+	recno_t	 nrecs;			/* Number of lines. */
+	recno_t	 rcursor;		/* Sequential cursor. */
+	recno_t	 rkey;			/* Returned key. */
+	u_char	 bval;			/* Line delimiter. */
+
+	char	*bfname;		/* Recovery file, or NULL. */
+	int	 dirty;			/* Changed since it was written. */
+} LSTORE;
+
+static int	 ls_close __P((DB *));
+static int	 ls_del __P((const DB *, const DBT *, u_int));
+static int	 ls_fd __P((const DB *));
+static int	 ls_get __P((const DB *, const DBT *, DBT *, u_int));
+static int	 ls_put __P((const DB *, DBT *, const DBT *, u_int));
+static int	 ls_seq __P((const DB *, DBT *, DBT *, u_int));
+static int	 ls_sync __P((const DB *, u_int));
+
+static int	 ls_add __P((LSTORE *, const DBT *, recno_t *));
+static int	 ls_extend __P((LSTORE *, recno_t));
+static size_t	 ls_find __P((LSTORE *, recno_t));
+static void	 ls_free __P((LSTORE *));
+static int	 ls_index __P((LSTORE *));
+static int	 ls_insert __P((LSTORE *, recno_t, const DBT *));
+static void	 ls_line __P((LSTORE *, recno_t, DBT *));
+static int	 ls_load __P((LSTORE *, recno_t));
+static void	 ls_merge __P((LSTORE *, size_t));
+static int	 ls_pins __P((LSTORE *, size_t, LSPIECE *));
+static void	 ls_prem __P((LSTORE *, size_t));
+static int	 ls_read __P((LSTORE *, size_t));
+static void	 ls_renum __P((LSTORE *, size_t));
+static int	 ls_split __P((LSTORE *, recno_t, size_t *));
+
+/*
+ * lstore_open --
+ *	Open a file as a new line store, to be synced to the recovery file
+ *	bfname, if it's not NULL.
+ *
+ * PUBLIC: DB *lstore_open __P((char *, char *, int));
+ */
+DB *
+lstore_open(char *fname, char *bfname, int bval)
+{
+	struct stat sb;
+	DB *dbp;
+	LSTORE *ls;
+	int fd, sverrno;
+
+	if ((fd = open(fname, O_NONBLOCK | O_RDONLY, 0)) == -1)
+		return (NULL);
+
+	if ((ls = calloc(1, sizeof(LSTORE))) == NULL)
+		goto err;
+	ls->fd = fd;
+	ls->bval = bval;
+	ls->dirty = 1;
+	(void)fcntl(fd, F_SETFD, 1);
+	if (bfname != NULL && (ls->bfname = strdup(bfname)) == NULL)
+		goto err;
+
+	/*
+	 * Size the buffer from the file, if it's a regular file; allow an
+	 * extra byte so that reading the whole file is seen as EOF without
+	 * another read.  Anything else, e.g., a pipe, is read immediately.
+	 */
+	if (fstat(fd, &sb))
+		goto err;
+	if (S_ISREG(sb.st_mode) && sb.st_size != 0) {
+		ls->fixed = 1;
+		ls->fsize = sb.st_size;
+		ls->fmtime = sb.st_mtime;
+		ls->talloc = (size_t)sb.st_size + 1;
+	} else
+		ls->talloc = 64 * 1024;
+	if ((ls->text = malloc(ls->talloc)) == NULL)
+		goto err;
+	if (ls_load(ls, ls->fixed ? 1 : MAX_REC_NUMBER))
+		goto err;
+
+	if ((dbp = calloc(1, sizeof(DB))) == NULL)
+		goto err;
+	dbp->type = DB_RECNO;
+	dbp->close = ls_close;
+	dbp->del = ls_del;
+	dbp->fd = ls_fd;
+	dbp->get = ls_get;
+	dbp->put = ls_put;
+	dbp->seq = ls_seq;
+	dbp->sync = ls_sync;
+	dbp->internal = ls;
+	return (dbp);
+
+err:	sverrno = errno;
+	if (ls != NULL)
+		ls_free(ls);
+	else
+		(void)close(fd);
+	errno = sverrno;
+	return (NULL);
+}
+
+/*
+ * lstore_is --
+ *	Return if dbp is a line store.
+ *
+ * PUBLIC: int lstore_is __P((DB *));
+ */
+int
+lstore_is(DB *dbp)
+{
+	return (dbp->get == ls_get);
+}
+
+/*
+ * lstore_stale --
+ *	Return if dbp is a line store whose file was changed by another
+ *	program before it was all read.
+ *
+ * PUBLIC: int lstore_stale __P((DB *));
+ */
+int
+lstore_stale(DB *dbp)
+{
+	return (dbp->get == ls_get && ((LSTORE *)dbp->internal)->stale);
+}
+
+/*
+ * lstore_block --
+ *	Return up to *nlinesp lines, starting at lno if dir is FORWARD or
+ *	ending at lno if it's BACKWARD, that are contiguous in memory and
+ *	separated by the delimiter.  Return 1 if dbp isn't a line store,
+ *	or the line isn't in the original text.
+ *
+ * PUBLIC: int lstore_block __P((DB *,
+ * PUBLIC:    db_recno_t, dir_t, char **, size_t *, db_recno_t *));
+ */
+int
+lstore_block(DB *dbp, db_recno_t lno, dir_t dir,
+    char **pp, size_t *lenp, db_recno_t *nlinesp)
+{
+	LSTORE *ls;
+	LSPIECE *pcp;
+	recno_t first, last, n;
+
+	if (dbp->get != ls_get || lno == 0)
+		return (1);
+	ls = dbp->internal;
+	if (ls_load(ls, lno) || lno > ls->nrecs)
+		return (1);
+
+	/*
+	 * Only lines from the original text are delimited; lines in the add
+	 * buffer may even contain the delimiter.
+	 */
+	pcp = ls->pieces + ls_find(ls, lno);
+	if (pcp->src != LS_ORIG)
+		return (1);
+	n = pcp->first + (lno - pcp->start - 1);
+	if (dir == FORWARD) {
+		first = n;
+		last = pcp->first + pcp->nlines - 1;
+		if (last - first >= *nlinesp)
+			last = first + *nlinesp - 1;
+	} else {
+		first = pcp->first;
+		last = n;
+		if (last - first >= *nlinesp)
+			first = last - *nlinesp + 1;
+	}
+	*pp = ls->text + ls->off[first];
+	*lenp = ls->off[last + 1] - ls->off[first] - 1;
+	*nlinesp = last - first + 1;
+	return (0);
+}
+
+/*
+ * lstore_insert --
+ *	Insert a block of lines after line lno, each line ending with the
+ *	delimiter, except perhaps the last.  The lines are inserted as a
+ *	single piece.  Return the number of lines inserted in *nlinesp, or
+ *	RET_SPECIAL if dbp isn't a line store.
+ *
+ * PUBLIC: int lstore_insert __P((DB *,
+ * PUBLIC:    db_recno_t, char *, size_t, db_recno_t *));
+ */
+int
+lstore_insert(DB *dbp, db_recno_t lno, char *p, size_t len,
+    db_recno_t *nlinesp)
+{
+	DBT data;
+	LSTORE *ls;
+	LSPIECE piece;
+	recno_t alno, first, n;
+	size_t idx;
+	char *ep, *t;
+
+	if (dbp->get != ls_get)
+		return (RET_SPECIAL);
+	ls = dbp->internal;
+	if (ls_load(ls, lno + 1))
+		return (RET_ERROR);
+	if (lno > ls->nrecs) {
+		errno = EINVAL;
+		return (RET_ERROR);
+	}
+
+	/* Add buffer lines are numbered in the order they're added. */
+	first = ls->nalines;
+	for (n = 0, ep = p + len; p < ep; ++n, p = t + 1) {
+		if ((t = memchr(p, ls->bval, ep - p)) == NULL)
+			t = ep;
+		data.data = p;
+		data.size = t - p;
+		if (ls_add(ls, &data, &alno))
+			return (RET_ERROR);
+	}
+	if ((*nlinesp = n) == 0)
+		return (RET_SUCCESS);
+	ls->dirty = 1;
+
+	if (ls_split(ls, lno + 1, &idx))
+		return (RET_ERROR);
+	piece.start = lno;
+	piece.first = first;
+	piece.nlines = n;
+	piece.src = LS_ADD;
+	if (ls_pins(ls, idx, &piece))
+		return (RET_ERROR);
+	ls->nrecs += n;
+	ls_renum(ls, idx + 1);
+	ls_merge(ls, idx);
+	if (idx > 0)
+		ls_merge(ls, idx - 1);
+	return (RET_SUCCESS);
+}
+
+/*
+ * lstore_delete --
+ *	Delete n lines, starting with line lno.  The pieces holding them
+ *	are removed from the piece table all at once.  Return RET_SPECIAL
+ *	if dbp isn't a line store.
+ *
+ * PUBLIC: int lstore_delete __P((DB *, db_recno_t, db_recno_t));
+ */
+int
+lstore_delete(DB *dbp, db_recno_t lno, db_recno_t n)
+{
+	LSTORE *ls;
+	size_t idx, last;
+
+	if (dbp->get != ls_get)
+		return (RET_SPECIAL);
+	ls = dbp->internal;
+	if (n == 0)
+		return (RET_SUCCESS);
+	if (ls_load(ls, lno + n - 1))
+		return (RET_ERROR);
+	if (lno == 0 || lno + n - 1 > ls->nrecs) {
+		errno = EINVAL;
+		return (RET_ERROR);
+	}
+
+	/* Splitting at the end of the range doesn't move its start. */
+	ls->dirty = 1;
+	if (ls_split(ls, lno, &idx) || ls_split(ls, lno + n, &last))
+		return (RET_ERROR);
+	memmove(ls->pieces + idx,
+	    ls->pieces + last, (ls->npieces - last) * sizeof(LSPIECE));
+	ls->npieces -= last - idx;
+	ls->nrecs -= n;
+	ls_renum(ls, idx);
+	if (idx > 0)
+		ls_merge(ls, idx - 1);
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_close --
+ *	Discard the line store.
+ */
+static int
+ls_close(DB *dbp)
+{
+	ls_free(dbp->internal);
+	free(dbp);
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_free --
+ *	Free the line store's memory.
+ */
+static void
+ls_free(LSTORE *ls)
+{
+	size_t cnt;
+
+	if (ls->fd != -1)
+		(void)close(ls->fd);
+	if (ls->text != NULL)
+		free(ls->text);
+	if (ls->off != NULL)
+		free(ls->off);
+	if (ls->alines != NULL)
+		free(ls->alines);
+	for (cnt = 0; cnt < ls->nblks; ++cnt)
+		free(ls->blks[cnt]);
+	if (ls->blks != NULL)
+		free(ls->blks);
+	if (ls->pieces != NULL)
+		free(ls->pieces);
+	if (ls->bfname != NULL)
+		free(ls->bfname);
+	free(ls);
+}
+
+/*
+ * ls_fd --
+ *	The line store has no underlying file descriptor.
+ */
+static int
+ls_fd(const DB *dbp)
+{
+	errno = ENOENT;
+	return (-1);
+}
+
+/*
+ * ls_sync --
+ *	Write the lines to the recovery file.  They're written to a new
+ *	file that's renamed over the recovery file when it's complete, so
+ *	a failure leaves the last one intact.
+ */
+static int
+ls_sync(const DB *dbp, u_int flags)
+{
+	struct stat sb;
+	DB *rdb;
+	DBT data, key;
+	LSTORE *ls;
+	RECNOINFO oinfo;
+	recno_t lno;
+	size_t len;
+	int fd, sverrno;
+	char *path;
+
+	ls = dbp->internal;
+	if (ls->bfname == NULL || !ls->dirty)
+		return (RET_SUCCESS);
+	if (ls_load(ls, MAX_REC_NUMBER))
+		return (RET_ERROR);
+
+	/*
+	 * The new file has the owner execute bit until it's complete, so
+	 * it's deleted at boot time if we crash while writing it.
+	 */
+	len = strlen(ls->bfname) + sizeof(".XXXXXX");
+	if ((path = malloc(len)) == NULL)
+		return (RET_ERROR);
+	(void)snprintf(path, len, "%s.XXXXXX", ls->bfname);
+	if ((fd = mkstemp(path)) == -1) {
+		free(path);
+		return (RET_ERROR);
+	}
+	(void)fchmod(fd, S_IRWXU);
+	(void)close(fd);
+
+	memset(&oinfo, 0, sizeof(RECNOINFO));
+	oinfo.bval = ls->bval;
+	oinfo.bfname = path;
+	if ((rdb = dbopen(NULL,
+	    O_RDWR, S_IRUSR | S_IWUSR, DB_RECNO, &oinfo)) == NULL)
+		goto err;
+	for (lno = 1; lno <= ls->nrecs; ++lno) {
+		/* DB returns the key in its own memory. */
+		key.data = &lno;
+		key.size = sizeof(lno);
+		ls_line(ls, lno, &data);
+		if (rdb->put(rdb, &key, &data, 0) != RET_SUCCESS) {
+			sverrno = errno;
+			(void)rdb->close(rdb);
+			errno = sverrno;
+			goto err;
+		}
+	}
+	if (rdb->close(rdb) != RET_SUCCESS)
+		goto err;
+
+	/* Take over the recovery file's permissions, and replace it. */
+	if (stat(ls->bfname, &sb) ||
+	    chmod(path, sb.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO)) ||
+	    rename(path, ls->bfname))
+		goto err;
+	free(path);
+	ls->dirty = 0;
+	return (RET_SUCCESS);
+
+err:	sverrno = errno;
+	(void)unlink(path);
+	free(path);
+	errno = sverrno;
+	return (RET_ERROR);
+}
+
+/*
+ * ls_get --
+ *	Return a line.
+ */
+static int
+ls_get(const DB *dbp, const DBT *key, DBT *data, u_int flags)
+{
+	LSTORE *ls;
+	recno_t lno;
+
+	ls = dbp->internal;
+	if (flags || (lno = *(recno_t *)key->data) == 0) {
+		errno = EINVAL;
+		return (RET_ERROR);
+	}
+	if (ls_load(ls, lno))
+		return (RET_ERROR);
+	if (lno > ls->nrecs)
+		return (RET_SPECIAL);
+	ls_line(ls, lno, data);
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_seq --
+ *	Sequential line retrieval.
+ */
+static int
+ls_seq(const DB *dbp, DBT *key, DBT *data, u_int flags)
+{
+	LSTORE *ls;
+	recno_t lno;
+
+	ls = dbp->internal;
+	switch (flags) {
+	case R_CURSOR:
+		if ((lno = *(recno_t *)key->data) == 0)
+			goto einval;
+		break;
+	case R_NEXT:
+		if (ls->rcursor != 0) {
+			lno = ls->rcursor + 1;
+			break;
+		}
+		/* FALLTHROUGH */
+	case R_FIRST:
+		lno = 1;
+		break;
+	case R_PREV:
+		if (ls->rcursor != 0) {
+			if ((lno = ls->rcursor - 1) == 0)
+				return (RET_SPECIAL);
+			break;
+		}
+		/* FALLTHROUGH */
+	case R_LAST:
+		if (ls_load(ls, MAX_REC_NUMBER))
+			return (RET_ERROR);
+		lno = ls->nrecs;
+		break;
+	default:
+einval:		errno = EINVAL;
+		return (RET_ERROR);
+	}
+	if (ls_load(ls, lno))
+		return (RET_ERROR);
+	if (lno == 0 || lno > ls->nrecs)
+		return (RET_SPECIAL);
+
+	ls->rcursor = lno;
+	ls->rkey = lno;
+	key->data = &ls->rkey;
+	key->size = sizeof(recno_t);
+	ls_line(ls, lno, data);
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_put --
+ *	Replace a line, or insert a new one.
+ */
+static int
+ls_put(const DB *dbp, DBT *key, const DBT *data, u_int flags)
+{
+	DBT empty;
+	LSTORE *ls;
+	LSPIECE piece, *pp;
+	recno_t alno, lno;
+	size_t idx;
+
+	ls = dbp->internal;
+	if ((lno = *(recno_t *)key->data) == 0 && flags != R_IAFTER)
+		goto einval;
+
+	/*
+	 * Convert to the number the new line will have; as with recno,
+	 * appending after line 0 inserts before line 1.
+	 */
+	switch (flags) {
+	case 0:
+		break;
+	case R_IAFTER:
+		++lno;
+		break;
+	case R_IBEFORE:
+		break;
+	default:
+einval:		errno = EINVAL;
+		return (RET_ERROR);
+	}
+
+	/*
+	 * Read through the line, so that a new line goes before any unread
+	 * ones, and it's known if lines need to be created.
+	 */
+	if (ls_load(ls, lno))
+		return (RET_ERROR);
+
+	/* As with recno, create empty lines if skipping lines. */
+	empty.data = NULL;
+	empty.size = 0;
+	while (lno > ls->nrecs + 1)
+		if (ls_insert(ls, ls->nrecs + 1, &empty))
+			return (RET_ERROR);
+
+	if (flags != 0 || lno == ls->nrecs + 1)
+		return (ls_insert(ls, lno, data));
+
+	/* Replace the line. */
+	ls->dirty = 1;
+	if (ls_add(ls, data, &alno) || ls_split(ls, lno, &idx))
+		return (RET_ERROR);
+	pp = ls->pieces + idx;
+	if (pp->nlines == 1) {
+		pp->src = LS_ADD;
+		pp->first = alno;
+	} else {
+		++pp->first;
+		--pp->nlines;
+		++pp->start;
+		piece.start = lno - 1;
+		piece.first = alno;
+		piece.nlines = 1;
+		piece.src = LS_ADD;
+		if (ls_pins(ls, idx, &piece))
+			return (RET_ERROR);
+	}
+	ls_merge(ls, idx);
+	if (idx > 0)
+		ls_merge(ls, idx - 1);
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_del --
+ *	Delete a line.
+ */
+static int
+ls_del(const DB *dbp, const DBT *key, u_int flags)
+{
+	LSTORE *ls;
+	LSPIECE *pp;
+	recno_t lno;
+	size_t idx;
+
+	ls = dbp->internal;
+	if (flags || (lno = *(recno_t *)key->data) == 0) {
+		errno = EINVAL;
+		return (RET_ERROR);
+	}
+	if (ls_load(ls, lno))
+		return (RET_ERROR);
+	if (lno > ls->nrecs)
+		return (RET_SPECIAL);
+
+	ls->dirty = 1;
+	if (ls_split(ls, lno, &idx))
+		return (RET_ERROR);
+	pp = ls->pieces + idx;
+	if (--pp->nlines == 0)
+		ls_prem(ls, idx);
+	else
+		++pp->first;
+	--ls->nrecs;
+	ls_renum(ls, idx);
+	if (idx > 0)
+		ls_merge(ls, idx - 1);
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_insert --
+ *	Insert a line so that it becomes line lno.
+ */
+static int
+ls_insert(LSTORE *ls, recno_t lno, const DBT *data)
+{
+	LSPIECE piece;
+	recno_t alno;
+	size_t idx;
+
+	ls->dirty = 1;
+	if (ls_add(ls, data, &alno) || ls_split(ls, lno, &idx))
+		return (RET_ERROR);
+	piece.start = lno - 1;
+	piece.first = alno;
+	piece.nlines = 1;
+	piece.src = LS_ADD;
+	if (ls_pins(ls, idx, &piece))
+		return (RET_ERROR);
+	++ls->nrecs;
+	ls_renum(ls, idx + 1);
+	ls_merge(ls, idx);
+	if (idx > 0)
+		ls_merge(ls, idx - 1);
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_line --
+ *	Return the contents of an existing line.
+ */
+static void
+ls_line(LSTORE *ls, recno_t lno, DBT *data)
+{
+	LSPIECE *pp;
+	LSLINE *lp;
+	recno_t n;
+
+	pp = ls->pieces + ls_find(ls, lno);
+	n = pp->first + (lno - pp->start - 1);
+	if (pp->src == LS_ORIG) {
+		data->data = ls->text + ls->off[n];
+		data->size = ls->off[n + 1] - ls->off[n] - 1;
+	} else {
+		lp = ls->alines + n;
+		data->data = lp->p;
+		data->size = lp->len;
+	}
+}
+
+/*
+ * ls_find --
+ *	Return the index of the piece holding an existing line.
+ */
+static size_t
+ls_find(LSTORE *ls, recno_t lno)
+{
+	LSPIECE *pp;
+	size_t base, lim, idx;
+
+	/* Sequential access is common, check the last piece found first. */
+	if (ls->phint < ls->npieces) {
+		pp = ls->pieces + ls->phint;
+		if (lno > pp->start && lno <= pp->start + pp->nlines)
+			return (ls->phint);
+	}
+
+	for (base = 0, lim = ls->npieces; lim != 0; lim >>= 1) {
+		idx = base + (lim >> 1);
+		pp = ls->pieces + idx;
+		if (lno <= pp->start)
+			continue;
+		if (lno <= pp->start + pp->nlines)
+			return (ls->phint = idx);
+		base = idx + 1;
+		--lim;
+	}
+	abort();
+	/* NOTREACHED */
+}
+
+/*
+ * ls_split --
+ *	Make line lno the first line of a piece, and return the piece's
+ *	index.  Lno may be one past the last line, in which case the index
+ *	is one past the last piece.
+ */
+static int
+ls_split(LSTORE *ls, recno_t lno, size_t *idxp)
+{
+	LSPIECE piece, *pp;
+	recno_t n;
+	size_t idx;
+
+	if (lno > ls->nrecs) {
+		*idxp = ls->npieces;
+		return (RET_SUCCESS);
+	}
+	idx = ls_find(ls, lno);
+	pp = ls->pieces + idx;
+	if ((n = lno - pp->start - 1) != 0) {
+		piece.start = lno - 1;
+		piece.first = pp->first + n;
+		piece.nlines = pp->nlines - n;
+		piece.src = pp->src;
+		pp->nlines = n;
+		if (ls_pins(ls, ++idx, &piece))
+			return (RET_ERROR);
+	}
+	*idxp = idx;
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_merge --
+ *	Merge a piece with the following one, if they're contiguous in
+ *	the same source.
+ */
+static void
+ls_merge(LSTORE *ls, size_t idx)
+{
+	LSPIECE *pp;
+
+	if (idx + 1 >= ls->npieces)
+		return;
+	pp = ls->pieces + idx;
+	if (pp->src != pp[1].src || pp->first + pp->nlines != pp[1].first)
+		return;
+	pp->nlines += pp[1].nlines;
+	ls_prem(ls, idx + 1);
+}
+
+/*
+ * ls_pins --
+ *	Insert a piece into the piece table.
+ */
+static int
+ls_pins(LSTORE *ls, size_t idx, LSPIECE *piece)
+{
+	LSPIECE *np;
+	size_t nalloc;
+
+	if (ls->npieces == ls->palloc) {
+		nalloc = ls->palloc == 0 ? 64 : ls->palloc * 2;
+		if ((np = realloc(ls->pieces, nalloc * sizeof(LSPIECE))) == NULL)
+			return (RET_ERROR);
+		ls->pieces = np;
+		ls->palloc = nalloc;
+	}
+	memmove(ls->pieces + idx + 1,
+	    ls->pieces + idx, (ls->npieces - idx) * sizeof(LSPIECE));
+	ls->pieces[idx] = *piece;
+	++ls->npieces;
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_prem --
+ *	Remove a piece from the piece table.
+ */
+static void
+ls_prem(LSTORE *ls, size_t idx)
+{
+	--ls->npieces;
+	memmove(ls->pieces + idx,
+	    ls->pieces + idx + 1, (ls->npieces - idx) * sizeof(LSPIECE));
+}
+
+/*
+ * ls_renum --
+ *	Recompute the line counts preceding the pieces, starting at idx.
+ */
+static void
+ls_renum(LSTORE *ls, size_t idx)
+{
+	LSPIECE *pp;
+
+	for (pp = ls->pieces + idx; idx < ls->npieces; ++idx, ++pp)
+		pp->start = idx == 0 ? 0 : pp[-1].start + pp[-1].nlines;
+}
+
+/*
+ * ls_add --
+ *	Copy a line into the add buffer.
+ */
+static int
+ls_add(LSTORE *ls, const DBT *data, recno_t *alnop)
+{
+	LSLINE *lp;
+	size_t nalloc, need;
+	char *bp, **nb;
+
+	if (ls->nalines == ls->aalloc) {
+		nalloc = ls->aalloc == 0 ? 256 : ls->aalloc * 2;
+		if ((lp = realloc(ls->alines, nalloc * sizeof(LSLINE))) == NULL)
+			return (RET_ERROR);
+		ls->alines = lp;
+		ls->aalloc = nalloc;
+	}
+
+	/*
+	 * Lines never cross blocks, and blocks never move.  Long lines get
+	 * a block of their own; the current block stays the current block.
+	 */
+	need = data->size;
+	if (ls->nblks == 0 || need > ls->bsize - ls->bused) {
+		if ((nb = realloc(ls->blks,
+		    (ls->nblks + 1) * sizeof(char *))) == NULL)
+			return (RET_ERROR);
+		ls->blks = nb;
+		if (need > LS_BLKSIZE / 4) {
+			if ((bp = malloc(need)) == NULL)
+				return (RET_ERROR);
+			if (ls->nblks == 0) {
+				ls->blks[ls->nblks++] = bp;
+				ls->bused = ls->bsize = need;
+			} else {
+				/* Keep the current block last. */
+				ls->blks[ls->nblks] = ls->blks[ls->nblks - 1];
+				ls->blks[ls->nblks - 1] = bp;
+				++ls->nblks;
+			}
+			goto copy;
+		}
+		if ((bp = malloc(LS_BLKSIZE)) == NULL)
+			return (RET_ERROR);
+		ls->blks[ls->nblks++] = bp;
+		ls->bused = 0;
+		ls->bsize = LS_BLKSIZE;
+	}
+	bp = ls->blks[ls->nblks - 1] + ls->bused;
+	ls->bused += need;
+
+copy:	if (need != 0)
+		memcpy(bp, data->data, need);
+	lp = ls->alines + ls->nalines;
+	lp->p = bp;
+	lp->len = need;
+	*alnop = ls->nalines++;
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_load --
+ *	Read and index the original file until the store has lno lines or
+ *	the file has all been read.
+ */
+static int
+ls_load(LSTORE *ls, recno_t lno)
+{
+	recno_t olines;
+
+	while (ls->nrecs < lno && ls->fd != -1) {
+		olines = ls->olines;
+		if (ls_read(ls, LS_RDSIZE) ||
+		    ls_index(ls) || ls_extend(ls, olines))
+			return (RET_ERROR);
+	}
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_read --
+ *	Read up to len more bytes of the original file.
+ */
+static int
+ls_read(LSTORE *ls, size_t len)
+{
+	struct stat sb;
+	size_t nlen;
+	ssize_t nr;
+	char *bp;
+
+	/*
+	 * A regular file is read a chunk at a time; if it's been changed
+	 * since it was opened, what's left of it doesn't belong with what's
+	 * been read.
+	 */
+	if (ls->fixed) {
+		if (!ls->stale && fstat(ls->fd, &sb))
+			return (RET_ERROR);
+		if (ls->stale ||
+		    sb.st_size != ls->fsize || sb.st_mtime != ls->fmtime) {
+			ls->stale = 1;
+			errno = ESTALE;
+			return (RET_ERROR);
+		}
+	}
+
+	for (;;) {
+		if (ls->tlen == ls->talloc) {
+			/* Fixed buffers were sized for the whole file. */
+			if (ls->fixed)
+				break;
+			nlen = ls->talloc * 2;
+			if ((bp = realloc(ls->text, nlen)) == NULL)
+				return (RET_ERROR);
+			ls->text = bp;
+			ls->talloc = nlen;
+		}
+		nlen = ls->talloc - ls->tlen;
+		if (nlen > len)
+			nlen = len;
+		if ((nr = read(ls->fd, ls->text + ls->tlen, nlen)) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				/* Nonblocking pipe with no data yet. */
+				(void)fcntl(ls->fd, F_SETFL,
+				    fcntl(ls->fd, F_GETFL, 0) & ~O_NONBLOCK);
+				continue;
+			}
+			return (RET_ERROR);
+		}
+		if (nr == 0)
+			break;
+		ls->tlen += nr;
+		if ((size_t)nr >= len)
+			return (RET_SUCCESS);
+		len -= nr;
+	}
+
+	/* End of file. */
+	(void)close(ls->fd);
+	ls->fd = -1;
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_index --
+ *	Index the complete lines of the original text read so far, or all
+ *	of the remaining lines, at end of file.
+ */
+static int
+ls_index(LSTORE *ls)
+{
+	size_t *noff, nalloc;
+	char *p, *t, *ep;
+
+	for (p = ls->text + ls->scan,
+	    ep = ls->text + ls->tlen; p < ep; p = t + 1) {
+		if ((t = memchr(p, ls->bval, ep - p)) == NULL) {
+			if (ls->fd != -1)
+				break;
+			t = ep;
+		}
+		if (ls->olines + 1 >= ls->oalloc) {
+			nalloc = ls->oalloc == 0 ? 1024 : ls->oalloc * 2;
+			if ((noff =
+			    realloc(ls->off, nalloc * sizeof(size_t))) == NULL)
+				return (RET_ERROR);
+			ls->off = noff;
+			ls->oalloc = nalloc;
+		}
+		if (ls->olines == MAX_REC_NUMBER) {
+			errno = EFBIG;
+			return (RET_ERROR);
+		}
+
+		/*
+		 * The offset after a line is one past its delimiter, even if
+		 * the last line wasn't delimited, so that line lengths are the
+		 * difference of the offsets, minus one.
+		 */
+		ls->off[ls->olines++] = p - ls->text;
+		ls->off[ls->olines] = (t - ls->text) + 1;
+	}
+	ls->scan = p < ep ? p - ls->text : ls->tlen;
+	return (RET_SUCCESS);
+}
+
+/*
+ * ls_extend --
+ *	Add the original lines indexed since there were olines to the end
+ *	of the piece table.
+ */
+static int
+ls_extend(LSTORE *ls, recno_t olines)
+{
+	LSPIECE piece, *pp;
+	recno_t n;
+
+	if ((n = ls->olines - olines) == 0)
+		return (RET_SUCCESS);
+	pp = ls->npieces == 0 ? NULL : ls->pieces + ls->npieces - 1;
+	if (pp != NULL &&
+	    pp->src == LS_ORIG && pp->first + pp->nlines == olines)
+		pp->nlines += n;
+	else {
+		piece.start = ls->nrecs;
+		piece.first = olines;
+		piece.nlines = n;
+		piece.src = LS_ORIG;
+		if (ls_pins(ls, ls->npieces, &piece))
+			return (RET_ERROR);
+	}
+	ls->nrecs += n;
+	return (RET_SUCCESS);
+}
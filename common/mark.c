@@ -210,7 +210,6 @@ int
 mark_insdel(SCR *sp, lnop_t op, db_recno_t lno)
 {
 	LMARK *lmp;
-	db_recno_t lline;
 
 	switch (op) {
 	case LINE_APPEND:
@@ -227,34 +226,76 @@ mark_insdel(SCR *sp, lnop_t op, db_recno_t lno)
 					--lmp->lno;
 		break;
 	case LINE_INSERT:
-		/*
-		 * XXX
-		 * Very nasty special case.  If the file was empty, then we're
-		 * adding the first line, which is a replacement.  So, we don't
-		 * modify the marks.  This is a hack to make:
-		 *
-		 *	mz:r!echo foo<carriage-return>'z
-		 *
-		 * work, i.e. historically you could mark the "line" in an empty
-		 * file and replace it, and continue to use the mark.  Insane,
-		 * well, yes, I know, but someone complained.
-		 *
-		 * Check for line #2 before going to the end of the file.
-		 */
-		if (!db_exist(sp, 2)) {
-			if (db_last(sp, &lline))
-				return (1);
-			if (lline == 1)
-				return (0);
-		}
-
-		for (lmp = sp->ep->marks.lh_first;
-		    lmp != NULL; lmp = lmp->q.le_next)
-			if (lmp->lno >= lno)
-				++lmp->lno;
-		break;
+		return (mark_ins(sp, lno, 1));
 	case LINE_RESET:
 		break;
 	}
 	return (0);
 }
+
+/*
+ * mark_del --
+ *	Update the marks when n lines, starting with line lno, are deleted.
+ *	Marks on the deleted lines end up on line lno, as if the lines had
+ *	been deleted one at a time, last to first.
+ *
+ * PUBLIC: int mark_del __P((SCR *, db_recno_t, db_recno_t));
+ */
+int
+mark_del(SCR *sp, db_recno_t lno, db_recno_t n)
+{
+	LMARK *lmp;
+
+	for (lmp = sp->ep->marks.lh_first; lmp != NULL; lmp = lmp->q.le_next)
+		if (lmp->lno >= lno)
+			if (lmp->lno < lno + n) {
+				F_SET(lmp, MARK_DELETED);
+				(void)log_mark(sp, lmp);
+				lmp->lno = lno;
+			} else
+				lmp->lno -= n;
+	return (0);
+}
+
+/*
+ * mark_ins --
+ *	Update the marks when n lines are inserted, the first of them as
+ *	line lno.
+ *
+ * PUBLIC: int mark_ins __P((SCR *, db_recno_t, db_recno_t));
+ */
+int
+mark_ins(SCR *sp, db_recno_t lno, db_recno_t n)
+{
+	LMARK *lmp;
+	db_recno_t lline;
+
+	/*
+	 * XXX
+	 * Very nasty special case.  If the file was empty, then we're
+	 * adding the first line, which is a replacement.  So, we don't
+	 * modify the marks for it.  This is a hack to make:
+	 *
+	 *	mz:r!echo foo<carriage-return>'z
+	 *
+	 * work, i.e. historically you could mark the "line" in an empty
+	 * file and replace it, and continue to use the mark.  Insane,
+	 * well, yes, I know, but someone complained.
+	 *
+	 * Check for line #n + 1 before going to the end of the file.
+	 */
+	if (!db_exist(sp, n + 1)) {
+		if (db_last(sp, &lline))
+			return (1);
+		if (lline == n) {
+			if (--n == 0)
+				return (0);
+			++lno;
+		}
+	}
+
+	for (lmp = sp->ep->marks.lh_first; lmp != NULL; lmp = lmp->q.le_next)
+		if (lmp->lno >= lno)
+			lmp->lno += n;
+	return (0);
+}
@@ -0,0 +1,617 @@
+/*-
+ * Copyright (c) 1992, 1993, 1994
+ *	The Regents of the University of California.  All rights reserved.
+ * Copyright (c) 1992, 1993, 1994, 1995, 1996
+ *	Keith Bostic.  All rights reserved.
+ *
+ * See the LICENSE file for redistribution information.
+ */
+
+#include "config.h"
+
+#ifndef lint
+static const char sccsid[] = "$Id$";
+#endif /* not lint */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <bitstring.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#define	MI_NOBLK	((size_t)-1)	/* Index not usable. */
+
+static MIBLK	*mi_blk __P((MINDEX *, size_t));
+static int	 mi_build __P((SCR *, MINDEX *));
+static size_t	 mi_find __P((MINDEX *, db_recno_t));
+static int	 mi_grow __P((MINDEX *, size_t));
+static void	 mi_line __P((MIBLK *, CHAR_T *, size_t));
+static int	 mi_pair __P((CHAR_T));
+static int	 mi_split __P((MINDEX *, size_t));
+static int	 mi_start __P((SCR *, db_recno_t, MINDEX **, size_t *));
+static int	 mi_sum __P((SCR *, MIBLK *));
+
+/*
+ * The motion index lets the %, [[, ]], { and } commands skip over the
+ * lines that can't hold what they're looking for, rather than stepping
+ * through them a character or a line at a time.
+ *
+ * The file's lines are divided into blocks, and each block has a summary
+ * of its brackets and of its line classes, i.e., of what is in its lines'
+ * first columns.  A bracket match can't be in a block unless the block's
+ * brackets bring the running count to zero, and a paragraph or section
+ * boundary can't be in a block unless the block has lines of the right
+ * class.  The searches still look at the lines of the block they start
+ * in and of the block they stop in, so the summaries only have to be
+ * conservative, not exact.
+ *
+ * Summaries are computed when a search first needs them.  Changes only
+ * adjust the block line counts and discard the summaries of the changed
+ * blocks, from the same places that update the line cache.  The block
+ * start line numbers are renumbered lazily, so a run of changes doesn't
+ * renumber every block for every line.
+ */
+
+/*
+ * mindex_skip --
+ *	Return the next line a bracket match search should look at, after
+ *	(or before, if dir is BACKWARD) line lno.  That's the adjacent line
+ *	unless it's in another block, in which case the blocks that can't
+ *	hold the match are skipped, and *cntp is adjusted for the brackets
+ *	in them.  If there are no more lines, the returned line is OOBLNO,
+ *	or may be one past the last line.
+ *
+ * PUBLIC: int mindex_skip
+ * PUBLIC:    __P((SCR *, db_recno_t, dir_t, CHAR_T, long *, db_recno_t *));
+ */
+int
+mindex_skip(SCR *sp, db_recno_t lno, dir_t dir,
+    CHAR_T startc, long *cntp, db_recno_t *lnop)
+{
+	MINDEX *mp;
+	MIBLK *bp;
+	size_t idx;
+	long cnt;
+	int pair;
+
+	if (mi_start(sp, lno, &mp, &idx))
+		return (1);
+	if (idx == MI_NOBLK) {
+		*lnop = dir == FORWARD ? lno + 1 : lno - 1;
+		return (0);
+	}
+
+	pair = mi_pair(startc);
+	cnt = *cntp;
+	bp = mp->blks + idx;
+	if (dir == FORWARD) {
+		if (lno < bp->start + bp->nlines) {
+			*lnop = lno + 1;
+			return (0);
+		}
+		for (++idx; idx < mp->nblks; ++idx) {
+			bp = mi_blk(mp, idx);
+			if (!F_ISSET(bp, MIB_VALID) && mi_sum(sp, bp))
+				return (1);
+			if (cnt + bp->fmin[pair] <= 0) {
+				*lnop = bp->start + 1;
+				*cntp = cnt;
+				return (0);
+			}
+			cnt += bp->net[pair];
+		}
+	} else {
+		if (lno > bp->start + 1) {
+			*lnop = lno - 1;
+			return (0);
+		}
+		while (idx-- > 0) {
+			bp = mp->blks + idx;
+			if (!F_ISSET(bp, MIB_VALID) && mi_sum(sp, bp))
+				return (1);
+			if (cnt + bp->fmin[pair] - bp->net[pair] <= 0) {
+				*lnop = bp->start + bp->nlines;
+				*cntp = cnt;
+				return (0);
+			}
+			cnt -= bp->net[pair];
+		}
+	}
+	*lnop = OOBLNO;
+	return (0);
+}
+
+/*
+ * mindex_next --
+ *	Return the next line a paragraph or section search should look at,
+ *	after (or before, if dir is BACKWARD) line lno.  That's the adjacent
+ *	line unless it's in another block, in which case the blocks without
+ *	lines of any of the classes in mask are skipped.  If there are no
+ *	more lines, the returned line is one past the last line, or 0.
+ *
+ * PUBLIC: int mindex_next __P((SCR *, db_recno_t, dir_t, u_int, db_recno_t *));
+ */
+int
+mindex_next(SCR *sp, db_recno_t lno, dir_t dir, u_int mask, db_recno_t *lnop)
+{
+	MINDEX *mp;
+	MIBLK *bp;
+	size_t idx;
+
+	if (mi_start(sp, lno, &mp, &idx))
+		return (1);
+	if (idx == MI_NOBLK) {
+		*lnop = dir == FORWARD ? lno + 1 : lno - 1;
+		return (0);
+	}
+
+	bp = mp->blks + idx;
+	if (dir == FORWARD) {
+		if (lno < bp->start + bp->nlines) {
+			*lnop = lno + 1;
+			return (0);
+		}
+		for (++idx; idx < mp->nblks; ++idx) {
+			bp = mi_blk(mp, idx);
+			if (!F_ISSET(bp, MIB_VALID) && mi_sum(sp, bp))
+				return (1);
+			if (bp->classes & mask) {
+				*lnop = bp->start + 1;
+				return (0);
+			}
+		}
+		*lnop = bp->start + bp->nlines + 1;
+	} else {
+		if (lno > bp->start + 1) {
+			*lnop = lno - 1;
+			return (0);
+		}
+		while (idx-- > 0) {
+			bp = mp->blks + idx;
+			if (!F_ISSET(bp, MIB_VALID) && mi_sum(sp, bp))
+				return (1);
+			if (bp->classes & mask) {
+				*lnop = bp->start + bp->nlines;
+				return (0);
+			}
+		}
+		*lnop = 0;
+	}
+	return (0);
+}
+
+/*
+ * mindex_insdel --
+ *	Update the motion index when a line is inserted, deleted or reset.
+ *	The line number is the number of the new, deleted or reset line.
+ *
+ * PUBLIC: void mindex_insdel __P((EXF *, lnop_t, db_recno_t));
+ */
+void
+mindex_insdel(EXF *ep, lnop_t op, db_recno_t lno)
+{
+	MINDEX *mp;
+	size_t idx;
+
+	mp = &ep->mindex;
+	if (!mp->built)
+		return;
+	switch (op) {
+	case LINE_APPEND:
+	case LINE_INSERT:
+		mindex_ins(ep, lno, 1);
+		break;
+	case LINE_DELETE:
+		mindex_del(ep, lno, 1);
+		break;
+	case LINE_RESET:
+		if ((idx = mi_find(mp, lno)) != mp->nblks)
+			F_CLR(mp->blks + idx, MIB_VALID);
+		break;
+	}
+}
+
+/*
+ * mindex_ins --
+ *	Update the motion index when n lines are inserted, the first of them
+ *	as line lno.
+ *
+ * PUBLIC: void mindex_ins __P((EXF *, db_recno_t, db_recno_t));
+ */
+void
+mindex_ins(EXF *ep, db_recno_t lno, db_recno_t n)
+{
+	MINDEX *mp;
+	MIBLK *bp;
+	size_t idx;
+
+	mp = &ep->mindex;
+	if (!mp->built)
+		return;
+
+	/* Lines appended to the file go into the last block. */
+	if ((idx = mi_find(mp, lno)) == mp->nblks) {
+		if (mp->nblks == 0) {
+			if (mi_grow(mp, 1))
+				goto err;
+			memset(mp->blks, 0, sizeof(MIBLK));
+			mp->nblks = 1;
+		}
+		idx = mp->nblks - 1;
+	}
+	bp = mp->blks + idx;
+	bp->nlines += n;
+	F_CLR(bp, MIB_VALID);
+	if (mp->nvalid > idx + 1)
+		mp->nvalid = idx + 1;
+	if (bp->nlines > 2 * MI_BLKLINES && mi_split(mp, idx))
+		goto err;
+	return;
+
+err:	mindex_end(ep);
+}
+
+/*
+ * mindex_del --
+ *	Update the motion index when n lines, starting with line lno, are
+ *	deleted.
+ *
+ * PUBLIC: void mindex_del __P((EXF *, db_recno_t, db_recno_t));
+ */
+void
+mindex_del(EXF *ep, db_recno_t lno, db_recno_t n)
+{
+	MINDEX *mp;
+	MIBLK *bp;
+	db_recno_t off;
+	size_t cnt, first, idx, last;
+
+	mp = &ep->mindex;
+	if (!mp->built)
+		return;
+	if ((first = mi_find(mp, lno)) == mp->nblks)
+		goto err;
+
+	/* Take the lines out of the blocks holding them. */
+	off = lno - mp->blks[first].start - 1;
+	for (idx = first; n > 0; ++idx, off = 0) {
+		if (idx == mp->nblks)
+			goto err;
+		bp = mp->blks + idx;
+		if (bp->nlines - off < n) {
+			n -= bp->nlines - off;
+			bp->nlines = off;
+		} else {
+			bp->nlines -= n;
+			n = 0;
+		}
+		F_CLR(bp, MIB_VALID);
+	}
+
+	/*
+	 * Discard the emptied blocks, and merge what's left of the changed
+	 * blocks with the next block, if they're both small.
+	 */
+	for (last = first, cnt = first; cnt < idx; ++cnt)
+		if (mp->blks[cnt].nlines != 0)
+			mp->blks[last++] = mp->blks[cnt];
+	memmove(mp->blks + last,
+	    mp->blks + idx, (mp->nblks - idx) * sizeof(MIBLK));
+	mp->nblks -= idx - last;
+	if (last != 0 && last < mp->nblks &&
+	    mp->blks[last - 1].nlines + mp->blks[last].nlines <= MI_BLKLINES) {
+		mp->blks[last - 1].nlines += mp->blks[last].nlines;
+		F_CLR(mp->blks + last - 1, MIB_VALID);
+		memmove(mp->blks + last, mp->blks + last + 1,
+		    (mp->nblks - last - 1) * sizeof(MIBLK));
+		--mp->nblks;
+	}
+	if (mp->nvalid > first)
+		mp->nvalid = first;
+	return;
+
+	/* The index doesn't match the file, throw it away. */
+err:	mindex_end(ep);
+}
+
+/*
+ * mindex_end --
+ *	Discard the motion index, e.g., because the character set conversion
+ *	used to build it changed.  It's rebuilt when next needed.
+ *
+ * PUBLIC: void mindex_end __P((EXF *));
+ */
+void
+mindex_end(EXF *ep)
+{
+	MINDEX *mp;
+
+	mp = &ep->mindex;
+	if (mp->blks != NULL)
+		free(mp->blks);
+	memset(mp, 0, sizeof(MINDEX));
+}
+
+/*
+ * mi_start --
+ *	Return the index of the block holding line lno, building the index
+ *	if it hasn't been built, or MI_NOBLK if the index can't be used.
+ */
+static int
+mi_start(SCR *sp, db_recno_t lno, MINDEX **mpp, size_t *idxp)
+{
+	MINDEX *mp;
+	size_t idx;
+
+	*idxp = MI_NOBLK;
+
+	/* Lines being input aren't in the file, or numbered as in it. */
+	if (sp->ep == NULL || F_ISSET(sp, SC_TINPUT))
+		return (0);
+
+	mp = *mpp = &sp->ep->mindex;
+	if (!mp->built && mi_build(sp, mp))
+		return (1);
+	if ((idx = mi_find(mp, lno)) != mp->nblks)
+		*idxp = idx;
+	return (0);
+}
+
+/*
+ * mi_build --
+ *	Divide the file into blocks, without summaries.
+ */
+static int
+mi_build(SCR *sp, MINDEX *mp)
+{
+	MIBLK *bp;
+	db_recno_t lno, nlines;
+	size_t cnt;
+
+	if (db_last(sp, &lno))
+		return (1);
+	cnt = (lno + MI_BLKLINES - 1) / MI_BLKLINES;
+	if (cnt != 0) {
+		if (mi_grow(mp, cnt)) {
+			msgq(sp, M_SYSERR, NULL);
+			return (1);
+		}
+		memset(mp->blks, 0, cnt * sizeof(MIBLK));
+	}
+	for (bp = mp->blks; lno > 0; ++bp, lno -= nlines) {
+		nlines = lno < MI_BLKLINES ? lno : MI_BLKLINES;
+		bp->nlines = nlines;
+	}
+	mp->nblks = cnt;
+	mp->nvalid = 0;
+	mp->built = 1;
+	return (0);
+}
+
+/*
+ * mi_find --
+ *	Return the index of the block holding line lno, or the number of
+ *	blocks if there isn't one.
+ */
+static size_t
+mi_find(MINDEX *mp, db_recno_t lno)
+{
+	MIBLK *bp;
+	size_t base, idx, lim;
+
+	if (mp->nblks == 0)
+		return (mp->nblks);
+
+	/* Searches and changes are local, check the last block found first. */
+	if (mp->bhint < mp->nvalid) {
+		bp = mp->blks + mp->bhint;
+		if (lno > bp->start && lno <= bp->start + bp->nlines)
+			return (mp->bhint);
+	}
+
+	/* Number the blocks up to the one holding the line. */
+	if (mp->nvalid == 0) {
+		mp->blks[0].start = 0;
+		mp->nvalid = 1;
+	}
+	for (bp = mp->blks + mp->nvalid - 1;
+	    lno > bp->start + bp->nlines && mp->nvalid < mp->nblks;)
+		bp = mi_blk(mp, mp->nvalid);
+
+	for (base = 0, lim = mp->nvalid; lim != 0; lim >>= 1) {
+		idx = base + (lim >> 1);
+		bp = mp->blks + idx;
+		if (lno <= bp->start)
+			continue;
+		if (lno <= bp->start + bp->nlines)
+			return (mp->bhint = idx);
+		base = idx + 1;
+		--lim;
+	}
+	return (mp->nblks);
+}
+
+/*
+ * mi_blk --
+ *	Return block idx, numbering it if its start isn't valid.  The block
+ *	before it must be valid.
+ */
+static MIBLK *
+mi_blk(MINDEX *mp, size_t idx)
+{
+	MIBLK *bp;
+
+	bp = mp->blks + idx;
+	if (idx >= mp->nvalid) {
+		bp->start = idx == 0 ? 0 : bp[-1].start + bp[-1].nlines;
+		mp->nvalid = idx + 1;
+	}
+	return (bp);
+}
+
+/*
+ * mi_split --
+ *	Split a block that's grown too large into blocks of the usual size.
+ */
+static int
+mi_split(MINDEX *mp, size_t idx)
+{
+	MIBLK *bp;
+	db_recno_t nlines;
+	size_t cnt;
+
+	nlines = mp->blks[idx].nlines;
+	cnt = (nlines + MI_BLKLINES - 1) / MI_BLKLINES;
+	if (mi_grow(mp, mp->nblks + cnt - 1))
+		return (1);
+	memmove(mp->blks + idx + cnt,
+	    mp->blks + idx + 1, (mp->nblks - idx - 1) * sizeof(MIBLK));
+	mp->nblks += cnt - 1;
+	for (bp = mp->blks + idx; cnt > 0; --cnt, ++bp) {
+		memset(bp, 0, sizeof(MIBLK));
+		bp->nlines = cnt == 1 ? nlines : MI_BLKLINES;
+		nlines -= bp->nlines;
+	}
+	if (mp->nvalid > idx + 1)
+		mp->nvalid = idx + 1;
+	return (0);
+}
+
+/*
+ * mi_grow --
+ *	Make room for n blocks.
+ */
+static int
+mi_grow(MINDEX *mp, size_t n)
+{
+	MIBLK *np;
+	size_t nalloc;
+
+	if (n <= mp->balloc)
+		return (0);
+	for (nalloc = mp->balloc == 0 ? 64 : mp->balloc; nalloc < n;)
+		nalloc *= 2;
+	if ((np = realloc(mp->blks, nalloc * sizeof(MIBLK))) == NULL)
+		return (1);
+	mp->blks = np;
+	mp->balloc = nalloc;
+	return (0);
+}
+
+/*
+ * mi_sum --
+ *	Summarize a block's lines, a run of unchanged lines at a time if the
+ *	file keeps them that way.
+ */
+static int
+mi_sum(SCR *sp, MIBLK *bp)
+{
+	CHAR_T *end, *p, *t;
+	db_recno_t last, lno, n;
+	size_t len;
+	int pair;
+
+	for (pair = 0; pair < MI_NPAIRS; ++pair)
+		bp->net[pair] = bp->fmin[pair] = 0;
+	bp->classes = 0;
+
+	for (lno = bp->start + 1,
+	    last = bp->start + bp->nlines; lno <= last; lno += n) {
+		n = last - lno + 1;
+		if (db_block(sp, lno, FORWARD, &p, &len, &n)) {
+			n = 1;
+			if (db_get(sp, lno, DBG_FATAL, &p, &len))
+				return (1);
+			mi_line(bp, p, len);
+			continue;
+		}
+		for (t = p, end = p + len;; ++t)
+			if (t == end || *t == '\n') {
+				mi_line(bp, p, t - p);
+				if (t == end)
+					break;
+				p = t + 1;
+			}
+	}
+	F_SET(bp, MIB_VALID);
+	return (0);
+}
+
+/*
+ * mi_line --
+ *	Add a line to a block's summary.
+ */
+static void
+mi_line(MIBLK *bp, CHAR_T *p, size_t len)
+{
+	size_t cnt;
+	int pair;
+
+	if (len == 0) {
+		bp->classes |= MI_BLANK;
+		return;
+	}
+	for (cnt = 0; cnt < len && ISBLANK(p[cnt]); ++cnt);
+	bp->classes |= cnt == len ? MI_BLANK : MI_TEXT;
+	switch (p[0]) {
+	case '\014':
+		bp->classes |= MI_FF;
+		break;
+	case '.':
+		if (len >= 2)
+			bp->classes |= MI_DOT;
+		break;
+	case '{':
+		bp->classes |= MI_LBRACE;
+		break;
+	case '}':
+		bp->classes |= MI_RBRACE;
+		break;
+	}
+
+	for (; len > 0; --len, ++p) {
+		switch (*p) {
+		case '(':
+		case '[':
+		case '{':
+		case '<':
+			++bp->net[mi_pair(*p)];
+			continue;
+		case ')':
+		case ']':
+		case '}':
+		case '>':
+			pair = mi_pair(*p);
+			if (--bp->net[pair] < bp->fmin[pair])
+				bp->fmin[pair] = bp->net[pair];
+			continue;
+		}
+	}
+}
+
+/*
+ * mi_pair --
+ *	Return the bracket pair a bracket belongs to.
+ */
+static int
+mi_pair(CHAR_T ch)
+{
+	switch (ch) {
+	case '(':
+	case ')':
+		return (0);
+	case '[':
+	case ']':
+		return (1);
+	case '{':
+	case '}':
+		return (2);
+	default:
+		return (3);
+	}
+}
@@ -0,0 +1,55 @@
+/*-
+ * Copyright (c) 1992, 1993, 1994
+ *	The Regents of the University of California.  All rights reserved.
+ * Copyright (c) 1992, 1993, 1994, 1995, 1996
+ *	Keith Bostic.  All rights reserved.
+ *
+ * See the LICENSE file for redistribution information.
+ *
+ *	$Id$
+ */
+
+/* Line classes, by the line's first column. */
+#define	MI_BLANK	0x01		/* Empty, or only <blank>s. */
+#define	MI_TEXT		0x02		/* Not blank. */
+#define	MI_FF		0x04		/* Starts with a formfeed. */
+#define	MI_DOT		0x08		/* Starts with a '.', may be a macro. */
+#define	MI_LBRACE	0x10		/* Starts with a '{'. */
+#define	MI_RBRACE	0x20		/* Starts with a '}'. */
+
+#define	MI_NPAIRS	4		/* (), [], {} and <>. */
+#define	MI_BLKLINES	256		/* Lines per block, when built. */
+
+/*
+ * MIBLK --
+ *	A run of lines in the motion index, and a summary of their brackets
+ *	and line classes.  For each bracket pair, net is the number of open
+ *	brackets less the number of close brackets, and fmin is the least
+ *	value that count reaches, scanning forward from the start of the
+ *	block.  Scanning backward, the least value is fmin - net.
+ */
+struct _miblk {
+	db_recno_t	 start;		/* Lines before this block. */
+	db_recno_t	 nlines;	/* Number of lines. */
+	long	 net[MI_NPAIRS];	/* Open less close brackets. */
+	long	 fmin[MI_NPAIRS];	/* Least count, scanning forward. */
+	u_int8_t classes;		/* Line classes in the block. */
+
+#define	MIB_VALID	0x01		/* Summary is valid. */
+	u_int8_t flags;
+};
+
+/*
+ * MINDEX --
+ *	The per-file motion index, shared by all of the screens editing the
+ *	file.  It's built the first time it's needed, and kept up to date
+ *	from then on.
+ */
+struct _mindex {
+	MIBLK	*blks;			/* Blocks. */
+	size_t	 nblks;			/* Number of blocks. */
+	size_t	 balloc;		/* Blocks allocated. */
+	size_t	 nvalid;		/* Leading blocks with valid starts. */
+	size_t	 bhint;			/* Last block found. */
+	int	 built;			/* Index has been built. */
+};
@@ -18,6 +18,7 @@ typedef	u_int		UCHAR_T;
 #define STRTOUL		wcstoul
 #define SPRINTF		swprintf
 #define STRCHR		wcschr
+#define MEMCHR		wmemchr
 #define STRCMP		wcscmp
 #define STRPBRK		wcspbrk
 #define TOLOWER		towlower
@@ -40,6 +41,7 @@ typedef	u_char		UCHAR_T;
 #define STRTOUL		strtoul
 #define SPRINTF		snprintf
 #define STRCHR		strchr
+#define MEMCHR		memchr
 #define STRCMP		strcmp
 #define STRPBRK		strpbrk
 #define TOLOWER		tolower
@@ -25,6 +25,7 @@ static const char sccsid[] = "$Id: nothread.c,v 1.4 2000/07/22 14:52:37 skimo Ex
 #include "../common/common.h"
 
 static int vi_nothread_run __P((WIN *wp, void *(*fun)(void*), void *data));
+static int vi_nothread_run_wait __P((WIN *wp, void *(*fun)(void*), void **data, int n));
 static int vi_nothread_lock __P((WIN *, void **));
 
 /*
@@ -36,9 +37,12 @@ void
 thread_init(GS *gp)
 {
 	gp->run = vi_nothread_run;
+	gp->run_wait = vi_nothread_run_wait;
+	gp->nthreads = 1;
 	gp->lock_init = vi_nothread_lock;
 	gp->lock_end = vi_nothread_lock;
 	gp->lock_try = vi_nothread_lock;
+	gp->lock_lock = vi_nothread_lock;
 	gp->lock_unlock = vi_nothread_lock;
 }
 
@@ -49,6 +53,14 @@ vi_nothread_run(WIN *wp, void *(*fun)(void*), void *data)
 	return 0;
 }
 
+static int
+vi_nothread_run_wait(WIN *wp, void *(*fun)(void*), void **data, int n)
+{
+	while (n-- > 0)
+		fun(*data++);
+	return 0;
+}
+
 static int 
 vi_nothread_lock (WIN * wp, void **lp)
 {
@@ -41,6 +41,12 @@ static int	 	 opts_print __P((SCR *, OPTLIST const *));
 #define OPT_WC	    (OPT_NOSAVE | OPT_NDISP)
 #endif
 
+#ifdef USE_BUNDLED_DB
+#define OPT_DB1	    0
+#else
+#define OPT_DB1	    (OPT_NOSAVE | OPT_NDISP)
+#endif
+
 /*
  * O'Reilly noted options and abbreviations are from "Learning the VI Editor",
  * Fifth Edition, May 1992.  There's no way of knowing what systems they are
@@ -52,6 +58,8 @@ static int	 	 opts_print __P((SCR *, OPTLIST const *));
 OPTLIST const optlist[] = {
 /* O_ALTWERASE	  4.4BSD */
 	{L("altwerase"),	f_altwerase,	OPT_0BOOL,	0},
+/* O_ATOMICWRITE */
+	{L("atomicwrite"),	NULL,		OPT_0BOOL,	0},
 /* O_AUTOINDENT	    4BSD */
 	{L("autoindent"),	NULL,		OPT_0BOOL,	0},
 /* O_AUTOPRINT	    4BSD */
@@ -102,8 +110,12 @@ OPTLIST const optlist[] = {
 	{L("keytime"),	NULL,		OPT_NUM,	0},
 /* O_LEFTRIGHT	  4.4BSD */
 	{L("leftright"),	f_reformat,	OPT_0BOOL,	0},
+/* O_LINECACHE */
+	{L("linecache"),	f_linecache,	OPT_NUM,	OPT_NOZERO},
 /* O_LINES	  4.4BSD */
 	{L("lines"),	f_lines,	OPT_NUM,	OPT_NOSAVE},
+/* O_LINESTORE */
+	{L("linestore"),	NULL,		OPT_0BOOL,	OPT_DB1},
 /* O_LISP	    4BSD
  *	XXX
  *	When the lisp option is implemented, delete the OPT_NOSAVE flag,
@@ -145,6 +157,10 @@ OPTLIST const optlist[] = {
 	{L("open"),	NULL,		OPT_1BOOL,	0},
 /* O_OPTIMIZE	    4BSD */
 	{L("optimize"),	NULL,		OPT_1BOOL,	0},
+/* O_PAGECACHE */
+	{L("pagecache"),	NULL,		OPT_NUM,	OPT_DB1},
+/* O_PAGESIZE */
+	{L("pagesize"),	NULL,		OPT_NUM,	OPT_DB1},
 /* O_PARAGRAPHS	    4BSD */
 	{L("paragraphs"),	f_paragraph,	OPT_STR,	0},
 /* O_PATH	  4.4BSD */
@@ -358,6 +374,7 @@ opts_init(SCR *sp, int *oargs)
 	OI(O_TMP_DIRECTORY, b2);
 	OI(O_ESCAPETIME, L("escapetime=1"));
 	OI(O_KEYTIME, L("keytime=6"));
+	OI(O_LINECACHE, L("linecache=128"));
 	OI(O_MATCHTIME, L("matchtime=7"));
 	(void)SPRINTF(b2, SIZE(b2), L("msgcat=%s"), _PATH_MSGCAT);
 	OI(O_MSGCAT, b2);
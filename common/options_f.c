@@ -122,6 +122,22 @@ f_lines(SCR *sp, OPTION *op, char *str, u_long *valp)
 	return (0);
 }
 
+/*
+ * PUBLIC: int f_linecache __P((SCR *, OPTION *, char *, u_long *));
+ */
+int
+f_linecache(SCR *sp, OPTION *op, char *str, u_long *valp)
+{
+	/*
+	 * The line cache belongs to the file, not the screen; resize the
+	 * cache of the file being edited, if there is one.  Any other file
+	 * gets a cache of the new size when it's next opened.
+	 */
+	if (sp->ep != NULL && *valp != sp->ep->lcache.nlines)
+		return (lcache_init(sp, sp->ep, *valp));
+	return (0);
+}
+
 /*
  * PUBLIC: int f_lisp __P((SCR *, OPTION *, char *, u_long *));
  */
@@ -206,6 +222,7 @@ f_recompile(SCR *sp, OPTION *op, char *str, u_long *valp)
 {
 	if (F_ISSET(sp, SC_RE_SEARCH)) {
 		regfree(&sp->re_c);
+		regfree(&sp->re_bc);
 		F_CLR(sp, SC_RE_SEARCH);
 	}
 	if (F_ISSET(sp, SC_RE_SUBST)) {
@@ -321,5 +338,13 @@ f_encoding(SCR *sp, OPTION *op, char *str, u_long *valp)
 {
 	int offset = op - sp->opts;
 
-	return conv_enc(sp, offset, str);
+	if (conv_enc(sp, offset, str))
+		return (1);
+
+	/* Cached lines and the motion index used the old file encoding. */
+	if (offset == O_FILEENCODING && sp->ep != NULL) {
+		lcache_flush(sp->ep);
+		mindex_end(sp->ep);
+	}
+	return (0);
 }
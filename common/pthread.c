@@ -27,9 +27,11 @@ static const char sccsid[] = "$Id: pthread.c,v 1.4 2000/07/22 14:52:37 skimo Exp
 #include "../common/common.h"
 
 static int vi_pthread_run __P((WIN *wp, void *(*fun)(void*), void *data));
+static int vi_pthread_run_wait __P((WIN *wp, void *(*fun)(void*), void **data, int n));
 static int vi_pthread_lock_init __P((WIN *, void **));
 static int vi_pthread_lock_end __P((WIN *, void **));
 static int vi_pthread_lock_try __P((WIN *, void **));
+static int vi_pthread_lock_lock __P((WIN *, void **));
 static int vi_pthread_lock_unlock __P((WIN *, void **));
 
 /*
@@ -41,17 +43,58 @@ void
 thread_init(GS *gp)
 {
 	gp->run = vi_pthread_run;
+	gp->run_wait = vi_pthread_run_wait;
+#ifdef _SC_NPROCESSORS_ONLN
+	if ((gp->nthreads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+#endif
+		gp->nthreads = 1;
 	gp->lock_init = vi_pthread_lock_init;
 	gp->lock_end = vi_pthread_lock_end;
 	gp->lock_try = vi_pthread_lock_try;
+	gp->lock_lock = vi_pthread_lock_lock;
 	gp->lock_unlock = vi_pthread_lock_unlock;
 }
 
+/*
+ * vi_pthread_run --
+ *	Run the function in a thread of its own, or in this one if no
+ *	thread can be had.  Nobody waits for the thread, so detach it.
+ */
 static int
 vi_pthread_run(WIN *wp, void *(*fun)(void*), void *data)
 {
-	pthread_t *t = malloc(sizeof(pthread_t));
-	pthread_create(t, NULL, fun, data);
+	pthread_t t;
+
+	if (pthread_create(&t, NULL, fun, data)) {
+		fun(data);
+		return 0;
+	}
+	(void)pthread_detach(t);
+	return 0;
+}
+
+/*
+ * vi_pthread_run_wait --
+ *	Run the function on each of the data, the first in this thread and
+ *	the rest in threads of their own, and wait for them all to finish.
+ *	Anything that can't get a thread is run in this one.
+ */
+static int
+vi_pthread_run_wait(WIN *wp, void *(*fun)(void*), void **data, int n)
+{
+	pthread_t *t;
+	int i, nt;
+
+	MALLOC_RET(NULL, t, pthread_t *, n * sizeof(pthread_t));
+	for (nt = 1; nt < n; ++nt)
+		if (pthread_create(&t[nt], NULL, fun, data[nt]))
+			break;
+	fun(data[0]);
+	for (i = nt; i < n; ++i)
+		fun(data[i]);
+	for (i = 1; i < nt; ++i)
+		(void)pthread_join(t[i], NULL);
+	free(t);
 	return 0;
 }
 
@@ -89,17 +132,17 @@ vi_pthread_lock_end (WIN * wp, void **p)
 static int 
 vi_pthread_lock_try (WIN * wp, void **p)
 {
-	printf("try %p\n", *p);
-	fflush(stdout);
-	return 0;
 	return pthread_mutex_trylock((pthread_mutex_t *)*p);
 }
 
+static int 
+vi_pthread_lock_lock (WIN * wp, void **p)
+{
+	return pthread_mutex_lock((pthread_mutex_t *)*p);
+}
+
 static int 
 vi_pthread_lock_unlock (WIN * wp, void **p)
 {
-	printf("unlock %p\n", *p);
-	return 0;
 	return pthread_mutex_unlock((pthread_mutex_t *)*p);
 }
-
@@ -25,6 +25,8 @@ static const char sccsid[] = "$Id: put.c,v 10.18 2001/06/25 15:19:11 skimo Exp $
 
 #include "common.h"
 
+static int	put_lines __P((SCR *, CB *, TEXT *, void *, db_recno_t *));
+
 /*
  * put --
  *	Put text buffer contents into the file.
@@ -80,10 +82,8 @@ put(SCR *sp, CB *cbp, CHAR_T *namep, MARK *cp, MARK *rp, int append)
 		if (db_last(sp, &lno))
 			return (1);
 		if (lno == 0) {
-			for (; tp != (void *)&cbp->textq;
-			    ++lno, ++sp->rptlines[L_ADDED], tp = tp->q.cqe_next)
-				if (db_append(sp, 1, lno, tp->lb, tp->len))
-					return (1);
+			if (put_lines(sp, cbp, tp, (void *)&cbp->textq, &lno))
+				return (1);
 			rp->lno = 1;
 			rp->cno = 0;
 			return (0);
@@ -94,10 +94,8 @@ put(SCR *sp, CB *cbp, CHAR_T *namep, MARK *cp, MARK *rp, int append)
 	if (F_ISSET(cbp, CB_LMODE)) {
 		lno = append ? cp->lno : cp->lno - 1;
 		rp->lno = lno + 1;
-		for (; tp != (void *)&cbp->textq;
-		    ++lno, ++sp->rptlines[L_ADDED], tp = tp->q.cqe_next)
-			if (db_append(sp, 1, lno, tp->lb, tp->len))
-				return (1);
+		if (put_lines(sp, cbp, tp, (void *)&cbp->textq, &lno))
+			return (1);
 		rp->cno = 0;
 		(void)nonblank(sp, rp->lno, &rp->cno);
 		return (0);
@@ -207,11 +205,8 @@ put(SCR *sp, CB *cbp, CHAR_T *namep, MARK *cp, MARK *rp, int append)
 		}
 
 		/* Output any intermediate lines in the CB. */
-		for (tp = tp->q.cqe_next;
-		    tp->q.cqe_next != (void *)&cbp->textq;
-		    ++lno, ++sp->rptlines[L_ADDED], tp = tp->q.cqe_next)
-			if (db_append(sp, 1, lno, tp->lb, tp->len))
-				goto err;
+		if (put_lines(sp, cbp, tp->q.cqe_next, ltp, &lno))
+			goto err;
 
 		if (db_append(sp, 1, lno, t, clen))
 			goto err;
@@ -225,3 +220,43 @@ err:		rval = 1;
 	FREE_SPACEW(sp, bp, blen);
 	return (rval);
 }
+
+/*
+ * put_lines --
+ *	Append the CB lines from tp up to, but not including, etp after
+ *	line *lnop, updating *lnop.
+ */
+static int
+put_lines(SCR *sp, CB *cbp, TEXT *tp, void *etp, db_recno_t *lnop)
+{
+	TEXT *ltp;
+	db_recno_t n;
+	int rval;
+
+	for (; tp != etp; tp = ltp->q.cqe_next) {
+		/*
+		 * Cut buffer lines are stored one after another, each followed
+		 * by a <newline>, see cut.h.  Find the run of lines that starts
+		 * with this one and append it as a block, unless a line holds
+		 * a <newline> of its own and would be split.
+		 */
+		ltp = tp;
+		if (!F_ISSET(cbp, CB_NEWLINE))
+			while (ltp->q.cqe_next != etp &&
+			    ltp->q.cqe_next->lb == ltp->lb + ltp->len + 1)
+				ltp = ltp->q.cqe_next;
+		if (ltp == tp) {
+			if (db_append(sp, 1, *lnop, tp->lb, tp->len))
+				return (1);
+			n = 1;
+			rval = 0;
+		} else
+			rval = db_append_block(sp, *lnop,
+			    tp->lb, (ltp->lb + ltp->len + 1) - tp->lb, &n);
+		*lnop += n;
+		sp->rptlines[L_ADDED] += n;
+		if (rval)
+			return (1);
+	}
+	return (0);
+}
@@ -104,16 +104,77 @@ static const char sccsid[] = "$Id: recover.c,v 10.31 2001/11/01 15:24:44 skimo E
  * to be long-lived, changing their format won't be too painful.
  *
  * Btree files are named "vi.XXXX" and recovery files are named "recover.XXXX".
+ *
+ * Snapshots (:preserve) are kept in a pair of btree files and a mail recovery
+ * file that names whichever of the pair holds the last complete snapshot.
+ * The files of the pair are written in turn.  The DB package tells us the
+ * number of each backing file page it's about to overwrite, so a snapshot
+ * only copies the pages written since the last snapshot into the same file.
+ * The copy is a job run through gp->run, so it may run in a thread of its
+ * own.  Pages the job hasn't copied yet are copied by rcv_pgwrite before
+ * the DB package overwrites them, which means the snapshot is of the backing
+ * file as it was when it was sync'd, however long the copy takes.  When the
+ * copy is on disk, the mail file is replaced with rename(2), so rcv_read()
+ * never sees a partial snapshot.  The btree file of the pair that isn't
+ * named by the mail file keeps the owner execute bit, so it's deleted at
+ * boot time if we crash while writing it.
  */
 
 #define	VI_FHEADER	"X-vi-recover-file: "
 #define	VI_PHEADER	"X-vi-recover-path: "
 
+#define	RCV_MAILLEN	(8 * 1024)	/* Mail recovery file text. */
+
+struct _rcvsnap {
+	GS	*gp;			/* Lock routines. */
+	u_long	 psize;			/* Backing file page size. */
+	int	 rfd;			/* Backing file descriptor. */
+	char	*hbuf;			/* Page buffer, rcv_pgwrite. */
+	char	*jbuf;			/* Page buffer, rcv_snapjob. */
+
+	char	 path[2][MAXPATHLEN];	/* Snapshot btree files. */
+	int	 fd[2];			/* Snapshot btree file descriptors. */
+	bitstr_t *dirty[2];		/* Pages written since each snapshot. */
+	int	 full[2];		/* Copy every page. */
+	size_t	 nbits;			/* Bits in the dirty maps. */
+	int	 cur;			/* Last complete snapshot, or -1. */
+	int	 reap;			/* Job to reap. */
+
+	/* Shared with the job; pend, busy and err are under the lock. */
+	void	*lock;			/* Lock. */
+	int	 busy;			/* Job running. */
+	int	 err;			/* Job failed: errno. */
+	int	 to;			/* Snapshot file being written. */
+	bitstr_t *pend;			/* Pages still to copy. */
+	db_pgno_t npend;		/* Pages in the snapshot. */
+	off_t	 size;			/* Bytes in the snapshot. */
+	int	 mnew;			/* Mail file not yet created. */
+	char	 mpath[MAXPATHLEN];	/* Snapshot mail file. */
+	int	 tfd;			/* Temporary mail file descriptor. */
+	int	 tdone;			/* Temporary mail file renamed. */
+	char	 tpath[MAXPATHLEN];	/* Temporary mail file. */
+	size_t	 mlen;			/* Mail file text length. */
+	char	 mtext[RCV_MAILLEN];	/* Mail file text. */
+	char	*cmd;			/* Email command, or NULL. */
+	char	 cmdbuf[MAXPATHLEN * 2 + 20];
+};
+
+#define	RCV_LOCK(rs)	(void)(rs)->gp->lock_lock(NULL, &(rs)->lock)
+#define	RCV_UNLOCK(rs)	(void)(rs)->gp->lock_unlock(NULL, &(rs)->lock)
+
 static int	 rcv_copy __P((SCR *, int, char *));
 static void	 rcv_email __P((SCR *, char *));
+static int	 rcv_emailcmd __P((SCR *, char *, char *, size_t));
 static char	*rcv_gets __P((char *, size_t, int));
 static int	 rcv_mailfile __P((SCR *, int, char *));
+static int	 rcv_mailtext __P((SCR *, char *, char *, size_t *));
 static int	 rcv_mktemp __P((SCR *, char *, char *, int));
+static int	 rcv_pgcopy __P((RCVSNAP *, db_pgno_t, int, char *));
+static void	 rcv_pgwrite __P((void *, db_pgno_t));
+static int	 rcv_snapinit __P((SCR *, EXF *));
+static void	*rcv_snapjob __P((void *));
+static int	 rcv_snapshot __P((SCR *));
+static int	 rcv_snapwait __P((SCR *, RCVSNAP *, int));
 
 /*
  * rcv_tmp --
@@ -212,7 +273,7 @@ rcv_init(SCR *sp)
 		/* Turn on a busy message, and sync it to backing store. */
 		sp->gp->scr_busy(sp,
 		    "057|Copying file for recovery...", BUSY_ON);
-		if (ep->db->sync(ep->db, 0)) {
+		if (db_sync(sp, ep)) {
 			msgq_str(sp, M_SYSERR, ep->rcv_path,
 			    "058|Preservation failed: %s");
 			sp->gp->scr_busy(sp, NULL, BUSY_OFF);
@@ -247,8 +308,7 @@ int
 rcv_sync(SCR *sp, u_int flags)
 {
 	EXF *ep;
-	int fd, rval;
-	char *dp, buf[1024];
+	int rval;
 
 	/* Make sure that there's something to recover/sync. */
 	ep = sp->ep;
@@ -257,7 +317,7 @@ rcv_sync(SCR *sp, u_int flags)
 
 	/* Sync the file if it's been modified. */
 	if (F_ISSET(ep, F_MODIFIED)) {
-		if (ep->db->sync(ep->db, 0)) {
+		if (db_sync(sp, ep)) {
 			F_CLR(ep, F_RCV_ON | F_RCV_NORM);
 			msgq_str(sp, M_SYSERR,
 			    ep->rcv_path, "060|File backup failed: %s");
@@ -279,37 +339,398 @@ rcv_sync(SCR *sp, u_int flags)
 	 * the recovery information, i.e. it's like the user re-edited the
 	 * file.  We copy the DB(3) backing file, and then create a new mail
 	 * recovery file, it's simpler than exiting and reopening all of the
-	 * underlying files.
+	 * underlying files.  See the comment at the top of the file.
 	 *
 	 * REQUEST: snapshot the file.
 	 */
 	rval = 0;
-	if (LF_ISSET(RCV_SNAPSHOT)) {
-		if (opts_empty(sp, O_RECDIR, 0))
-			goto err;
-		dp = O_STR(sp, O_RECDIR);
-		(void)snprintf(buf, sizeof(buf), "%s/vi.XXXXXX", dp);
-		if ((fd = rcv_mktemp(sp, buf, dp, S_IRUSR | S_IWUSR)) == -1)
+	if (LF_ISSET(RCV_SNAPSHOT) && rcv_snapshot(sp))
+		rval = 1;
+
+	/* REQUEST: end the file session. */
+	if (LF_ISSET(RCV_ENDSESSION) && file_end(sp, NULL, 1))
+		rval = 1;
+
+	return (rval);
+}
+
+/*
+ * rcv_snapshot --
+ *	Snapshot the backing file, and build a mail recovery file for it.
+ */
+static int
+rcv_snapshot(SCR *sp)
+{
+	struct stat sb;
+	EXF *ep;
+	RCVSNAP *rs;
+	db_pgno_t n;
+	int fd, rval, to;
+	char *dp, buf[MAXPATHLEN];
+
+	if (opts_empty(sp, O_RECDIR, 0))
+		return (1);
+	dp = O_STR(sp, O_RECDIR);
+
+	/*
+	 * If the DB package can't tell us which pages it writes, copy the
+	 * whole backing file, the historic way.
+	 */
+	ep = sp->ep;
+	if (ep->rcv_snap == NULL)
+		switch (rcv_snapinit(sp, ep)) {
+		case 0:
+			break;
+		case -1:
+			(void)snprintf(buf, sizeof(buf), "%s/vi.XXXXXX", dp);
+			if ((fd =
+			    rcv_mktemp(sp, buf, dp, S_IRUSR | S_IWUSR)) == -1)
+				return (1);
+			sp->gp->scr_busy(sp,
+			    "061|Copying file for recovery...", BUSY_ON);
+			rval = 0;
+			if (rcv_copy(sp, fd, ep->rcv_path) ||
+			    close(fd) || rcv_mailfile(sp, 1, buf)) {
+				(void)unlink(buf);
+				(void)close(fd);
+				rval = 1;
+			}
+			sp->gp->scr_busy(sp, NULL, BUSY_OFF);
+			return (rval);
+		default:
+			return (1);
+		}
+	rs = ep->rcv_snap;
+
+	/* Finish the last snapshot; the pair is written in turn. */
+	rval = rcv_snapwait(sp, rs, 1);
+	to = rs->cur == 0 ? 1 : 0;
+
+	/* Bring the backing file up-to-date, and find out how big it is. */
+	if (db_sync(sp, ep) || fstat(rs->rfd, &sb)) {
+		msgq_str(sp, M_SYSERR, ep->rcv_path,
+		    "058|Preservation failed: %s");
+		return (1);
+	}
+
+	/* Build the mail file text, and a temporary file to write it to. */
+	if (rcv_mailtext(sp, rs->path[to], rs->mtext, &rs->mlen))
+		return (1);
+	(void)snprintf(rs->tpath, sizeof(rs->tpath), "%s/vi.XXXXXX", dp);
+	if ((rs->tfd = rcv_mktemp(sp, rs->tpath, dp, S_IRWXU)) == -1)
+		return (1);
+	rs->cmd = rcv_emailcmd(sp,
+	    rs->mpath, rs->cmdbuf, sizeof(rs->cmdbuf)) ? NULL : rs->cmdbuf;
+
+	/* Build the list of pages to copy. */
+	rs->size = sb.st_size;
+	rs->npend = (sb.st_size + rs->psize - 1) / rs->psize;
+	if ((rs->pend = bit_alloc(rs->npend + 1)) == NULL) {
+		msgq(sp, M_SYSERR, NULL);
+		(void)close(rs->tfd);
+		(void)unlink(rs->tpath);
+		rs->tfd = -1;
+		return (1);
+	}
+	if (rs->full[to]) {
+		if (rs->npend != 0)
+			bit_nset(rs->pend, 0, rs->npend - 1);
+	} else if ((n = MIN(rs->npend, rs->nbits)) != 0)
+		memcpy(rs->pend, rs->dirty[to], bitstr_size(n));
+	if (rs->nbits != 0)
+		memset(rs->dirty[to], 0, bitstr_size(rs->nbits));
+	rs->full[to] = 0;
+
+	rs->to = to;
+	rs->err = rs->tdone = 0;
+	rs->busy = rs->reap = 1;
+	sp->gp->scr_busy(sp, "061|Copying file for recovery...", BUSY_ON);
+	(void)sp->gp->run(sp->wp, rcv_snapjob, rs);
+	sp->gp->scr_busy(sp, NULL, BUSY_OFF);
+
+	/* If the job is already done, say how it went. */
+	if (rcv_snapwait(sp, rs, 0))
+		rval = 1;
+	return (rval);
+}
+
+/*
+ * rcv_snapinit --
+ *	Set up the snapshot files, and have the DB package tell us which
+ *	backing file pages it writes.  Returns -1 if it can't.
+ */
+static int
+rcv_snapinit(SCR *sp, EXF *ep)
+{
+	RCVSNAP *rs;
+	u_long psize;
+	int i;
+	char *dp;
+
+	CALLOC_RET(sp, rs, RCVSNAP *, 1, sizeof(RCVSNAP));
+	rs->gp = sp->gp;
+	rs->rfd = rs->fd[0] = rs->fd[1] = rs->tfd = -1;
+	rs->full[0] = rs->full[1] = 1;
+	rs->cur = -1;
+	if (db_rcv_track(sp, ep, rcv_pgwrite, rs, &rs->psize)) {
+		free(rs);
+		return (-1);
+	}
+
+	dp = O_STR(sp, O_RECDIR);
+	if (rs->gp->lock_init(sp->wp, &rs->lock)) {
+		msgq(sp, M_SYSERR, NULL);
+		goto err;
+	}
+	MALLOC_GOTO(sp, rs->hbuf, char *, rs->psize);
+	MALLOC_GOTO(sp, rs->jbuf, char *, rs->psize);
+	if ((rs->rfd = open(ep->rcv_path, O_RDONLY, 0)) == -1) {
+		msgq_str(sp, M_SYSERR, ep->rcv_path, "%s");
+		goto err;
+	}
+
+	/*
+	 * Neither btree file holds a snapshot, so both get the owner execute
+	 * bit.  The mail file is created when the first snapshot is done.
+	 */
+	for (i = 0; i < 2; ++i) {
+		(void)snprintf(rs->path[i],
+		    sizeof(rs->path[i]), "%s/vi.XXXXXX", dp);
+		if ((rs->fd[i] =
+		    rcv_mktemp(sp, rs->path[i], dp, S_IRWXU)) == -1)
 			goto err;
-		sp->gp->scr_busy(sp,
-		    "061|Copying file for recovery...", BUSY_ON);
-		if (rcv_copy(sp, fd, ep->rcv_path) ||
-		    close(fd) || rcv_mailfile(sp, 1, buf)) {
-			(void)unlink(buf);
-			(void)close(fd);
-			rval = 1;
+	}
+	(void)snprintf(rs->mpath, sizeof(rs->mpath), "%s/recover.XXXXXX", dp);
+	rs->mnew = 1;
+
+	ep->rcv_snap = rs;
+	return (0);
+
+alloc_err:
+err:	(void)db_rcv_track(sp, ep, NULL, NULL, &psize);
+	for (i = 0; i < 2; ++i)
+		if (rs->fd[i] != -1) {
+			(void)close(rs->fd[i]);
+			(void)unlink(rs->path[i]);
 		}
-		sp->gp->scr_busy(sp, NULL, BUSY_OFF);
+	if (rs->rfd != -1)
+		(void)close(rs->rfd);
+	if (rs->lock != NULL)
+		(void)rs->gp->lock_end(sp->wp, &rs->lock);
+	if (rs->hbuf != NULL)
+		free(rs->hbuf);
+	if (rs->jbuf != NULL)
+		free(rs->jbuf);
+	free(rs);
+	return (1);
+}
+
+/*
+ * rcv_snapjob --
+ *	Copy the pages of a snapshot, then put the mail file in place.
+ */
+static void *
+rcv_snapjob(void *arg)
+{
+	RCVSNAP *rs;
+	db_pgno_t pg;
+	size_t off;
+	ssize_t nw;
+	int err, fd, mfd;
+
+	rs = arg;
+	fd = rs->fd[rs->to];
+
+	/* Copy the pages rcv_pgwrite hasn't already copied. */
+	for (err = 0, pg = 0; pg < rs->npend; ++pg) {
+		RCV_LOCK(rs);
+		if (bit_test(rs->pend, pg)) {
+			bit_clear(rs->pend, pg);
+			if ((err = rcv_pgcopy(rs, pg, fd, rs->jbuf)) != 0)
+				rs->err = err;
+		}
+		err = rs->err;
+		RCV_UNLOCK(rs);
+		if (err)
+			goto err;
+	}
+	if (ftruncate(fd, rs->size) || fsync(fd) ||
+	    fchmod(fd, S_IRUSR | S_IWUSR))
+		goto syserr;
+
+	/* Write the mail file, and replace the last one with it. */
+	for (off = 0; off < rs->mlen; off += nw)
+		if ((nw = write(rs->tfd,
+		    rs->mtext + off, rs->mlen - off)) < 0)
+			goto syserr;
+	if (fsync(rs->tfd) || close(rs->tfd)) {
+		rs->tfd = -1;
+		goto syserr;
+	}
+	rs->tfd = -1;
+	if (rs->mnew) {
+		if ((mfd = mkstemp(rs->mpath)) == -1)
+			goto syserr;
+		(void)close(mfd);
+		rs->mnew = 0;
 	}
+	if (rename(rs->tpath, rs->mpath))
+		goto syserr;
+	rs->tdone = 1;
+	(void)chmod(rs->mpath, S_IRUSR | S_IWUSR);
+
+	/* The other btree file no longer holds a snapshot. */
+	if (rs->cur != -1)
+		(void)fchmod(rs->fd[rs->cur], S_IRWXU);
+
+	if (rs->cmd != NULL)
+		(void)system(rs->cmd);
+
 	if (0) {
-err:		rval = 1;
+syserr:		err = errno;
+err:		;
 	}
+	RCV_LOCK(rs);
+	if (err)
+		rs->err = err;
+	rs->busy = 0;
+	RCV_UNLOCK(rs);
+	return (NULL);
+}
 
-	/* REQUEST: end the file session. */
-	if (LF_ISSET(RCV_ENDSESSION) && file_end(sp, NULL, 1))
-		rval = 1;
+/*
+ * rcv_snapwait --
+ *	Reap the snapshot job, waiting for it to finish if wait is set.
+ */
+static int
+rcv_snapwait(SCR *sp, RCVSNAP *rs, int wait)
+{
+	int busy;
 
-	return (rval);
+	if (!rs->reap)
+		return (0);
+	for (;;) {
+		RCV_LOCK(rs);
+		busy = rs->busy;
+		RCV_UNLOCK(rs);
+		if (!busy)
+			break;
+		if (!wait)
+			return (0);
+		(void)usleep(10000);
+	}
+	rs->reap = 0;
+	free(rs->pend);
+	rs->pend = NULL;
+
+	if (rs->tfd != -1) {
+		(void)close(rs->tfd);
+		rs->tfd = -1;
+	}
+	if (rs->err) {
+		if (!rs->tdone)
+			(void)unlink(rs->tpath);
+		rs->full[rs->to] = 1;
+		errno = rs->err;
+		msgq_str(sp, M_SYSERR, rs->path[rs->to],
+		    "058|Preservation failed: %s");
+		return (1);
+	}
+	rs->cur = rs->to;
+	return (0);
+}
+
+/*
+ * rcv_pgwrite --
+ *	Note that a backing file page is about to be overwritten.  If a
+ *	running snapshot hasn't copied it yet, copy it first.
+ */
+static void
+rcv_pgwrite(void *cookie, db_pgno_t pgno)
+{
+	RCVSNAP *rs;
+	size_t len, nbits, olen;
+	bitstr_t *bp;
+	int i;
+
+	rs = cookie;
+	if (pgno >= rs->nbits) {
+		nbits = MAX((size_t)pgno + 1, rs->nbits * 2);
+		len = bitstr_size(nbits);
+		olen = rs->nbits == 0 ? 0 : bitstr_size(rs->nbits);
+		for (i = 0; i < 2; ++i) {
+			if ((bp = realloc(rs->dirty[i], len)) == NULL)
+				break;
+			memset(bp + olen, 0, len - olen);
+			rs->dirty[i] = bp;
+		}
+		if (i == 2)
+			rs->nbits = nbits;
+	}
+	if (pgno < rs->nbits) {
+		bit_set(rs->dirty[0], pgno);
+		bit_set(rs->dirty[1], pgno);
+	} else
+		rs->full[0] = rs->full[1] = 1;
+
+	RCV_LOCK(rs);
+	if (rs->busy && !rs->err &&
+	    pgno < rs->npend && bit_test(rs->pend, pgno)) {
+		bit_clear(rs->pend, pgno);
+		rs->err = rcv_pgcopy(rs, pgno, rs->fd[rs->to], rs->hbuf);
+	}
+	RCV_UNLOCK(rs);
+}
+
+/*
+ * rcv_pgcopy --
+ *	Copy a page of the backing file into a snapshot file.  Returns an
+ *	errno value, not a message; this may be run by the snapshot job.
+ */
+static int
+rcv_pgcopy(RCVSNAP *rs, db_pgno_t pgno, int fd, char *bp)
+{
+	off_t off;
+	ssize_t nr;
+
+	off = (off_t)pgno * rs->psize;
+	if ((nr = pread(rs->rfd, bp, rs->psize, off)) < 0)
+		return (errno);
+	if (nr != 0 && pwrite(fd, bp, nr, off) != nr)
+		return (errno == 0 ? EIO : errno);
+	return (0);
+}
+
+/*
+ * rcv_end --
+ *	Finish the file's snapshots, keeping the last one.
+ *
+ * PUBLIC: void rcv_end __P((SCR *, EXF *));
+ */
+void
+rcv_end(SCR *sp, EXF *ep)
+{
+	RCVSNAP *rs;
+	int i;
+
+	if ((rs = ep->rcv_snap) == NULL)
+		return;
+	(void)rcv_snapwait(sp, rs, 1);
+	for (i = 0; i < 2; ++i) {
+		(void)close(rs->fd[i]);
+		if (i != rs->cur)
+			(void)unlink(rs->path[i]);
+	}
+	(void)close(rs->rfd);
+	(void)rs->gp->lock_end(sp->wp, &rs->lock);
+	free(rs->hbuf);
+	free(rs->jbuf);
+	if (rs->dirty[0] != NULL)
+		free(rs->dirty[0]);
+	if (rs->dirty[1] != NULL)
+		free(rs->dirty[1]);
+	free(rs);
+	ep->rcv_snap = NULL;
 }
 
 /*
@@ -320,31 +741,15 @@ static int
 rcv_mailfile(SCR *sp, int issync, char *cp_path)
 {
 	EXF *ep;
-	GS *gp;
-	struct passwd *pw;
 	size_t len;
-	time_t now;
-	uid_t uid;
 	int fd;
-	char *dp, *p, *t, buf[4096], mpath[MAXPATHLEN];
-	char *t1, *t2, *t3;
+	char *dp, mpath[MAXPATHLEN], mbuf[RCV_MAILLEN];
 
-	/*
-	 * XXX
-	 * MAXHOSTNAMELEN is in various places on various systems, including
-	 * <netdb.h> and <sys/socket.h>.  If not found, use a large default.
-	 */
-#ifndef MAXHOSTNAMELEN
-#define	MAXHOSTNAMELEN	1024
-#endif
-	char host[MAXHOSTNAMELEN];
-
-	gp = sp->gp;
-	if ((pw = getpwuid(uid = getuid())) == NULL) {
-		msgq(sp, M_ERR,
-		    "062|Information on user id %u not found", uid);
+	ep = sp->ep;
+	if (!issync)
+		cp_path = ep->rcv_path;
+	if (rcv_mailtext(sp, cp_path, mbuf, &len))
 		return (1);
-	}
 
 	if (opts_empty(sp, O_RECDIR, 0))
 		return (1);
@@ -360,7 +765,6 @@ rcv_mailfile(SCR *sp, int issync, char *cp_path)
 	 * be recovered.  There's an obvious window between the mkstemp call
 	 * and the lock, but it's pretty small.
 	 */
-	ep = sp->ep;
 	if (file_lock(sp, NULL, NULL, fd, 1) != LOCK_SUCCESS)
 		msgq(sp, M_SYSERR, "063|Unable to lock recovery file");
 	if (!issync) {
@@ -370,7 +774,6 @@ rcv_mailfile(SCR *sp, int issync, char *cp_path)
 			msgq(sp, M_SYSERR, NULL);
 			goto err;
 		}
-		cp_path = ep->rcv_path;
 	}
 
 	/*
@@ -380,6 +783,58 @@ rcv_mailfile(SCR *sp, int issync, char *cp_path)
 	 * lock is lost.  So, we could never close the FILE *, even if we
 	 * dup'd the fd first.
 	 */
+	if (write(fd, mbuf, len) != len)
+		goto werr;
+
+	if (issync) {
+		rcv_email(sp, mpath);
+		if (close(fd)) {
+werr:			msgq(sp, M_SYSERR, "065|Recovery file");
+			goto err;
+		}
+	}
+	return (0);
+
+err:	if (!issync)
+		ep->rcv_fd = -1;
+	if (fd != -1)
+		(void)close(fd);
+	return (1);
+}
+
+/*
+ * rcv_mailtext --
+ *	Build the text of the file to mail to the user, naming cp_path as
+ *	the backing file, into mbuf, which is RCV_MAILLEN bytes long.
+ */
+static int
+rcv_mailtext(SCR *sp, char *cp_path, char *mbuf, size_t *lenp)
+{
+	GS *gp;
+	struct passwd *pw;
+	size_t len, mlen;
+	time_t now;
+	uid_t uid;
+	char *p, *t, buf[4096];
+	char *t1, *t2, *t3;
+
+	/*
+	 * XXX
+	 * MAXHOSTNAMELEN is in various places on various systems, including
+	 * <netdb.h> and <sys/socket.h>.  If not found, use a large default.
+	 */
+#ifndef MAXHOSTNAMELEN
+#define	MAXHOSTNAMELEN	1024
+#endif
+	char host[MAXHOSTNAMELEN];
+
+	gp = sp->gp;
+	if ((pw = getpwuid(uid = getuid())) == NULL) {
+		msgq(sp, M_ERR,
+		    "062|Information on user id %u not found", uid);
+		return (1);
+	}
+
 	t = sp->frp->name;
 	if ((p = strrchr(t, '/')) == NULL)
 		p = t;
@@ -387,7 +842,7 @@ rcv_mailfile(SCR *sp, int issync, char *cp_path)
 		++p;
 	(void)time(&now);
 	(void)gethostname(host, sizeof(host));
-	len = snprintf(buf, sizeof(buf),
+	mlen = snprintf(mbuf, sizeof(buf),
 	    "%s%s\n%s%s\n%s\n%s\n%s%s\n%s%s\n%s\n\n",
 	    VI_FHEADER, t,			/* Non-standard. */
 	    VI_PHEADER, cp_path,		/* Non-standard. */
@@ -396,10 +851,8 @@ rcv_mailfile(SCR *sp, int issync, char *cp_path)
 	    "To: ", pw->pw_name,
 	    "Subject: Nvi saved the file ", p,
 	    "Precedence: bulk");		/* For vacation(1). */
-	if (len > sizeof(buf) - 1)
+	if (mlen > sizeof(buf) - 1)
 		goto lerr;
-	if (write(fd, buf, len) != len)
-		goto werr;
 
 	len = snprintf(buf, sizeof(buf),
 	    "%s%.24s%s%s%s%s%s%s%s%s%s%s%s%s%s%s\n\n",
@@ -411,7 +864,7 @@ rcv_mailfile(SCR *sp, int issync, char *cp_path)
 	    gp->progname, " -r ", t);
 	if (len > sizeof(buf) - 1) {
 lerr:		msgq(sp, M_ERR, "064|Recovery file buffer overrun");
-		goto err;
+		return (1);
 	}
 
 	/*
@@ -444,24 +897,11 @@ lerr:		msgq(sp, M_ERR, "064|Recovery file buffer overrun");
 wout:		*t2++ = '\n';
 
 		/* t2 points one after the last character to display. */
-		if (write(fd, t1, t2 - t1) != t2 - t1)
-			goto werr;
-	}
-
-	if (issync) {
-		rcv_email(sp, mpath);
-		if (close(fd)) {
-werr:			msgq(sp, M_SYSERR, "065|Recovery file");
-			goto err;
-		}
+		memcpy(mbuf + mlen, t1, t2 - t1);
+		mlen += t2 - t1;
 	}
+	*lenp = mlen;
 	return (0);
-
-err:	if (!issync)
-		ep->rcv_fd = -1;
-	if (fd != -1)
-		(void)close(fd);
-	return (1);
 }
 
 /*
@@ -830,22 +1270,33 @@ rcv_mktemp(SCR *sp, char *path, char *dname, int perms)
 static void
 rcv_email(SCR *sp, char *fname)
 {
-	struct stat sb;
 	char buf[MAXPATHLEN * 2 + 20];
 
-	if (_PATH_SENDMAIL[0] != '/' || stat(_PATH_SENDMAIL, &sb))
+	if (!rcv_emailcmd(sp, fname, buf, sizeof(buf)))
+		(void)system(buf);
+}
+
+/*
+ * rcv_emailcmd --
+ *	Build the command that sends email.
+ */
+static int
+rcv_emailcmd(SCR *sp, char *fname, char *buf, size_t len)
+{
+	struct stat sb;
+
+	if (_PATH_SENDMAIL[0] != '/' || stat(_PATH_SENDMAIL, &sb)) {
 		msgq_str(sp, M_SYSERR,
 		    _PATH_SENDMAIL, "071|not sending email: %s");
-	else {
-		/*
-		 * !!!
-		 * If you need to port this to a system that doesn't have
-		 * sendmail, the -t flag causes sendmail to read the message
-		 * for the recipients instead of specifying them some other
-		 * way.
-		 */
-		(void)snprintf(buf, sizeof(buf),
-		    "%s -t < %s", _PATH_SENDMAIL, fname);
-		(void)system(buf);
+		return (1);
 	}
+	/*
+	 * !!!
+	 * If you need to port this to a system that doesn't have
+	 * sendmail, the -t flag causes sendmail to read the message
+	 * for the recipients instead of specifying them some other
+	 * way.
+	 */
+	(void)snprintf(buf, len, "%s -t < %s", _PATH_SENDMAIL, fname);
+	return (0);
 }
@@ -181,8 +181,10 @@ screen_end(SCR *sp)
 	/* Free up search information. */
 	if (sp->re != NULL)
 		free(sp->re);
-	if (F_ISSET(sp, SC_RE_SEARCH))
+	if (F_ISSET(sp, SC_RE_SEARCH)) {
 		regfree(&sp->re_c);
+		regfree(&sp->re_bc);
+	}
 	if (sp->subre != NULL)
 		free(sp->subre);
 	if (F_ISSET(sp, SC_RE_SUBST))
@@ -99,13 +99,8 @@ struct _scr {
 	SCR	*ccl_parent;		/* Colon command-line parent screen. */
 	EXF	*ep;			/* Screen's current EXF structure. */
 
-	CHAR_T	*c_lp;			/* Cached line. */
-	size_t	 c_len;			/* Cached line length. */
-	/* May move out again once we use DB 
-	 * to cache internal representation
-	 */
-	size_t	 c_blen;		/* Cached line buffer length. */
-	db_recno_t	 c_lno;		/* Cached line number. */
+	CHAR_T	*c_lp;			/* DB line buffer. */
+	size_t	 c_blen;		/* DB line buffer length. */
 
 	FREF	*frp;			/* FREF being edited. */
 	char	**argv;			/* NULL terminated file name array. */
@@ -194,6 +189,7 @@ struct _scr {
 					/* Ex/vi: RE information. */
 	dir_t	 searchdir;		/* Last file search direction. */
 	regex_t	 re_c;			/* Search RE: compiled form. */
+	regex_t	 re_bc;			/* Search RE: compiled for blocks. */
 	CHAR_T	*re;			/* Search RE: uncompiled form. */
 	size_t	 re_len;		/* Search RE: uncompiled length. */
 	regex_t	 subre_c;		/* Substitute RE: compiled form. */
@@ -29,6 +29,13 @@ static const char sccsid[] = "$Id: search.c,v 10.31 2001/06/25 15:19:12 skimo Ex
 
 typedef enum { S_EMPTY, S_EOF, S_NOPREV, S_NOTFOUND, S_SOF, S_WRAP } smsg_t;
 
+/*
+ * Lines searched at a time, where lines are stored as blocks of text.
+ * Each block is one pass through the RE engine.
+ */
+#define	SEARCH_BLOCK	4096
+
+static int	search_block __P((SCR *, dir_t, db_recno_t, db_recno_t, db_recno_t *));
 static void	search_msg __P((SCR *, smsg_t));
 static int	search_init __P((SCR *, dir_t, CHAR_T *, size_t, CHAR_T **, u_int));
 
@@ -39,19 +46,14 @@ static int	search_init __P((SCR *, dir_t, CHAR_T *, size_t, CHAR_T **, u_int));
 static int
 search_init(SCR *sp, dir_t dir, CHAR_T *ptrn, size_t plen, CHAR_T **epp, u_int flags)
 {
-	db_recno_t lno;
 	int delim;
 	CHAR_T *p, *t;
 
 	/* If the file is empty, it's a fast search. */
-	if (sp->lno <= 1) {
-		if (db_last(sp, &lno))
-			return (1);
-		if (lno == 0) {
-			if (LF_ISSET(SEARCH_MSG))
-				search_msg(sp, S_EMPTY);
-			return (1);
-		}
+	if (sp->lno <= 1 && !db_exist(sp, 1)) {
+		if (LF_ISSET(SEARCH_MSG))
+			search_msg(sp, S_EMPTY);
+		return (1);
 	}
 
 	if (LF_ISSET(SEARCH_PARSE)) {		/* Parse the string. */
@@ -139,7 +141,7 @@ int
 f_search(SCR *sp, MARK *fm, MARK *rm, CHAR_T *ptrn, size_t plen, CHAR_T **eptrn, u_int flags)
 {
 	busy_t btype;
-	db_recno_t lno;
+	db_recno_t blno, lno;
 	regmatch_t match[1];
 	size_t coff, len;
 	int cnt, eval, rval, wrapped;
@@ -217,6 +219,17 @@ f_search(SCR *sp, MARK *fm, MARK *rm, CHAR_T *ptrn, size_t plen, CHAR_T **eptrn,
 			continue;
 		}
 
+		/*
+		 * Skip to the first line in the block of lines starting here
+		 * that has a match.  The loop increments lno.
+		 */
+		if (coff == 0 && !search_block(sp, FORWARD, lno,
+		    wrapped ? fm->lno - lno + 1 : SEARCH_BLOCK, &blno) &&
+		    blno != lno) {
+			lno = blno - 1;
+			continue;
+		}
+
 		/* If already at EOL, just keep going. */
 		if (len != 0 && coff == len)
 			continue;
@@ -282,7 +295,7 @@ int
 b_search(SCR *sp, MARK *fm, MARK *rm, CHAR_T *ptrn, size_t plen, CHAR_T **eptrn, u_int flags)
 {
 	busy_t btype;
-	db_recno_t lno;
+	db_recno_t blno, lno;
 	regmatch_t match[1];
 	size_t coff, last, len;
 	int cnt, eval, rval, wrapped;
@@ -355,6 +368,17 @@ b_search(SCR *sp, MARK *fm, MARK *rm, CHAR_T *ptrn, size_t plen, CHAR_T **eptrn,
 			continue;
 		}
 
+		/*
+		 * Skip to the last line in the block of lines ending here that
+		 * has a match.  The loop decrements lno.
+		 */
+		if (coff == 0 && !search_block(sp, BACKWARD, lno,
+		    wrapped ? lno - fm->lno + 1 : SEARCH_BLOCK, &blno) &&
+		    blno != lno) {
+			lno = blno + 1;
+			continue;
+		}
+
 		if (db_get(sp, lno, 0, &l, &len))
 			break;
 
@@ -433,6 +457,67 @@ err:	if (LF_ISSET(SEARCH_MSG))
 	return (rval);
 }
 
+/*
+ * search_block --
+ *	Search a block of up to max lines, starting at lno if searching
+ *	forward, or ending at lno if searching backward, with a single
+ *	pass through the RE engine.  Return the first line, or last line if
+ *	searching backward, that has a match, or the line past the block if
+ *	none do.  Return 1 if the lines can't be searched as a block.
+ */
+static int
+search_block(SCR *sp, dir_t dir, db_recno_t lno, db_recno_t max, db_recno_t *lnop)
+{
+	regmatch_t match[1];
+	db_recno_t cnt, hit, nlines;
+	size_t len;
+	CHAR_T *bp, *p, *s, *t;
+
+	nlines = max;
+	if (db_block(sp, lno, dir, &bp, &len, &nlines))
+		return (1);
+	if (dir == BACKWARD)
+		lno -= nlines - 1;
+
+	/*
+	 * Searching forward, the first match is the one we want.  Searching
+	 * backward, restart after each match until there are no more.  The
+	 * lines are separated by newlines, and the block RE doesn't match
+	 * across them, so each match is in a single line.
+	 */
+	for (p = bp, cnt = 0, hit = 0;;) {
+		match[0].rm_so = p - bp;
+		match[0].rm_eo = len;
+		switch (regexec(&sp->re_bc, bp, 1, match, REG_STARTEND)) {
+		case 0:
+			break;
+		case REG_NOMATCH:
+			goto done;
+		default:
+			return (1);
+		}
+		/* Count the lines before the one with the match. */
+		for (t = bp + match[0].rm_so;
+		    (s = memchr(p, '\n', t - p)) != NULL; p = s + 1)
+			++cnt;
+		hit = lno + cnt;
+		if (dir == FORWARD)
+			break;
+
+		/* Restart at the next line. */
+		if ((s = memchr(t, '\n', (bp + len) - t)) == NULL)
+			break;
+		p = s + 1;
+		++cnt;
+	}
+
+done:	if (hit != 0)
+		*lnop = hit;
+	else
+		*lnop = dir == FORWARD ? lno + nlines : lno - 1;
+	return (0);
+}
+
 /*
  * search_msg --
  *	Display one of the search messages.
@@ -26,6 +26,12 @@ static const char sccsid[] = "$Id: seq.c,v 10.15 2001/06/25 15:19:12 skimo Exp $
 
 #include "common.h"
 
+static SEQ	*seq_lpos __P((GS *, CHAR_T *, size_t, seq_t));
+static SEQNODE	*seq_tkid __P((SEQNODE *, ARG_CHAR_T, size_t *));
+static int	 seq_tadd __P((SCR *, SEQ *));
+static void	 seq_tdel __P((SEQ *));
+static void	 seq_tfree __P((SEQNODE *));
+
 /*
  * seq_set --
  *	Internal version to enter a sequence.
@@ -47,8 +53,7 @@ seq_set(SCR *sp, CHAR_T *name, size_t nlen, CHAR_T *input, size_t ilen, CHAR_T *
 	 *
 	 * Just replace the output field if the string already set.
 	 */
-	if ((qp =
-	    seq_find(sp, &lastqp, NULL, input, ilen, stype, NULL)) != NULL) {
+	if ((qp = seq_find(sp, NULL, NULL, input, ilen, stype, NULL)) != NULL) {
 		if (LF_ISSET(SEQ_NOOVERWRITE))
 			return (0);
 		if (output == NULL || olen == 0) {
@@ -94,7 +99,20 @@ seq_set(SCR *sp, CHAR_T *name, size_t nlen, CHAR_T *input, size_t ilen, CHAR_T *
 		olen = 0;
 	} else if ((qp->output = v_wstrdup(sp, output, olen)) == NULL) {
 		sv_errno = errno;
-		free(qp->input);
+		goto mem4;
+	}
+	qp->olen = olen;
+
+	/* Type, flags. */
+	qp->stype = stype;
+	qp->flags = flags;
+
+	/* Enter it into the trie, unresolved function keys can't match. */
+	if (!LF_ISSET(SEQ_FUNCMAP) && seq_tadd(sp, qp)) {
+		sv_errno = errno;
+		if (qp->output != NULL)
+			free(qp->output);
+mem4:		free(qp->input);
 mem3:		if (qp->name != NULL)
 			free(qp->name);
 mem2:		free(qp);
@@ -102,23 +120,13 @@ mem1:		errno = sv_errno;
 		msgq(sp, M_SYSERR, NULL);
 		return (1);
 	}
-	qp->olen = olen;
-
-	/* Type, flags. */
-	qp->stype = stype;
-	qp->flags = flags;
 
 	/* Link into the chain. */
-	if (lastqp == NULL) {
+	if ((lastqp = seq_lpos(sp->gp, input, ilen, stype)) == NULL) {
 		LIST_INSERT_HEAD(&sp->gp->seqq, qp, q);
 	} else {
 		LIST_INSERT_AFTER(lastqp, qp, q);
 	}
-
-	/* Set the fast lookup bit. */
-	if ((UCHAR_T)qp->input[0] < MAX_BIT_SEQ)
-		bit_set(sp->gp->seqb, qp->input[0]);
-
 	return (0);
 }
 
@@ -148,6 +156,7 @@ int
 seq_mdel(SEQ *qp)
 {
 	LIST_REMOVE(qp, q);
+	seq_tdel(qp);
 	if (qp->name != NULL)
 		free(qp->name);
 	free(qp->input);
@@ -159,17 +168,21 @@ seq_mdel(SEQ *qp)
 
 /*
  * seq_find --
- *	Search the sequence list for a match to a buffer, if ispartial
- *	isn't NULL, partial matches count.
+ *	Search for a sequence matching a buffer, if ispartial isn't NULL,
+ *	partial matches count.
+ *
+ * If nodep isn't NULL, it's the state of an incremental search: the keys
+ * leading to *nodep have already been searched for, and matched nothing.
+ * On a partial match, *nodep is set to the node the keys matched.
  *
  * PUBLIC: SEQ *seq_find
- * PUBLIC:    __P((SCR *, SEQ **, EVENT *, CHAR_T *, size_t, seq_t, int *));
+ * PUBLIC:    __P((SCR *, SEQNODE **, EVENT *, CHAR_T *, size_t, seq_t, int *));
  */
 SEQ *
-seq_find(SCR *sp, SEQ **lastqp, EVENT *e_input, CHAR_T *c_input, size_t ilen, seq_t stype, int *ispartialp)
+seq_find(SCR *sp, SEQNODE **nodep, EVENT *e_input, CHAR_T *c_input, size_t ilen, seq_t stype, int *ispartialp)
 {
-	SEQ *lqp, *qp;
-	int diff;
+	SEQNODE *np;
+	size_t cnt;
 
 	/*
 	 * Ispartialp is a location where we return if there was a
@@ -179,61 +192,30 @@ seq_find(SCR *sp, SEQ **lastqp, EVENT *e_input, CHAR_T *c_input, size_t ilen, se
 	 * XXX
 	 * Overload the meaning of ispartialp; only the terminal key
 	 * search doesn't want the search limited to complete matches,
-	 * i.e. ilen may be longer than the match.
+	 * i.e. ilen may be longer than the match.  The shortest match
+	 * is returned, it's the first one found walking down the trie.
 	 */
 	if (ispartialp != NULL)
 		*ispartialp = 0;
-	for (lqp = NULL, qp = sp->gp->seqq.lh_first;
-	    qp != NULL; lqp = qp, qp = qp->q.le_next) {
-		/*
-		 * Fast checks on the first character and type, and then
-		 * a real comparison.
-		 */
-		if (e_input == NULL) {
-			if (qp->input[0] > c_input[0])
-				break;
-			if (qp->input[0] < c_input[0] ||
-			    qp->stype != stype || F_ISSET(qp, SEQ_FUNCMAP))
-				continue;
-			diff = MEMCMP(qp->input, c_input, MIN(qp->ilen, ilen));
-		} else {
-			if (qp->input[0] > e_input->e_c)
-				break;
-			if (qp->input[0] < e_input->e_c ||
-			    qp->stype != stype || F_ISSET(qp, SEQ_FUNCMAP))
-				continue;
-			diff =
-			    e_memcmp(qp->input, e_input, MIN(qp->ilen, ilen));
-		}
-		if (diff > 0)
-			break;
-		if (diff < 0)
-			continue;
-		/*
-		 * If the entry is the same length as the string, return a
-		 * match.  If the entry is shorter than the string, return a
-		 * match if called from the terminal key routine.  Otherwise,
-		 * keep searching for a complete match.
-		 */
-		if (qp->ilen <= ilen) {
-			if (qp->ilen == ilen || ispartialp != NULL) {
-				if (lastqp != NULL)
-					*lastqp = lqp;
-				return (qp);
-			}
-			continue;
-		}
-		/*
-		 * If the entry longer than the string, return partial match
-		 * if called from the terminal key routine.  Otherwise, no
-		 * match.
-		 */
-		if (ispartialp != NULL)
-			*ispartialp = 1;
-		break;
+	if (nodep == NULL || (np = *nodep) == NULL)
+		np = &sp->gp->seqt[stype];
+	for (cnt = np->len; cnt < ilen; ++cnt) {
+		if ((np = seq_tkid(np, e_input == NULL ?
+		    c_input[cnt] : e_input[cnt].e_c, NULL)) == NULL)
+			return (NULL);
+		if (np->qp != NULL && (ispartialp != NULL || cnt + 1 == ilen))
+			return (np->qp);
+	}
+
+	/*
+	 * If there are entries longer than the string, return partial match
+	 * if called from the terminal key routine.  Otherwise, no match.
+	 */
+	if (ispartialp != NULL && np->nkids != 0) {
+		*ispartialp = 1;
+		if (nodep != NULL)
+			*nodep = np;
 	}
-	if (lastqp != NULL)
-		*lastqp = lqp;
 	return (NULL);
 }
 
@@ -247,6 +229,7 @@ void
 seq_close(GS *gp)
 {
 	SEQ *qp;
+	int cnt;
 
 	while ((qp = gp->seqq.lh_first) != NULL) {
 		if (qp->name != NULL)
@@ -258,6 +241,8 @@ seq_close(GS *gp)
 		LIST_REMOVE(qp, q);
 		free(qp);
 	}
+	for (cnt = 0; cnt < SEQ_NTYPES; ++cnt)
+		seq_tfree(&gp->seqt[cnt]);
 }
 
 /*
@@ -365,3 +350,143 @@ e_memcmp(CHAR_T *p1, EVENT *ep, size_t n)
         }
         return (0);
 }
+
+/*
+ * seq_lpos --
+ *	Return the sequence a new sequence follows in the list, NULL if it's
+ *	the first.
+ */
+static SEQ *
+seq_lpos(GS *gp, CHAR_T *input, size_t ilen, seq_t stype)
+{
+	SEQ *lqp, *qp;
+	int diff;
+
+	for (lqp = NULL, qp = gp->seqq.lh_first;
+	    qp != NULL; lqp = qp, qp = qp->q.le_next) {
+		if (qp->input[0] > input[0])
+			break;
+		if (qp->input[0] < input[0] ||
+		    qp->stype != stype || F_ISSET(qp, SEQ_FUNCMAP))
+			continue;
+		if ((diff = MEMCMP(qp->input, input, MIN(qp->ilen, ilen))) > 0)
+			break;
+		if (diff == 0 && qp->ilen > ilen)
+			break;
+	}
+	return (lqp);
+}
+
+/*
+ * seq_tkid --
+ *	Return a node's child for a key, or NULL; if slotp isn't NULL, it's
+ *	set to where the child is or would go.
+ */
+static SEQNODE *
+seq_tkid(SEQNODE *np, ARG_CHAR_T ch, size_t *slotp)
+{
+	SEQNODE *kp;
+	size_t base, idx, lim;
+
+	for (base = 0, lim = np->nkids; lim != 0; lim >>= 1) {
+		idx = base + (lim >> 1);
+		kp = np->kids[idx];
+		if (kp->ch == ch) {
+			if (slotp != NULL)
+				*slotp = idx;
+			return (kp);
+		}
+		if (kp->ch < ch) {
+			base = idx + 1;
+			--lim;
+		}
+	}
+	if (slotp != NULL)
+		*slotp = base;
+	return (NULL);
+}
+
+/*
+ * seq_tadd --
+ *	Enter a sequence into its trie.
+ */
+static int
+seq_tadd(SCR *sp, SEQ *qp)
+{
+	SEQNODE *kp, *np;
+	size_t cnt, slot;
+
+	np = &sp->gp->seqt[qp->stype];
+	for (cnt = 0; cnt < qp->ilen; ++cnt) {
+		if ((kp = seq_tkid(np, qp->input[cnt], &slot)) == NULL) {
+			BINC_GOTO(sp, SEQNODE *, np->kids,
+			    np->kidslen, (np->nkids + 1) * sizeof(SEQNODE *));
+			CALLOC_GOTO(sp, kp, SEQNODE *, 1, sizeof(SEQNODE));
+			kp->parent = np;
+			kp->len = np->len + 1;
+			kp->ch = qp->input[cnt];
+			memmove(np->kids + slot + 1, np->kids + slot,
+			    (np->nkids - slot) * sizeof(SEQNODE *));
+			np->kids[slot] = kp;
+			++np->nkids;
+		}
+		np = kp;
+	}
+	np->qp = qp;
+	qp->node = np;
+	return (0);
+
+alloc_err:
+	/* Discard any nodes that lead nowhere. */
+	qp->node = np;
+	seq_tdel(qp);
+	return (1);
+}
+
+/*
+ * seq_tdel --
+ *	Remove a sequence from its trie, discarding the nodes that no longer
+ *	lead to a sequence.
+ */
+static void
+seq_tdel(SEQ *qp)
+{
+	SEQNODE *np, *pp;
+	size_t slot;
+
+	if ((np = qp->node) == NULL)
+		return;
+	if (np->qp == qp)
+		np->qp = NULL;
+	qp->node = NULL;
+	while ((pp = np->parent) != NULL && np->qp == NULL && np->nkids == 0) {
+		(void)seq_tkid(pp, np->ch, &slot);
+		memmove(pp->kids + slot, pp->kids + slot + 1,
+		    (pp->nkids - slot - 1) * sizeof(SEQNODE *));
+		--pp->nkids;
+		if (np->kids != NULL)
+			free(np->kids);
+		free(np);
+		np = pp;
+	}
+}
+
+/*
+ * seq_tfree --
+ *	Discard the nodes below a trie node.
+ */
+static void
+seq_tfree(SEQNODE *np)
+{
+	size_t cnt;
+
+	for (cnt = 0; cnt < np->nkids; ++cnt) {
+		seq_tfree(np->kids[cnt]);
+		free(np->kids[cnt]);
+	}
+	if (np->kids != NULL)
+		free(np->kids);
+	np->kids = NULL;
+	np->nkids = np->kidslen = 0;
+	np->qp = NULL;
+}
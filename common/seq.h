@@ -15,16 +15,11 @@
  * The map structure is doubly linked list, sorted by input string and by
  * input length within the string.  (The latter is necessary so that short
  * matches will happen before long matches when the list is searched.)
- * Additionally, there is a bitmap which has bits set if there are entries
- * starting with the corresponding character.  This keeps us from walking
- * the list unless it's necessary.
+ * The list is what's displayed and saved; lookups use a trie for each of
+ * the sequence types, keyed by the input keys.
  *
  * The name and the output fields of a SEQ can be empty, i.e. NULL.
  * Only the input field is required.
- *
- * XXX
- * The fast-lookup bits are never turned off -- users don't usually unmap
- * things, though, so it's probably not a big deal.
  */
 struct _seq {
 	LIST_ENTRY(_seq) q;		/* Linked list of all sequences. */
@@ -35,6 +30,7 @@ struct _seq {
 	size_t	 ilen;			/* Input keys length. */
 	CHAR_T	*output;		/* Sequence output keys. */
 	size_t	 olen;			/* Output keys length. */
+	SEQNODE	*node;			/* Trie node, if any. */
 
 #define	SEQ_FUNCMAP	0x01		/* If unresolved function key.*/
 #define	SEQ_NOOVERWRITE	0x02		/* Don't replace existing entry. */
@@ -42,3 +38,25 @@ struct _seq {
 #define	SEQ_USERDEF	0x08		/* If user defined. */
 	u_int8_t flags;
 };
+
+/*
+ * SEQNODE --
+ *	A trie node: the sequence whose input is the keys leading to the node,
+ *	if any, and the nodes for the keys that can follow them.  Nodes exist
+ *	only on the path to a sequence, unresolved function keys aren't in the
+ *	trie.
+ *
+ * A node is also the state of an incremental search, the keys leading to
+ * it don't have to be compared again when more keys arrive.
+ */
+struct _seqnode {
+	SEQNODE	 *parent;		/* Parent, NULL for the root. */
+	SEQNODE	**kids;			/* Children, sorted by key. */
+	size_t	  nkids;		/* Number of children. */
+	size_t	  kidslen;		/* Children buffer length. */
+	SEQ	 *qp;			/* Sequence ending here, if any. */
+	size_t	  len;			/* Keys leading to the node. */
+	CHAR_T	  ch;			/* Last key leading to the node. */
+};
+
+#define	SEQ_NTYPES	3		/* Abbreviations, command, input maps. */
@@ -28,6 +28,8 @@ static const char sccsid[] = "$Id: db.c,v 10.48 2002/06/08 19:32:52 skimo Exp $
 #include "../vi/vi.h"
 
 static int append __P((SCR*, db_recno_t, CHAR_T*, size_t, lnop_t, int));
+static void scr_layout __P((SCR *, db_recno_t, db_recno_t));
+static int scr_update_range __P((SCR *, db_recno_t, db_recno_t));
 
 /*
  * db_eget --
@@ -137,17 +139,12 @@ db_get(SCR *sp, db_recno_t lno, u_int32_t flags, CHAR_T **pp, size_t *lenp)
 	}
 
 	/* Look-aside into the cache, and see if the line we want is there. */
-	if (lno == sp->c_lno) {
+	if (!lcache_get(ep, lno, pp, lenp)) {
 #if defined(DEBUG) && 0
 		vtrace(sp, "retrieve cached line %lu\n", (u_long)lno);
 #endif
-		if (lenp != NULL)
-			*lenp = sp->c_len;
-		if (pp != NULL)
-			*pp = sp->c_lp;
 		return (0);
 	}
-	sp->c_lno = OOBLNO;
 
 nocache:
 	nlen = 1024;
@@ -190,21 +187,15 @@ err3:		if (lenp != NULL)
 	    goto err3;
 	}
 
-	/* Reset the cache. */
-	if (wp != data.data) {
-	    BINC_GOTOW(sp, sp->c_lp, sp->c_blen, wlen);
-	    MEMCPYW(sp->c_lp, wp, wlen);
-	}
-	sp->c_lno = lno;
-	sp->c_len = wlen;
+	/* Enter the line into the cache. */
+	if (lcache_put(sp, ep, lno, wp, wlen, pp))
+		goto err3;
 
 #if defined(DEBUG) && 0
 	vtrace(sp, "retrieve DB line %lu\n", (u_long)lno);
 #endif
 	if (lenp != NULL)
 		*lenp = wlen;
-	if (pp != NULL)
-		*pp = sp->c_lp;
 	return (0);
 }
 
@@ -250,7 +241,7 @@ db_delete(SCR *sp, db_recno_t lno)
 		return (1);
 	}
 
-	/* Flush the cache, update line count, before screen update. */
+	/* Update the cache and line count, before screen update. */
 	update_cache(sp, LINE_DELETE, lno);
 
 	/* File now modified. */
@@ -347,8 +338,8 @@ err2:
 
 	(void)dbcp_put->c_close(dbcp_put);
 
-	/* Flush the cache, update line count, before screen update. */
-	update_cache(sp, LINE_INSERT, lno);
+	/* Update the cache and line count, before screen update. */
+	update_cache(sp, LINE_INSERT, lno + 1);
 
 	/* File now dirty. */
 	if (F_ISSET(ep, F_FIRSTMODIFY))
@@ -375,6 +366,22 @@ err2:
 	return (scr_update(sp, lno + 1, LINE_INSERT, update) || rval);
 }
 
+/*
+ * db_delete_block --
+ *	Delete n lines from the file, starting with line lno.  DB deletes
+ *	the lines one at a time.
+ *
+ * PUBLIC: int db_delete_block __P((SCR *, db_recno_t, db_recno_t));
+ */
+int
+db_delete_block(SCR *sp, db_recno_t lno, db_recno_t n)
+{
+	for (; n > 0; --n)
+		if (db_delete(sp, lno + n - 1))
+			return (1);
+	return (0);
+}
+
 /*
  * db_append --
  *	Append a line into the file.
@@ -392,6 +399,34 @@ db_append(SCR *sp, int update, db_recno_t lno, CHAR_T *p, size_t len)
 	return append(sp, lno, p, len, LINE_APPEND, update);
 }
 
+/*
+ * db_append_block --
+ *	Append a block of lines into the file after line lno, each line
+ *	ending with a newline, except perhaps the last.  Return the number
+ *	of lines appended in *nlinesp.  DB gets the lines one at a time.
+ *
+ * PUBLIC: int db_append_block
+ * PUBLIC:    __P((SCR *, db_recno_t, CHAR_T *, size_t, db_recno_t *));
+ */
+int
+db_append_block(SCR *sp, db_recno_t lno, CHAR_T *p, size_t len,
+    db_recno_t *nlinesp)
+{
+	db_recno_t n;
+	CHAR_T *endp, *s, *t;
+
+	for (n = 0, endp = p + len, t = p; t < endp; ++n, t = s + 1) {
+		if ((s = MEMCHR(t, '\n', endp - t)) == NULL)
+			s = endp;
+		if (append(sp, lno + n, t, s - t, LINE_APPEND, 1)) {
+			*nlinesp = n;
+			return (1);
+		}
+	}
+	*nlinesp = n;
+	return (0);
+}
+
 /*
  * db_insert --
  *	Insert a line into the file.
@@ -464,10 +499,55 @@ db_set(SCR *sp, db_recno_t lno, CHAR_T *p, size_t len)
 	/* Log after change. */
 	log_line(sp, lno, LOG_LINE_RESET_F);
 
-	/* Update screen. */
+	/* Update screen, or leave it for the end of the batch. */
+	if (ep->batch) {
+		if (ep->b_start == OOBLNO || ep->b_start > lno)
+			ep->b_start = lno;
+		if (ep->b_stop < lno)
+			ep->b_stop = lno;
+		return (0);
+	}
 	return (scr_update(sp, lno, LINE_RESET, 1));
 }
 
+/*
+ * db_batch --
+ *	Start or finish a batch of line changes.  Lines replaced during a
+ *	batch aren't repainted as they're changed, but all at once, when
+ *	the batch is finished.
+ *
+ * PUBLIC: int db_batch __P((SCR *, int));
+ */
+int
+db_batch(SCR *sp, int on)
+{
+	EXF *ep;
+	db_recno_t start;
+
+	if ((ep = sp->ep) == NULL)
+		return (0);
+	ep->batch = on;
+	if ((start = ep->b_start) == OOBLNO)
+		return (0);
+	ep->b_start = OOBLNO;
+	return (on ? 0 : scr_update_range(sp, start, ep->b_stop));
+}
+
+/*
+ * db_block --
+ *	Return up to *nlinesp lines as a single newline separated block of
+ *	text.  Lines in a DB(3) database aren't stored that way.
+ *
+ * PUBLIC: int db_block __P((SCR *,
+ * PUBLIC:    db_recno_t, dir_t, CHAR_T **, size_t *, db_recno_t *));
+ */
+int
+db_block(SCR *sp, db_recno_t lno, dir_t dir,
+    CHAR_T **pp, size_t *lenp, db_recno_t *nlinesp)
+{
+	return (1);
+}
+
 /*
  * db_exist --
  *	Return if a line exists.
@@ -559,14 +639,12 @@ err1:
 
 	memcpy(&lno, key.data, sizeof(lno));
 
-	if (lno != sp->c_lno) {
+	if (lcache_get(ep, lno, NULL, NULL)) {
 	    FILE2INT(sp, data.data, data.size, wp, wlen);
 
 	    /* Fill the cache. */
-	    BINC_GOTOW(sp, sp->c_lp, sp->c_blen, wlen);
-	    MEMCPYW(sp->c_lp, wp, wlen);
-	    sp->c_lno = lno;
-	    sp->c_len = wlen;
+	    if (lcache_put(sp, ep, lno, wp, wlen, NULL))
+		goto alloc_err;
 	}
 	ep->c_nlines = lno;
 
@@ -607,6 +685,8 @@ scr_update(SCR *sp, db_recno_t lno, lnop_t op, int current)
 	SCR *tsp;
 	WIN *wp;
 
+	scr_layout(sp, op == LINE_APPEND ? lno + 1 : lno,
+	    op == LINE_RESET ? lno : DB_MAX_RECORDS);
 	if (F_ISSET(sp, SC_EX))
 		return (0);
 
@@ -624,32 +704,89 @@ scr_update(SCR *sp, db_recno_t lno, lnop_t op, int current)
 }
 
 /*
+ * scr_update_range --
+ *	Update all of the screens that are backed by the file for a range
+ *	of replaced lines.
+ */
+static int
+scr_update_range(SCR *sp, db_recno_t start, db_recno_t stop)
+{
+	EXF *ep;
+	SCR *tsp;
+	WIN *wp;
+
+	scr_layout(sp, start, stop);
+	if (F_ISSET(sp, SC_EX))
+		return (0);
+
+	ep = sp->ep;
+	if (ep->refcnt != 1)
+		for (wp = sp->gp->dq.cqh_first; wp != (void *)&sp->gp->dq; 
+		    wp = wp->q.cqe_next)
+			for (tsp = wp->scrq.cqh_first;
+			    tsp != (void *)&wp->scrq; tsp = tsp->q.cqe_next)
+			if (sp != tsp && tsp->ep == ep)
+				if (vs_change_range(tsp, start, stop))
+					return (1);
+	return (vs_change_range(sp, start, stop));
+}
+
+/*
+ * scr_layout --
+ *	Discard the line layouts cached by all of the screens that are backed
+ *	by the file, for changed lines.  Screens in ex mode and screens that
+ *	aren't displaying the lines still have to forget them.
+ */
+static void
+scr_layout(SCR *sp, db_recno_t start, db_recno_t stop)
+{
+	EXF *ep;
+	SCR *tsp;
+	WIN *wp;
+
+	ep = sp->ep;
+	if (ep->refcnt != 1)
+		for (wp = sp->gp->dq.cqh_first; wp != (void *)&sp->gp->dq; 
+		    wp = wp->q.cqe_next)
+			for (tsp = wp->scrq.cqh_first;
+			    tsp != (void *)&wp->scrq; tsp = tsp->q.cqe_next)
+			if (sp != tsp && tsp->ep == ep)
+				vs_lchange(tsp, start, stop);
+	vs_lchange(sp, start, stop);
+}
+
+/*
+ * update_cache --
+ *	Update the line cache and the line count.  The line number is the
+ *	number of the inserted, deleted or reset line.
+ *
  * PUBLIC: void update_cache __P((SCR *sp, lnop_t op, db_recno_t lno));
  */
 void
 update_cache(SCR *sp, lnop_t op, db_recno_t lno)
 {
-	SCR* scrp;
 	EXF *ep;
 
 	ep = sp->ep;
 
-	/* Flush the cache, update line count, before screen update. */
-	/* The flushing is probably not needed, since it was incorrect
-	 * for db_insert.  It might be better to adjust it, like
-	 * marks, @ and global
-	 */
-	for (scrp = ep->scrq.cqh_first; scrp != (void *)&ep->scrq; 
-	    scrp = scrp->eq.cqe_next)
+	/* Renumber or discard cached lines, like marks, @ and global. */
+	lcache_insdel(ep, op, lno);
+	mindex_insdel(ep, op, lno);
+
+	/* Renumber the lines a batch has yet to repaint. */
+	if (ep->batch && ep->b_start != OOBLNO)
 		switch (op) {
 		case LINE_INSERT:
-		case LINE_DELETE:
-			if (lno <= scrp->c_lno)
-				scrp->c_lno = OOBLNO;
+			if (ep->b_start >= lno)
+				++ep->b_start;
+			if (ep->b_stop >= lno)
+				++ep->b_stop;
 			break;
-		case LINE_RESET:
-			if (lno == scrp->c_lno)
-				scrp->c_lno = OOBLNO;
+		case LINE_DELETE:
+			if (ep->b_start > lno)
+				--ep->b_start;
+			if (ep->b_stop >= lno && --ep->b_stop < ep->b_start)
+				ep->b_start = ep->b_stop = OOBLNO;
 			break;
 		}
 
@@ -753,6 +890,48 @@ static size_t round_up(size_t v)
 	return old_v << 1;
 }
 
+/*
+ * db_sync --
+ *	Flush the file's changes to its backing file.
+ *
+ * PUBLIC: int db_sync __P((SCR *, EXF *));
+ */
+int
+db_sync(SCR *sp, EXF *ep)
+{
+	return (ep->db->sync(ep->db, 0));
+}
+
+/*
+ * db_rcv_track --
+ *	Have a routine called with the page number each time a page of the
+ *	backing file is about to be overwritten.  DB(3) doesn't give us a
+ *	way to do that.
+ *
+ * PUBLIC: int db_rcv_track
+ * PUBLIC:    __P((SCR *, EXF *, void (*)(void *, db_pgno_t), void *, u_long *));
+ */
+int
+db_rcv_track(SCR *sp, EXF *ep,
+    void (*pgwrite)(void *, db_pgno_t), void *cookie, u_long *psizep)
+{
+	return (1);
+}
+
+/*
+ * db_pdisplay --
+ *	Display the file's page cache statistics.  DB(3) doesn't give us
+ *	a way to get them.
+ *
+ * PUBLIC: int db_pdisplay __P((SCR *));
+ */
+int
+db_pdisplay(SCR *sp)
+{
+	msgq(sp, M_INFO, "326|No page cache statistics for this file");
+	return (0);
+}
+
 /*
  * PUBLIC: int db_msg_open __P((SCR *, char *, DB **));
  */
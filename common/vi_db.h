@@ -9,6 +9,7 @@
 typedef void DB_ENV;
 
 typedef recno_t db_recno_t;
+typedef pgno_t db_pgno_t;
 #define DB_MAX_RECORDS MAX_REC_NUMBER
 
 #define db_env_close(env,flags)
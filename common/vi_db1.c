@@ -28,6 +28,11 @@ static const char sccsid[] = "$Id: db1.c,v 10.1 2002/03/09 12:53:57 skimo Exp $
 #include "common.h"
 #include "../vi/vi.h"
 
+static void scr_layout __P((SCR *, db_recno_t, db_recno_t));
+static int scr_update_range __P((SCR *, db_recno_t, db_recno_t));
+static void update_cache_del __P((SCR *, db_recno_t, db_recno_t));
+static void update_cache_ins __P((SCR *, db_recno_t, db_recno_t));
+
 /*
  * db_eget --
  *	Front-end to db_get, special case handling for empty files.
@@ -92,7 +97,6 @@ db_get(SCR *sp, db_recno_t lno, u_int32_t flags, CHAR_T **pp, size_t *lenp)
 	db_recno_t l1, l2;
 	CHAR_T *wp;
 	size_t wlen;
-	size_t nlen;
 
 	/*
 	 * The underlying recno stuff handles zero by returning NULL, but
@@ -140,24 +144,14 @@ db_get(SCR *sp, db_recno_t lno, u_int32_t flags, CHAR_T **pp, size_t *lenp)
 	}
 
 	/* Look-aside into the cache, and see if the line we want is there. */
-	if (lno == sp->c_lno) {
+	if (!lcache_get(ep, lno, pp, lenp)) {
 #if defined(DEBUG) && 0
 		vtrace(sp, "retrieve cached line %lu\n", (u_long)lno);
 #endif
-		if (lenp != NULL)
-			*lenp = sp->c_len;
-		if (pp != NULL)
-			*pp = sp->c_lp;
 		return (0);
 	}
-	sp->c_lno = OOBLNO;
 
 nocache:
-	nlen = 1024;
-retry:
-	/* data.size contains length in bytes */
-	BINC_GOTO(sp, CHAR_T, sp->c_lp, sp->c_blen, nlen);
-
 	/* Get the line from the underlying database. */
 	key.data = &lno;
 	key.size = sizeof(lno);
@@ -167,18 +161,13 @@ retry:
 	case 1:
 err1:		if (LF_ISSET(DBG_FATAL))
 err2:			db_err(sp, lno);
-alloc_err:
 err3:		if (lenp != NULL)
 			*lenp = 0;
 		if (pp != NULL)
 			*pp = NULL;
 		return (1);
 	case 0:
-		if (data.size > nlen) {
-			nlen = data.size;
-			goto retry;
-		} else
-			memcpy(sp->c_lp, data.data, nlen);
+		;
 	}
 
 	if (FILE2INT(sp, data.data, data.size, wp, wlen)) {
@@ -189,21 +178,15 @@ err3:		if (lenp != NULL)
 	    goto err3;
 	}
 
-	/* Reset the cache. */
-	if (wp != data.data) {
-	    BINC_GOTOW(sp, sp->c_lp, sp->c_blen, wlen);
-	    MEMCPYW(sp->c_lp, wp, wlen);
-	}
-	sp->c_lno = lno;
-	sp->c_len = wlen;
+	/* Enter the line into the cache. */
+	if (lcache_put(sp, ep, lno, wp, wlen, pp))
+		goto err3;
 
 #if defined(DEBUG) && 0
 	vtrace(sp, "retrieve DB line %lu\n", (u_long)lno);
 #endif
 	if (lenp != NULL)
 		*lenp = wlen;
-	if (pp != NULL)
-		*pp = sp->c_lp;
 	return (0);
 }
 
@@ -254,7 +237,7 @@ db_delete(SCR *sp, db_recno_t lno)
 		return (1);
 	}
 
-	/* Flush the cache, update line count, before screen update. */
+	/* Update the cache and line count, before screen update. */
 	update_cache(sp, LINE_DELETE, lno);
 
 	/* File now modified. */
@@ -269,6 +252,95 @@ db_delete(SCR *sp, db_recno_t lno)
 	return (scr_update(sp, lno, LINE_DELETE, 1));
 }
 
+/*
+ * db_delete_block --
+ *	Delete n lines from the file, starting with line lno.  The lines
+ *	are logged, and the screens updated, as if they had been deleted one
+ *	at a time, last to first, but they're removed from the file and the
+ *	marks and cache are updated as a group.
+ *
+ * PUBLIC: int db_delete_block __P((SCR *, db_recno_t, db_recno_t));
+ */
+int
+db_delete_block(SCR *sp, db_recno_t lno, db_recno_t n)
+{
+	DBT key;
+	EXF *ep;
+	db_recno_t cnt, last;
+	int rval;
+
+	/* Check for no underlying file. */
+	if ((ep = sp->ep) == NULL) {
+		ex_emsg(sp, NULL, EXM_NOFILEYET);
+		return (1);
+	}
+	if (ep->l_win && ep->l_win != sp->wp) {
+		ex_emsg(sp, NULL, EXM_LOCKED);
+		return 1;
+	}
+	if (n == 0)
+		return (0);
+
+	/* Update marks, @ and global commands. */
+	if (mark_del(sp, lno, n))
+		return (1);
+	for (cnt = n; cnt-- > 0;)
+		if (ex_g_insdel(sp, LINE_DELETE, lno + cnt))
+			return (1);
+
+	/* Log change. */
+	for (cnt = n; cnt-- > 0;)
+		log_line(sp, lno + cnt, LOG_LINE_DELETE_B);
+
+	/*
+	 * Update file.  A line store drops the whole range, otherwise,
+	 * delete the lines one at a time.
+	 */
+	sp->db_error = lstore_delete(ep->db, lno, n);
+	if (sp->db_error == RET_SPECIAL)
+		for (sp->db_error = 0, cnt = n; cnt > 0; --cnt) {
+			key.data = &lno;
+			key.size = sizeof(lno);
+			if ((sp->db_error = ep->db->del(ep->db, &key, 0)) != 0)
+				break;
+		}
+	if (sp->db_error != 0) {
+		if (sp->db_error == -1)
+			sp->db_error = errno;
+
+		msgq(sp, M_DBERR, "003|unable to delete line %lu", 
+		    (u_long)lno);
+
+		/* Whatever happened, the cache can't be trusted. */
+		lcache_flush(ep);
+		mindex_end(ep);
+		ep->c_nlines = OOBLNO;
+		return (1);
+	}
+
+	/* Update the cache and line count, before screen update. */
+	update_cache_del(sp, lno, n);
+
+	/* File now modified. */
+	if (F_ISSET(ep, F_FIRSTMODIFY))
+		(void)rcv_init(sp);
+	F_SET(ep, F_MODIFIED);
+
+	/*
+	 * Update screen.  The screens see each line go, but the lines they
+	 * pull onto the screen to replace them are the ones that follow the
+	 * range, not the ones that followed each line when it went, so the
+	 * lines that follow the range have to be repainted.
+	 */
+	for (cnt = 0; cnt < n; ++cnt)
+		if (scr_update(sp, lno, LINE_DELETE, 1))
+			return (1);
+	rval = 0;
+	if (!F_ISSET(sp, SC_EX) && !db_last(sp, &last) && lno <= last)
+		rval = scr_update_range(sp, lno, last);
+	return (rval);
+}
+
 /*
  * db_append --
  *	Append a line into the file.
@@ -313,8 +385,8 @@ db_append(SCR *sp, int update, db_recno_t lno, CHAR_T *p, size_t len)
 		return (1);
 	}
 
-	/* Flush the cache, update line count, before screen update. */
-	update_cache(sp, LINE_INSERT, lno);
+	/* Update the cache and line count, before screen update. */
+	update_cache(sp, LINE_INSERT, lno + 1);
 
 	/* File now dirty. */
 	if (F_ISSET(ep, F_FIRSTMODIFY))
@@ -344,6 +416,116 @@ db_append(SCR *sp, int update, db_recno_t lno, CHAR_T *p, size_t len)
 	return (scr_update(sp, lno, LINE_APPEND, update) || rval);
 }
 
+/*
+ * db_append_block --
+ *	Append a block of lines into the file after line lno, each line
+ *	ending with a newline, except perhaps the last.  The lines are
+ *	stored, logged and accounted for as a group, not one at a time.
+ *	Return the number of lines appended in *nlinesp.
+ *
+ * PUBLIC: int db_append_block
+ * PUBLIC:    __P((SCR *, db_recno_t, CHAR_T *, size_t, db_recno_t *));
+ */
+int
+db_append_block(SCR *sp, db_recno_t lno, CHAR_T *p, size_t len,
+    db_recno_t *nlinesp)
+{
+	DBT data, key;
+	EXF *ep;
+	db_recno_t cnt, n, tlno;
+	size_t flen;
+	int empty, rval;
+	CHAR_T *endp, *s, *t;
+	char *fp;
+
+	*nlinesp = 0;
+
+	/* Check for no underlying file. */
+	if ((ep = sp->ep) == NULL) {
+		ex_emsg(sp, NULL, EXM_NOFILEYET);
+		return (1);
+	}
+	if (ep->l_win && ep->l_win != sp->wp) {
+		ex_emsg(sp, NULL, EXM_LOCKED);
+		return 1;
+	}
+	if (len == 0)
+		return (0);
+
+	/* Log before change. */
+	log_line(sp, lno + 1, LOG_LINE_APPEND_B);
+
+	/*
+	 * Update file.  A line store takes the whole block, if the internal
+	 * representation is the file's, otherwise, add the lines one at a
+	 * time.  If that fails part way, account for the lines added.
+	 */
+	endp = p + len;
+	rval = sizeof(CHAR_T) != sizeof(char) ? RET_SPECIAL :
+	    lstore_insert(ep->db, lno, (char *)p, len, &n);
+	if (rval == RET_SPECIAL)
+		for (rval = 0, n = 0, t = p; t < endp; ++n, t = s + 1) {
+			if ((s = MEMCHR(t, '\n', endp - t)) == NULL)
+				s = endp;
+			INT2FILE(sp, t, s - t, fp, flen);
+			tlno = lno + n;
+			key.data = &tlno;
+			key.size = sizeof(tlno);
+			data.data = fp;
+			data.size = flen;
+			if (ep->db->put(ep->db, &key, &data, R_IAFTER)) {
+				rval = 1;
+				break;
+			}
+		}
+	else if (rval != 0) {
+		rval = 1;
+		n = 0;
+	}
+	if (rval)
+		msgq(sp, M_DBERR, "004|unable to append to line %lu",
+			(u_long)(lno + n));
+	if (n == 0)
+		return (rval);
+	*nlinesp = n;
+
+	/* Update the cache and line count, before screen update. */
+	update_cache_ins(sp, lno + 1, n);
+
+	/* File now dirty. */
+	if (F_ISSET(ep, F_FIRSTMODIFY))
+		(void)rcv_init(sp);
+	F_SET(ep, F_MODIFIED);
+
+	/* Log after change. */
+	for (cnt = 0, t = p; cnt < n; ++cnt, t = s + 1) {
+		if ((s = MEMCHR(t, '\n', endp - t)) == NULL)
+			s = endp;
+		if (log_append(sp, lno + 1 + cnt, t, s - t))
+			rval = 1;
+	}
+
+	/* Update marks, @ and global commands. */
+	if (mark_ins(sp, lno + 1, n))
+		rval = 1;
+	for (cnt = 0; cnt < n; ++cnt)
+		if (ex_g_insdel(sp, LINE_INSERT, lno + 1 + cnt))
+			rval = 1;
+
+	/*
+	 * Update screen, as if the lines had been appended one at a time.
+	 * Only the lines that land on the screen cost anything.  If the file
+	 * was empty, the first line replaces the empty line on the screen,
+	 * see vs_change().
+	 */
+	empty = lno == 0 && !db_exist(sp, n + 1);
+	for (cnt = 0; cnt < n; ++cnt)
+		if (cnt == 0 && empty ? scr_update(sp, 1, LINE_RESET, 1) :
+		    scr_update(sp, lno + cnt, LINE_APPEND, 1))
+			return (1);
+	return (rval);
+}
+
 /*
  * db_insert --
  *	Insert a line into the file.
@@ -389,7 +571,7 @@ db_insert(SCR *sp, db_recno_t lno, CHAR_T *p, size_t len)
 		return (1);
 	}
 
-	/* Flush the cache, update line count, before screen update. */
+	/* Update the cache and line count, before screen update. */
 	update_cache(sp, LINE_INSERT, lno);
 
 	/* File now dirty. */
@@ -470,10 +652,67 @@ db_set(SCR *sp, db_recno_t lno, CHAR_T *p, size_t len)
 	/* Log after change. */
 	log_line(sp, lno, LOG_LINE_RESET_F);
 
-	/* Update screen. */
+	/* Update screen, or leave it for the end of the batch. */
+	if (ep->batch) {
+		if (ep->b_start == OOBLNO || ep->b_start > lno)
+			ep->b_start = lno;
+		if (ep->b_stop < lno)
+			ep->b_stop = lno;
+		return (0);
+	}
 	return (scr_update(sp, lno, LINE_RESET, 1));
 }
 
+/*
+ * db_batch --
+ *	Start or finish a batch of line changes.  Lines replaced during a
+ *	batch aren't repainted as they're changed, but all at once, when
+ *	the batch is finished.
+ *
+ * PUBLIC: int db_batch __P((SCR *, int));
+ */
+int
+db_batch(SCR *sp, int on)
+{
+	EXF *ep;
+	db_recno_t start;
+
+	if ((ep = sp->ep) == NULL)
+		return (0);
+	ep->batch = on;
+	if ((start = ep->b_start) == OOBLNO)
+		return (0);
+	ep->b_start = OOBLNO;
+	return (on ? 0 : scr_update_range(sp, start, ep->b_stop));
+}
+
+/*
+ * db_block --
+ *	Return up to *nlinesp lines, starting at lno if dir is FORWARD or
+ *	ending at lno if it's BACKWARD, as a single newline separated block
+ *	of text.  Return 1 if the lines aren't stored that way; only the
+ *	unchanged lines of a file in a line store are, and then only if the
+ *	internal representation is the file's.
+ *
+ * PUBLIC: int db_block __P((SCR *,
+ * PUBLIC:    db_recno_t, dir_t, CHAR_T **, size_t *, db_recno_t *));
+ */
+int
+db_block(SCR *sp, db_recno_t lno, dir_t dir,
+    CHAR_T **pp, size_t *lenp, db_recno_t *nlinesp)
+{
+	EXF *ep;
+	char *p;
+
+	if ((ep = sp->ep) == NULL ||
+	    sizeof(CHAR_T) != sizeof(char) || F_ISSET(sp, SC_TINPUT))
+		return (1);
+	if (lstore_block(ep->db, lno, dir, &p, lenp, nlinesp))
+		return (1);
+	*pp = (CHAR_T *)p;
+	return (0);
+}
+
 /*
  * db_exist --
  *	Return if a line exists.
@@ -549,6 +788,12 @@ db_last(SCR *sp, db_recno_t *lnop)
 		*lnop = 0;
 		return (0);
 	case -1:
+		if (lstore_stale(ep->db)) {
+			msgq_str(sp, M_ERR, sp->frp->name,
+		    "328|%s: changed by another program before it was all read");
+			*lnop = 0;
+			return (1);
+		}
 		sp->db_error = errno;
 alloc_err:
 		msgq(sp, M_DBERR, "007|unable to get last line");
@@ -560,14 +805,12 @@ alloc_err:
 
 	memcpy(&lno, key.data, sizeof(lno));
 
-	if (lno != sp->c_lno) {
+	if (lcache_get(ep, lno, NULL, NULL)) {
 	    FILE2INT(sp, data.data, data.size, wp, wlen);
 
 	    /* Fill the cache. */
-	    BINC_GOTOW(sp, sp->c_lp, sp->c_blen, wlen);
-	    MEMCPYW(sp->c_lp, wp, wlen);
-	    sp->c_lno = lno;
-	    sp->c_len = wlen;
+	    if (lcache_put(sp, ep, lno, wp, wlen, NULL))
+		goto alloc_err;
 	}
 	ep->c_nlines = lno;
 
@@ -587,8 +830,12 @@ alloc_err:
 void
 db_err(SCR *sp, db_recno_t lno)
 {
-	msgq(sp, M_ERR,
-	    "008|Error: unable to retrieve line %lu", (u_long)lno);
+	if (sp->ep != NULL && lstore_stale(sp->ep->db))
+		msgq_str(sp, M_ERR, sp->frp->name,
+		    "328|%s: changed by another program before it was all read");
+	else
+		msgq(sp, M_ERR,
+		    "008|Error: unable to retrieve line %lu", (u_long)lno);
 }
 
 /*
@@ -603,6 +850,8 @@ scr_update(SCR *sp, db_recno_t lno, lnop_t op, int current)
 	SCR *tsp;
 	WIN *wp;
 
+	scr_layout(sp, op == LINE_APPEND ? lno + 1 : lno,
+	    op == LINE_RESET ? lno : DB_MAX_RECORDS);
 	if (F_ISSET(sp, SC_EX))
 		return (0);
 
@@ -620,32 +869,89 @@ scr_update(SCR *sp, db_recno_t lno, lnop_t op, int current)
 }
 
 /*
+ * scr_update_range --
+ *	Update all of the screens that are backed by the file for a range
+ *	of replaced lines.
+ */
+static int
+scr_update_range(SCR *sp, db_recno_t start, db_recno_t stop)
+{
+	EXF *ep;
+	SCR *tsp;
+	WIN *wp;
+
+	scr_layout(sp, start, stop);
+	if (F_ISSET(sp, SC_EX))
+		return (0);
+
+	ep = sp->ep;
+	if (ep->refcnt != 1)
+		for (wp = sp->gp->dq.cqh_first; wp != (void *)&sp->gp->dq; 
+		    wp = wp->q.cqe_next)
+			for (tsp = wp->scrq.cqh_first;
+			    tsp != (void *)&wp->scrq; tsp = tsp->q.cqe_next)
+			if (sp != tsp && tsp->ep == ep)
+				if (vs_change_range(tsp, start, stop))
+					return (1);
+	return (vs_change_range(sp, start, stop));
+}
+
+/*
+ * scr_layout --
+ *	Discard the line layouts cached by all of the screens that are backed
+ *	by the file, for changed lines.  Screens in ex mode and screens that
+ *	aren't displaying the lines still have to forget them.
+ */
+static void
+scr_layout(SCR *sp, db_recno_t start, db_recno_t stop)
+{
+	EXF *ep;
+	SCR *tsp;
+	WIN *wp;
+
+	ep = sp->ep;
+	if (ep->refcnt != 1)
+		for (wp = sp->gp->dq.cqh_first; wp != (void *)&sp->gp->dq; 
+		    wp = wp->q.cqe_next)
+			for (tsp = wp->scrq.cqh_first;
+			    tsp != (void *)&wp->scrq; tsp = tsp->q.cqe_next)
+			if (sp != tsp && tsp->ep == ep)
+				vs_lchange(tsp, start, stop);
+	vs_lchange(sp, start, stop);
+}
+
+/*
+ * update_cache --
+ *	Update the line cache and the line count.  The line number is the
+ *	number of the inserted, deleted or reset line.
+ *
  * PUBLIC: void update_cache __P((SCR *sp, lnop_t op, db_recno_t lno));
  */
 void
 update_cache(SCR *sp, lnop_t op, db_recno_t lno)
 {
-	SCR* scrp;
 	EXF *ep;
 
 	ep = sp->ep;
 
-	/* Flush the cache, update line count, before screen update. */
-	/* The flushing is probably not needed, since it was incorrect
-	 * for db_insert.  It might be better to adjust it, like
-	 * marks, @ and global
-	 */
-	for (scrp = ep->scrq.cqh_first; scrp != (void *)&ep->scrq; 
-	    scrp = scrp->eq.cqe_next)
+	/* Renumber or discard cached lines, like marks, @ and global. */
+	lcache_insdel(ep, op, lno);
+	mindex_insdel(ep, op, lno);
+
+	/* Renumber the lines a batch has yet to repaint. */
+	if (ep->batch && ep->b_start != OOBLNO)
 		switch (op) {
 		case LINE_INSERT:
-		case LINE_DELETE:
-			if (lno <= scrp->c_lno)
-				scrp->c_lno = OOBLNO;
+			if (ep->b_start >= lno)
+				++ep->b_start;
+			if (ep->b_stop >= lno)
+				++ep->b_stop;
 			break;
-		case LINE_RESET:
-			if (lno == scrp->c_lno)
-				scrp->c_lno = OOBLNO;
+		case LINE_DELETE:
+			if (ep->b_start > lno)
+				--ep->b_start;
+			if (ep->b_stop >= lno && --ep->b_stop < ep->b_start)
+				ep->b_start = ep->b_stop = OOBLNO;
 			break;
 		}
 
@@ -660,6 +966,54 @@ update_cache(SCR *sp, lnop_t op, db_recno_t lno)
 		}
 }
 
+/*
+ * update_cache_ins --
+ *	Update the line cache and the line count when n lines are inserted,
+ *	the first of them as line lno.
+ */
+static void
+update_cache_ins(SCR *sp, db_recno_t lno, db_recno_t n)
+{
+	EXF *ep;
+
+	ep = sp->ep;
+	lcache_ins(ep, lno, n);
+	mindex_ins(ep, lno, n);
+	if (ep->batch && ep->b_start != OOBLNO) {
+		if (ep->b_start >= lno)
+			ep->b_start += n;
+		if (ep->b_stop >= lno)
+			ep->b_stop += n;
+	}
+	if (ep->c_nlines != OOBLNO)
+		ep->c_nlines += n;
+}
+
+/*
+ * update_cache_del --
+ *	Update the line cache and the line count when n lines are deleted,
+ *	the first of them line lno.
+ */
+static void
+update_cache_del(SCR *sp, db_recno_t lno, db_recno_t n)
+{
+	EXF *ep;
+
+	ep = sp->ep;
+	lcache_del(ep, lno, n);
+	mindex_del(ep, lno, n);
+	if (ep->batch && ep->b_start != OOBLNO) {
+		if (ep->b_start > lno)
+			ep->b_start = ep->b_start - lno > n ? ep->b_start - n : lno;
+		if (ep->b_stop >= lno)
+			ep->b_stop = ep->b_stop - lno >= n ? ep->b_stop - n : lno - 1;
+		if (ep->b_stop < ep->b_start)
+			ep->b_start = ep->b_stop = OOBLNO;
+	}
+	if (ep->c_nlines != OOBLNO)
+		ep->c_nlines -= n;
+}
+
 /*
  * PUBLIC: int db_msg_open __P((SCR *, char *, DB **));
  */
@@ -682,13 +1036,34 @@ db_init(SCR *sp, EXF *ep, char *rcv_name, char *oname, size_t psize, int *open_e
 	oinfo.bval = '\n';			/* Always set. */
 	oinfo.psize = psize;
 	oinfo.flags = R_SNAPSHOT;
-	if (rcv_name)
+
+	/*
+	 * The pagecache option is in kilobytes; 0 leaves DB its minimum
+	 * cache.  Limit it to a gigabyte so DB's rounding can't overflow.
+	 */
+	oinfo.cachesize = (O_VAL(sp, O_PAGECACHE) > 1024 * 1024 ?
+	    1024 * 1024 : O_VAL(sp, O_PAGECACHE)) * 1024;
+
+	/*
+	 * The btree is kept in the recovery file, whether we're recovering
+	 * it or creating it.  If there's no recovery file, DB uses a file
+	 * of its own, and there's nothing to recover.
+	 */
+	if (ep->rcv_path != NULL)
 		oinfo.bfname = ep->rcv_path;
 
 #define _DB_OPEN_MODE	S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH
 
-	ep->db = dbopen(rcv_name == NULL ? oname : NULL,
-	    O_NONBLOCK | O_RDONLY, _DB_OPEN_MODE, DB_RECNO, &oinfo);
+	/*
+	 * Recovery files are DB(3) files, so the line store is only used
+	 * for files being edited; it writes its lines to the recovery file
+	 * when it's synced.
+	 */
+	if (rcv_name == NULL && O_ISSET(sp, O_LINESTORE))
+		ep->db = lstore_open(oname, ep->rcv_path, '\n');
+	else
+		ep->db = dbopen(rcv_name == NULL ? oname : NULL,
+		    O_NONBLOCK | O_RDONLY, _DB_OPEN_MODE, DB_RECNO, &oinfo);
 	
 	if (!ep->db) {
 		msgq_str(sp,
@@ -709,6 +1084,74 @@ db_init(SCR *sp, EXF *ep, char *rcv_name, char *oname, size_t psize, int *open_e
 	return 0;
 }
 
+/*
+ * db_sync --
+ *	Flush the file's changes to its backing file.
+ *
+ * PUBLIC: int db_sync __P((SCR *, EXF *));
+ */
+int
+db_sync(SCR *sp, EXF *ep)
+{
+	/*
+	 * The recno tree is opened read-only, so a plain sync would leave
+	 * it alone; R_RECNOSYNC syncs the underlying btree instead.
+	 */
+	return (ep->db->sync(ep->db, R_RECNOSYNC));
+}
+
+/*
+ * db_rcv_track --
+ *	Have a routine called with the page number each time a page of the
+ *	backing file is about to be overwritten.
+ *
+ * PUBLIC: int db_rcv_track
+ * PUBLIC:    __P((SCR *, EXF *, void (*)(void *, db_pgno_t), void *, u_long *));
+ */
+int
+db_rcv_track(SCR *sp, EXF *ep,
+    void (*pgwrite)(void *, db_pgno_t), void *cookie, u_long *psizep)
+{
+	/* The line store has no backing file. */
+	if (lstore_is(ep->db))
+		return (1);
+	return (__rec_wfilter(ep->db, pgwrite, cookie, psizep) != 0);
+}
+
+/*
+ * db_pdisplay --
+ *	Display the file's page cache statistics.
+ *
+ * PUBLIC: int db_pdisplay __P((SCR *));
+ */
+int
+db_pdisplay(SCR *sp)
+{
+	EXF *ep;
+	MPOOLSTAT st;
+
+	/* The line store has no page cache. */
+	if ((ep = sp->ep) == NULL || lstore_is(ep->db)) {
+		msgq(sp, M_INFO, "326|No page cache statistics for this file");
+		return (0);
+	}
+	(void)__rec_mpstat(ep->db, &st);
+
+	(void)ex_printf(sp, "%lu pages of %lu bytes in the file\n",
+	    st.npages, st.pagesize);
+	(void)ex_printf(sp,
+	    "%lu pages cached of %lu, %lu on the in queue, %lu remembered\n",
+	    st.curcache, st.maxcache, st.nin, st.nout);
+	(void)ex_printf(sp, "%lu page gets, %lu hits, %lu misses",
+	    st.pageget, st.cachehit, st.cachemiss);
+	if (st.cachehit + st.cachemiss != 0)
+		(void)ex_printf(sp, " (%lu%% hit rate)",
+		    st.cachehit * 100 / (st.cachehit + st.cachemiss));
+	(void)ex_printf(sp, "\n%lu page reads, %lu page writes, %lu new pages\n",
+	    st.pageread, st.pagewrite, st.pagenew);
+	return (0);
+}
+
 char *
 db_strerror(int error)
 {
@@ -65,7 +65,7 @@ __bt_close(dbp)
 	DB *dbp;
 {
 	BTREE *t;
-	int fd;
+	int fd, n;
 
 	t = dbp->internal;
 
@@ -99,6 +99,13 @@ __bt_close(dbp)
 		t->bt_rdata.size = 0;
 		t->bt_rdata.data = NULL;
 	}
+	if (t->bt_rcnt != NULL) {
+		for (n = 0; n < RC_NSLOTS; ++n)
+			if (t->bt_rcnt[n].sums != NULL)
+				free(t->bt_rcnt[n].sums);
+		free(t->bt_rcnt);
+		t->bt_rcnt = NULL;
+	}
 
 	fd = t->bt_fd;
 	free(t);
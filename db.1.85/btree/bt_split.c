@@ -103,7 +103,11 @@ __bt_split(t, sp, key, data, flags, ilen, argskip)
 	 * a pointer to the page into which the key should be inserted and with
 	 * skip set to the offset which should be used.  Additionally, l and r
 	 * are pinned.
+	 *
+	 * The split rewrites internal pages, so any cached recno running sums
+	 * are no longer valid.
 	 */
+	++t->bt_rgen;
 	skip = argskip;
 	h = sp->pgno == P_ROOT ?
 	    bt_root(t, sp, &l, &r, &skip, ilen) :
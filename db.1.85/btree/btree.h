@@ -248,6 +248,20 @@ typedef struct _epg {
 	indx_t	 index;			/* the index on the page */
 } EPG;
 
+/*
+ * Running sums of the record counts of a recno internal page, so that
+ * searches can binary search the page instead of walking it.  They're
+ * only valid for the tree generation they were computed in.
+ */
+typedef struct _rcount {
+	pgno_t	  pgno;			/* Page number, or P_INVALID. */
+	u_int32_t gen;			/* Tree generation of the sums. */
+	indx_t	  nent;			/* Number of page entries. */
+	indx_t	  size;			/* Size of the sums array. */
+	recno_t	 *sums;			/* Records through each entry. */
+} RCOUNT;
+#define	RC_NSLOTS	64		/* Number of cached pages. */
+
 /*
  * About cursors.  The cursor (and the page that contained the key/data pair
  * that it referenced) can be deleted, which makes things a bit tricky.  If
@@ -350,6 +364,9 @@ typedef struct _btree {
 	size_t	  bt_msize;		/* R: size of mapped region. */
 
 	recno_t	  bt_nrecs;		/* R: number of records */
+	RCOUNT	 *bt_rcnt;		/* R: internal page running sums */
+	u_int32_t bt_rgen;		/* R: generation of the sums */
+	recno_t	  bt_rpin;		/* R: records when last leaf pinned */
 	size_t	  bt_reclen;		/* R: fixed record length */
 	u_char	  bt_bval;		/* R: delimiting byte/pad character */
 
@@ -174,6 +174,25 @@ typedef struct {
 } RECNOINFO;
 
 #ifdef __DBINTERFACE_PRIVATE
+/* Structure used to return memory pool statistics. */
+typedef struct {
+	u_long	pagesize;	/* page size */
+	u_long	npages;		/* pages in the file */
+	u_long	curcache;	/* pages cached */
+	u_long	maxcache;	/* max pages cached */
+	u_long	nin;		/* pages on the in queue */
+	u_long	nout;		/* page numbers on the out queue */
+	u_long	cachehit;	/* gets found in the cache */
+	u_long	cachemiss;	/* gets not found in the cache */
+	u_long	pageget;	/* page gets */
+	u_long	pageput;	/* page puts */
+	u_long	pagenew;	/* new pages */
+	u_long	pagealloc;	/* buffers allocated */
+	u_long	pageflush;	/* buffers reused */
+	u_long	pageread;	/* pages read */
+	u_long	pagewrite;	/* pages written */
+} MPOOLSTAT;
+
 /*
  * Little endian <==> big endian 32-bit swap macros.
  *	M_32_SWAP	swap a memory location
@@ -231,6 +250,9 @@ DB	*__bt_open __P((const char *, int, int, const BTREEINFO *, int));
 DB	*__hash_open __P((const char *, int, int, const HASHINFO *, int));
 DB	*__rec_open __P((const char *, int, int, const RECNOINFO *, int));
 void	 __dbpanic __P((DB *dbp));
+int	 __rec_wfilter __P((const DB *,
+	    void (*)(void *, pgno_t), void *, u_long *));
+int	 __rec_mpstat __P((const DB *, MPOOLSTAT *));
 #endif
 __END_DECLS
 #endif /* !_DB_H_ */
@@ -38,31 +38,51 @@
 /*
  * The memory pool scheme is a simple one.  Each in-memory page is referenced
  * by a bucket which is threaded in up to two of three ways.  All active pages
- * are threaded on a hash chain (hashed by page number) and an lru chain.
- * Inactive pages are threaded on a free chain.  Each reference to a memory
- * pool is handed an opaque MPOOL cookie which stores all of this information.
+ * are threaded on a hash chain (hashed by page number) and one of two queues.
+ * Pages are replaced using the 2Q algorithm: a page read in goes on the tail
+ * of the in queue, which is FIFO, and is not moved when it's referenced
+ * again.  A page referenced again after other pages have been read, i.e.,
+ * not just in the burst of references that read it, goes on the lru queue
+ * of pages known to be reused when it reaches the head of the in queue;
+ * other pages leaving the in queue have their page numbers remembered on
+ * the out queue, and if read again while there, go on the lru queue.  A
+ * long scan of the file therefore only cycles pages through the in queue
+ * and leaves the lru pages alone.
+ * The hash table grows with the cache.  Each reference to a memory pool is
+ * handed an opaque MPOOL cookie which stores all of this information.
  */
-#define	HASHSIZE	128
-#define	HASHKEY(pgno)	((pgno - 1) % HASHSIZE)
+#define	HASHSIZE	128		/* minimum hash table size */
+#define	HASHKEY(mp, pgno)	((pgno - 1) & (mp)->hashmask)
 
 /* The BKT structures are the elements of the queues. */
 typedef struct _bkt {
 	CIRCLEQ_ENTRY(_bkt) hq;		/* hash queue */
-	CIRCLEQ_ENTRY(_bkt) q;		/* lru queue */
-	void    *page;			/* page */
+	CIRCLEQ_ENTRY(_bkt) q;		/* in, lru or out queue */
+	void    *page;			/* page, NULL on the out queue */
 	pgno_t   pgno;			/* page number */
+	u_long	 stamp;			/* pages read or new when read in */
 
 #define	MPOOL_DIRTY	0x01		/* page needs to be written */
 #define	MPOOL_PINNED	0x02		/* page is pinned into memory */
+#define	MPOOL_INQ	0x04		/* page is on the in queue */
+#define	MPOOL_GHOST	0x08		/* page number on the out queue */
+#define	MPOOL_REF	0x10		/* page referenced again */
 	u_int8_t flags;			/* flags */
 } BKT;
 
 typedef struct MPOOL {
 	CIRCLEQ_HEAD(_lqh, _bkt) lqh;	/* lru queue head */
+	struct _lqh iqh;		/* in queue head */
+	struct _lqh oqh;		/* out queue head */
 					/* hash queue array */
-	CIRCLEQ_HEAD(_hqh, _bkt) hqh[HASHSIZE];
+	CIRCLEQ_HEAD(_hqh, _bkt) *hqh;
+	pgno_t	hashmask;		/* hash table size - 1 */
 	pgno_t	curcache;		/* current number of cached pages */
 	pgno_t	maxcache;		/* max number of cached pages */
+	pgno_t	nin;			/* pages on the in queue */
+	pgno_t	maxin;			/* in queue share of the cache */
+	pgno_t	nout;			/* page numbers on the out queue */
+	pgno_t	maxout;			/* max page numbers on the out queue */
 	pgno_t	npages;			/* number of pages in the file */
 	u_long	pagesize;		/* file page size */
 	int	fd;			/* file descriptor */
@@ -71,7 +91,9 @@ typedef struct MPOOL {
 					/* page out conversion routine */
 	void    (*pgout) __P((void *, pgno_t, void *));
 	void	*pgcookie;		/* cookie for page in/out routines */
-#ifdef STATISTICS
+					/* page write notification */
+	void    (*pgwrite) __P((void *, pgno_t));
+	void	*pgwcookie;		/* cookie for page write routine */
 	u_long	cachehit;
 	u_long	cachemiss;
 	u_long	pagealloc;
@@ -81,18 +103,19 @@ typedef struct MPOOL {
 	u_long	pageput;
 	u_long	pageread;
 	u_long	pagewrite;
-#endif
 } MPOOL;
 
 __BEGIN_DECLS
 MPOOL	*mpool_open __P((void *, int, pgno_t, pgno_t));
 void	 mpool_filter __P((MPOOL *, void (*)(void *, pgno_t, void *),
 	    void (*)(void *, pgno_t, void *), void *));
+void	 mpool_wfilter __P((MPOOL *, void (*)(void *, pgno_t), void *));
 void	*mpool_new __P((MPOOL *, pgno_t *));
 void	*mpool_get __P((MPOOL *, pgno_t, u_int));
 int	 mpool_put __P((MPOOL *, void *, u_int));
 int	 mpool_sync __P((MPOOL *));
 int	 mpool_close __P((MPOOL *));
+void	 mpool_getstat __P((MPOOL *, MPOOLSTAT *));
 #ifdef STATISTICS
 void	 mpool_stat __P((MPOOL *));
 #endif
@@ -51,6 +51,8 @@ static char sccsid[] = "@(#)mpool.c	8.5 (Berkeley) 7/26/94";
 #include <mpool.h>
 
 static BKT *mpool_bkt __P((MPOOL *));
+static void mpool_ghost __P((MPOOL *, pgno_t));
+static int  mpool_hash __P((MPOOL *, pgno_t));
 static BKT *mpool_look __P((MPOOL *, pgno_t));
 static int  mpool_write __P((MPOOL *, BKT *));
 
@@ -66,7 +68,6 @@ mpool_open(key, fd, pagesize, maxcache)
 {
 	struct stat sb;
 	MPOOL *mp;
-	int entry;
 
 	/*
 	 * Get information about the file.
@@ -85,9 +86,22 @@ mpool_open(key, fd, pagesize, maxcache)
 	if ((mp = (MPOOL *)calloc(1, sizeof(MPOOL))) == NULL)
 		return (NULL);
 	CIRCLEQ_INIT(&mp->lqh);
-	for (entry = 0; entry < HASHSIZE; ++entry)
-		CIRCLEQ_INIT(&mp->hqh[entry]);
+	CIRCLEQ_INIT(&mp->iqh);
+	CIRCLEQ_INIT(&mp->oqh);
 	mp->maxcache = maxcache;
+
+	/*
+	 * The in queue gets a quarter of the cache, and the out queue
+	 * remembers half as many pages as the cache holds.
+	 */
+	if ((mp->maxin = maxcache / 4) == 0)
+		mp->maxin = 1;
+	if ((mp->maxout = maxcache / 2) == 0)
+		mp->maxout = 1;
+	if (mpool_hash(mp, maxcache + mp->maxout)) {
+		free(mp);
+		return (NULL);
+	}
 	mp->npages = sb.st_size / pagesize;
 	mp->pagesize = pagesize;
 	mp->fd = fd;
@@ -109,6 +123,22 @@ mpool_filter(mp, pgin, pgout, pgcookie)
 	mp->pgout = pgout;
 	mp->pgcookie = pgcookie;
 }
+
+/*
+ * mpool_wfilter --
+ *	Initialize the page write notification.  The routine is called
+ *	before a page is written to the file, while the file still has
+ *	the page's previous contents.
+ */
+void
+mpool_wfilter(mp, pgwrite, pgwcookie)
+	MPOOL *mp;
+	void (*pgwrite) __P((void *, pgno_t));
+	void *pgwcookie;
+{
+	mp->pgwrite = pgwrite;
+	mp->pgwcookie = pgwcookie;
+}
 	
 /*
  * mpool_new --
@@ -126,22 +156,22 @@ mpool_new(mp, pgnoaddr)
 		(void)fprintf(stderr, "mpool_new: page allocation overflow.\n");
 		abort();
 	}
-#ifdef STATISTICS
 	++mp->pagenew;
-#endif
 	/*
 	 * Get a BKT from the cache.  Assign a new page number, attach
-	 * it to the head of the hash chain, the tail of the lru chain,
+	 * it to the head of the hash chain, the tail of the in queue,
 	 * and return.
 	 */
 	if ((bp = mpool_bkt(mp)) == NULL)
 		return (NULL);
 	*pgnoaddr = bp->pgno = mp->npages++;
-	bp->flags = MPOOL_PINNED;
+	bp->flags = MPOOL_PINNED | MPOOL_INQ;
+	bp->stamp = mp->pageread + mp->pagenew;
 
-	head = &mp->hqh[HASHKEY(bp->pgno)];
+	head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 	CIRCLEQ_INSERT_HEAD(head, bp, hq);
-	CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
+	CIRCLEQ_INSERT_TAIL(&mp->iqh, bp, q);
+	++mp->nin;
 	return (bp->page);
 }
 
@@ -157,8 +187,8 @@ mpool_get(mp, pgno, flags)
 {
 	struct _hqh *head;
 	BKT *bp;
-	off_t off;
-	int nr;
+	ssize_t nr;
+	int reused;
 
 	/* Check for attempt to retrieve a non-existent page. */
 	if (pgno >= mp->npages) {
@@ -166,12 +196,24 @@ mpool_get(mp, pgno, flags)
 		return (NULL);
 	}
 
-#ifdef STATISTICS
 	++mp->pageget;
-#endif
 
 	/* Check for a page that is cached. */
+	reused = 0;
 	if ((bp = mpool_look(mp, pgno)) != NULL) {
+		if (bp->flags & MPOOL_GHOST) {
+			/*
+			 * The page was on the in queue recently; it's being
+			 * reused, so it goes on the lru queue this time.
+			 */
+			head = &mp->hqh[HASHKEY(mp, bp->pgno)];
+			CIRCLEQ_REMOVE(head, bp, hq);
+			CIRCLEQ_REMOVE(&mp->oqh, bp, q);
+			--mp->nout;
+			free(bp);
+			reused = 1;
+			goto miss;
+		}
 #ifdef DEBUG
 		if (bp->flags & MPOOL_PINNED) {
 			(void)fprintf(stderr,
@@ -180,14 +222,19 @@ mpool_get(mp, pgno, flags)
 		}
 #endif
 		/*
-		 * Move the page to the head of the hash chain and the tail
-		 * of the lru chain.
+		 * Move the page to the head of the hash chain and, unless
+		 * it's on the in queue, to the tail of the lru queue.  A page
+		 * on the in queue is marked if other pages have been read in
+		 * since it was.
 		 */
-		head = &mp->hqh[HASHKEY(bp->pgno)];
+		head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 		CIRCLEQ_REMOVE(head, bp, hq);
 		CIRCLEQ_INSERT_HEAD(head, bp, hq);
-		CIRCLEQ_REMOVE(&mp->lqh, bp, q);
-		CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
+		if (!(bp->flags & MPOOL_INQ)) {
+			CIRCLEQ_REMOVE(&mp->lqh, bp, q);
+			CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
+		} else if (bp->stamp != mp->pageread + mp->pagenew)
+			bp->flags |= MPOOL_REF;
 
 		/* Return a pinned page. */
 		bp->flags |= MPOOL_PINNED;
@@ -195,17 +242,14 @@ mpool_get(mp, pgno, flags)
 	}
 
 	/* Get a page from the cache. */
-	if ((bp = mpool_bkt(mp)) == NULL)
+miss:	if ((bp = mpool_bkt(mp)) == NULL)
 		return (NULL);
 
 	/* Read in the contents. */
-#ifdef STATISTICS
 	++mp->pageread;
-#endif
-	off = mp->pagesize * pgno;
-	if (lseek(mp->fd, off, SEEK_SET) != off)
-		return (NULL);
-	if ((nr = read(mp->fd, bp->page, mp->pagesize)) != mp->pagesize) {
+	if ((nr = pread(mp->fd,
+	    bp->page, mp->pagesize, (off_t)mp->pagesize * pgno)) !=
+	    (ssize_t)mp->pagesize) {
 		if (nr >= 0)
 			errno = EFTYPE;
 		return (NULL);
@@ -214,14 +258,21 @@ mpool_get(mp, pgno, flags)
 	/* Set the page number, pin the page. */
 	bp->pgno = pgno;
 	bp->flags = MPOOL_PINNED;
+	bp->stamp = mp->pageread + mp->pagenew;
 
 	/*
-	 * Add the page to the head of the hash chain and the tail
-	 * of the lru chain.
+	 * Add the page to the head of the hash chain and the tail of
+	 * the lru queue if it's being reused, the in queue otherwise.
 	 */
-	head = &mp->hqh[HASHKEY(bp->pgno)];
+	head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 	CIRCLEQ_INSERT_HEAD(head, bp, hq);
-	CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
+	if (reused) {
+		CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
+	} else {
+		bp->flags |= MPOOL_INQ;
+		CIRCLEQ_INSERT_TAIL(&mp->iqh, bp, q);
+		++mp->nin;
+	}
 
 	/* Run through the user's filter. */
 	if (mp->pgin != NULL)
@@ -242,9 +293,7 @@ mpool_put(mp, page, flags)
 {
 	BKT *bp;
 
-#ifdef STATISTICS
 	++mp->pageput;
-#endif
 	bp = (BKT *)((char *)page - sizeof(BKT));
 #ifdef DEBUG
 	if (!(bp->flags & MPOOL_PINNED)) {
@@ -268,13 +317,22 @@ mpool_close(mp)
 {
 	BKT *bp;
 
-	/* Free up any space allocated to the lru pages. */
+	/* Free up any space allocated to the pages and page numbers. */
 	while ((bp = mp->lqh.cqh_first) != (void *)&mp->lqh) {
 		CIRCLEQ_REMOVE(&mp->lqh, mp->lqh.cqh_first, q);
 		free(bp);
 	}
+	while ((bp = mp->iqh.cqh_first) != (void *)&mp->iqh) {
+		CIRCLEQ_REMOVE(&mp->iqh, mp->iqh.cqh_first, q);
+		free(bp);
+	}
+	while ((bp = mp->oqh.cqh_first) != (void *)&mp->oqh) {
+		CIRCLEQ_REMOVE(&mp->oqh, mp->oqh.cqh_first, q);
+		free(bp);
+	}
 
-	/* Free the MPOOL cookie. */
+	/* Free the hash table and the MPOOL cookie. */
+	free(mp->hqh);
 	free(mp);
 	return (RET_SUCCESS);
 }
@@ -289,7 +347,12 @@ mpool_sync(mp)
 {
 	BKT *bp;
 
-	/* Walk the lru chain, flushing any dirty pages to disk. */
+	/* Walk the in and lru queues, flushing any dirty pages to disk. */
+	for (bp = mp->iqh.cqh_first;
+	    bp != (void *)&mp->iqh; bp = bp->q.cqe_next)
+		if (bp->flags & MPOOL_DIRTY &&
+		    mpool_write(mp, bp) == RET_ERROR)
+			return (RET_ERROR);
 	for (bp = mp->lqh.cqh_first;
 	    bp != (void *)&mp->lqh; bp = bp->q.cqe_next)
 		if (bp->flags & MPOOL_DIRTY &&
@@ -309,32 +372,50 @@ mpool_bkt(mp)
 	MPOOL *mp;
 {
 	struct _hqh *head;
-	BKT *bp;
+	struct _lqh *qp;
+	BKT *bp, *nbp;
+	int inq, pass;
 
 	/* If under the max cached, always create a new page. */
 	if (mp->curcache < mp->maxcache)
 		goto new;
 
 	/*
-	 * If the cache is max'd out, walk the lru list for a buffer we
-	 * can flush.  If we find one, write it (if necessary) and take it
-	 * off any lists.  If we don't find anything we grow the cache anyway.
-	 * The cache never shrinks.
+	 * If the cache is max'd out, look for a buffer we can flush, on
+	 * the in queue if it's holding more than its share of the cache,
+	 * and on the lru queue otherwise; if there's nothing there, try
+	 * the other one.  Marked pages on the in queue are moved to the lru
+	 * queue as they're passed.  If we find one, write it (if necessary)
+	 * and take it off any lists.  If we don't find anything we grow the
+	 * cache anyway.  The cache never shrinks.
 	 */
-	for (bp = mp->lqh.cqh_first;
-	    bp != (void *)&mp->lqh; bp = bp->q.cqe_next)
-		if (!(bp->flags & MPOOL_PINNED)) {
+	inq = mp->nin > mp->maxin;
+	for (pass = 0; pass < 2; ++pass, inq = !inq) {
+		qp = inq ? &mp->iqh : &mp->lqh;
+		for (bp = qp->cqh_first; bp != (void *)qp; bp = nbp) {
+			nbp = bp->q.cqe_next;
+			if (bp->flags & MPOOL_PINNED)
+				continue;
+			if (bp->flags & MPOOL_REF) {
+				CIRCLEQ_REMOVE(&mp->iqh, bp, q);
+				CIRCLEQ_INSERT_TAIL(&mp->lqh, bp, q);
+				bp->flags &= ~(MPOOL_INQ | MPOOL_REF);
+				--mp->nin;
+				continue;
+			}
 			/* Flush if dirty. */
 			if (bp->flags & MPOOL_DIRTY &&
 			    mpool_write(mp, bp) == RET_ERROR)
 				return (NULL);
-#ifdef STATISTICS
 			++mp->pageflush;
-#endif
-			/* Remove from the hash and lru queues. */
-			head = &mp->hqh[HASHKEY(bp->pgno)];
+			/* Remove from the hash and page queues. */
+			head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 			CIRCLEQ_REMOVE(head, bp, hq);
-			CIRCLEQ_REMOVE(&mp->lqh, bp, q);
+			CIRCLEQ_REMOVE(qp, bp, q);
+			if (bp->flags & MPOOL_INQ) {
+				--mp->nin;
+				mpool_ghost(mp, bp->pgno);
+			}
 #ifdef DEBUG
 			{ void *spage;
 				spage = bp->page;
@@ -344,20 +425,95 @@ mpool_bkt(mp)
 #endif
 			return (bp);
 		}
+	}
 
 new:	if ((bp = (BKT *)malloc(sizeof(BKT) + mp->pagesize)) == NULL)
 		return (NULL);
-#ifdef STATISTICS
 	++mp->pagealloc;
-#endif
 #if defined(DEBUG) || defined(PURIFY)
 	memset(bp, 0xff, sizeof(BKT) + mp->pagesize);
 #endif
 	bp->page = (char *)bp + sizeof(BKT);
 	++mp->curcache;
+
+	/*
+	 * Keep the hash chains short as the cache grows.  If the table
+	 * can't be grown, the old one still works.
+	 */
+	if (mp->curcache + mp->nout > 2 * (mp->hashmask + 1))
+		(void)mpool_hash(mp, mp->curcache + mp->maxout);
 	return (bp);
 }
 
+/*
+ * mpool_ghost
+ *	Remember the number of a page leaving the in queue.
+ */
+static void
+mpool_ghost(mp, pgno)
+	MPOOL *mp;
+	pgno_t pgno;
+{
+	struct _hqh *head;
+	BKT *gp;
+
+	/* Reuse the oldest entry if the out queue is full. */
+	if (mp->nout >= mp->maxout) {
+		gp = mp->oqh.cqh_first;
+		head = &mp->hqh[HASHKEY(mp, gp->pgno)];
+		CIRCLEQ_REMOVE(head, gp, hq);
+		CIRCLEQ_REMOVE(&mp->oqh, gp, q);
+		--mp->nout;
+	} else if ((gp = (BKT *)malloc(sizeof(BKT))) == NULL)
+		return;
+	gp->page = NULL;
+	gp->pgno = pgno;
+	gp->flags = MPOOL_GHOST;
+
+	head = &mp->hqh[HASHKEY(mp, pgno)];
+	CIRCLEQ_INSERT_HEAD(head, gp, hq);
+	CIRCLEQ_INSERT_TAIL(&mp->oqh, gp, q);
+	++mp->nout;
+}
+
+/*
+ * mpool_hash
+ *	Size the hash table for the specified number of entries.
+ */
+static int
+mpool_hash(mp, nelem)
+	MPOOL *mp;
+	pgno_t nelem;
+{
+	struct _hqh *hqh;
+	struct _lqh *qp;
+	BKT *bp;
+	pgno_t entry, size;
+
+	for (size = HASHSIZE; size < nelem && size < MAX_PAGE_NUMBER / 2;)
+		size <<= 1;
+	if (mp->hqh != NULL && size <= mp->hashmask + 1)
+		return (RET_SUCCESS);
+	if ((hqh = malloc(size * sizeof(*hqh))) == NULL)
+		return (RET_ERROR);
+	for (entry = 0; entry < size; ++entry)
+		CIRCLEQ_INIT(&hqh[entry]);
+	if (mp->hqh != NULL)
+		free(mp->hqh);
+	mp->hqh = hqh;
+	mp->hashmask = size - 1;
+
+	/* Rethread everything that's on a queue onto the new chains. */
+	for (qp = &mp->iqh;; qp = qp == &mp->iqh ? &mp->lqh : &mp->oqh) {
+		for (bp = qp->cqh_first; bp != (void *)qp; bp = bp->q.cqe_next)
+			CIRCLEQ_INSERT_HEAD(&mp->hqh[HASHKEY(mp, bp->pgno)],
+			    bp, hq);
+		if (qp == &mp->oqh)
+			break;
+	}
+	return (RET_SUCCESS);
+}
+
 /*
  * mpool_write
  *	Write a page to disk.
@@ -367,20 +523,18 @@ mpool_write(mp, bp)
 	MPOOL *mp;
 	BKT *bp;
 {
-	off_t off;
-
-#ifdef STATISTICS
 	++mp->pagewrite;
-#endif
 
 	/* Run through the user's filter. */
 	if (mp->pgout)
 		(mp->pgout)(mp->pgcookie, bp->pgno, bp->page);
 
-	off = mp->pagesize * bp->pgno;
-	if (lseek(mp->fd, off, SEEK_SET) != off)
-		return (RET_ERROR);
-	if (write(mp->fd, bp->page, mp->pagesize) != mp->pagesize)
+	/* Tell the user the page is about to change. */
+	if (mp->pgwrite)
+		(mp->pgwrite)(mp->pgwcookie, bp->pgno);
+
+	if (pwrite(mp->fd, bp->page, mp->pagesize,
+	    (off_t)mp->pagesize * bp->pgno) != (ssize_t)mp->pagesize)
 		return (RET_ERROR);
 
 	bp->flags &= ~MPOOL_DIRTY;
@@ -399,20 +553,45 @@ mpool_look(mp, pgno)
 	struct _hqh *head;
 	BKT *bp;
 
-	head = &mp->hqh[HASHKEY(pgno)];
+	head = &mp->hqh[HASHKEY(mp, pgno)];
 	for (bp = head->cqh_first; bp != (void *)head; bp = bp->hq.cqe_next)
 		if (bp->pgno == pgno) {
-#ifdef STATISTICS
-			++mp->cachehit;
-#endif
+			if (bp->flags & MPOOL_GHOST)
+				++mp->cachemiss;
+			else
+				++mp->cachehit;
 			return (bp);
 		}
-#ifdef STATISTICS
 	++mp->cachemiss;
-#endif
 	return (NULL);
 }
 
+/*
+ * mpool_getstat
+ *	Return cache statistics.
+ */
+void
+mpool_getstat(mp, sp)
+	MPOOL *mp;
+	MPOOLSTAT *sp;
+{
+	sp->pagesize = mp->pagesize;
+	sp->npages = mp->npages;
+	sp->curcache = mp->curcache;
+	sp->maxcache = mp->maxcache;
+	sp->nin = mp->nin;
+	sp->nout = mp->nout;
+	sp->cachehit = mp->cachehit;
+	sp->cachemiss = mp->cachemiss;
+	sp->pageget = mp->pageget;
+	sp->pageput = mp->pageput;
+	sp->pagenew = mp->pagenew;
+	sp->pagealloc = mp->pagealloc;
+	sp->pageflush = mp->pageflush;
+	sp->pageread = mp->pageread;
+	sp->pagewrite = mp->pagewrite;
+}
+
 #ifdef STATISTICS
 /*
  * mpool_stat
@@ -422,6 +601,7 @@ void
 mpool_stat(mp)
 	MPOOL *mp;
 {
+	struct _lqh *qp;
 	BKT *bp;
 	int cnt;
 	char *sep;
@@ -441,22 +621,28 @@ mpool_stat(mp)
 		    * 100, mp->cachehit, mp->cachemiss);
 	(void)fprintf(stderr, "%lu page reads, %lu page writes\n",
 	    mp->pageread, mp->pagewrite);
+	(void)fprintf(stderr,
+	    "%lu pages on the in queue, %lu page numbers on the out queue\n",
+	    mp->nin, mp->nout);
 
 	sep = "";
 	cnt = 0;
-	for (bp = mp->lqh.cqh_first;
-	    bp != (void *)&mp->lqh; bp = bp->q.cqe_next) {
-		(void)fprintf(stderr, "%s%d", sep, bp->pgno);
-		if (bp->flags & MPOOL_DIRTY)
-			(void)fprintf(stderr, "d");
-		if (bp->flags & MPOOL_PINNED)
-			(void)fprintf(stderr, "P");
-		if (++cnt == 10) {
-			sep = "\n";
-			cnt = 0;
-		} else
-			sep = ", ";
-			
+	for (qp = &mp->iqh;; qp = &mp->lqh) {
+		for (bp = qp->cqh_first;
+		    bp != (void *)qp; bp = bp->q.cqe_next) {
+			(void)fprintf(stderr, "%s%d", sep, bp->pgno);
+			if (bp->flags & MPOOL_DIRTY)
+				(void)fprintf(stderr, "d");
+			if (bp->flags & MPOOL_PINNED)
+				(void)fprintf(stderr, "P");
+			if (++cnt == 10) {
+				sep = "\n";
+				cnt = 0;
+			} else
+				sep = ", ";
+		}
+		if (qp == &mp->lqh)
+			break;
 	}
 	(void)fprintf(stderr, "\n");
 }
@@ -52,3 +52,6 @@ int	 __rec_sync __P((const DB *, u_int));
 int	 __rec_vmap __P((BTREE *, recno_t));
 int	 __rec_vout __P((BTREE *));
 int	 __rec_vpipe __P((BTREE *, recno_t));
+int	 __rec_wfilter __P((const DB *,
+	    void (*)(void *, pgno_t), void *, u_long *));
+int	 __rec_mpstat __P((const DB *, MPOOLSTAT *));
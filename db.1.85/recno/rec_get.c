@@ -47,6 +47,13 @@ static char sccsid[] = "@(#)rec_get.c	8.9 (Berkeley) 8/18/94";
 #include <db.h>
 #include "recno.h"
 
+static int rec_append __P((BTREE *, PAGE **, DBT *));
+static int rec_unpin __P((BTREE *, PAGE *));
+static int rec_vread __P((BTREE *));
+
+/* Read size for loading a whole file through a stdio stream. */
+#define	REC_RBLOCK	(64 * 1024)
+
 /*
  * __REC_GET -- Get a record from the btree.
  *
@@ -180,12 +187,18 @@ __rec_vpipe(t, top)
 	recno_t top;
 {
 	DBT data;
+	PAGE *h;
 	recno_t nrec;
 	indx_t len;
 	size_t sz;
 	int bval, ch;
 	u_char *p;
 
+	/* Reading the rest of the file, do it a block at a time. */
+	if (top == MAX_REC_NUMBER)
+		return (rec_vread(t));
+
+	h = NULL;
 	bval = t->bt_bval;
 	for (nrec = t->bt_nrecs; nrec < top; ++nrec) {
 		for (p = t->bt_rdata.data,
@@ -195,8 +208,7 @@ __rec_vpipe(t, top)
 				data.size = p - (u_char *)t->bt_rdata.data;
 				if (ch == EOF && data.size == 0)
 					break;
-				if (__rec_iput(t, nrec, &data, 0)
-				    != RET_SUCCESS)
+				if (rec_append(t, &h, &data) != RET_SUCCESS)
 					return (RET_ERROR);
 				break;
 			}
@@ -206,14 +218,19 @@ __rec_vpipe(t, top)
 				t->bt_rdata.data = t->bt_rdata.data == NULL ?
 				    malloc(t->bt_rdata.size) :
 				    realloc(t->bt_rdata.data, t->bt_rdata.size);
-				if (t->bt_rdata.data == NULL)
+				if (t->bt_rdata.data == NULL) {
+					if (h != NULL)
+						(void)rec_unpin(t, h);
 					return (RET_ERROR);
+				}
 				p = (u_char *)t->bt_rdata.data + len;
 			}
 		}
 		if (ch == EOF)
 			break;
 	}
+	if (h != NULL && rec_unpin(t, h) != RET_SUCCESS)
+		return (RET_ERROR);
 	if (nrec < top) {
 		F_SET(t, R_EOF);
 		return (RET_SPECIAL);
@@ -287,25 +304,215 @@ __rec_vmap(t, top)
 	recno_t top;
 {
 	DBT data;
-	u_char *sp, *ep;
+	PAGE *h;
+	u_char *sp, *ep, *p;
 	recno_t nrec;
-	int bval;
+	int bval, status;
 
 	sp = (u_char *)t->bt_cmap;
 	ep = (u_char *)t->bt_emap;
 	bval = t->bt_bval;
 
+	h = NULL;
+	status = RET_SUCCESS;
 	for (nrec = t->bt_nrecs; nrec < top; ++nrec) {
 		if (sp >= ep) {
 			F_SET(t, R_EOF);
-			return (RET_SPECIAL);
+			status = RET_SPECIAL;
+			goto done;
 		}
-		for (data.data = sp; sp < ep && *sp != bval; ++sp);
-		data.size = sp - (u_char *)data.data;
-		if (__rec_iput(t, nrec, &data, 0) != RET_SUCCESS)
-			return (RET_ERROR);
-		++sp;
+		if ((p = memchr(sp, bval, ep - sp)) == NULL)
+			p = ep;
+		data.data = sp;
+		data.size = p - sp;
+		if (rec_append(t, &h, &data) != RET_SUCCESS) {
+			status = RET_ERROR;
+			goto done;
+		}
+		sp = p + 1;
 	}
 	t->bt_cmap = (caddr_t)sp;
+
+done:	if (h != NULL && rec_unpin(t, h) != RET_SUCCESS)
+		status = RET_ERROR;
+	return (status);
+}
+
+/*
+ * REC_VREAD -- Get the rest of the variable length records from a stream.
+ *
+ * Parameters:
+ *	t:	tree
+ *
+ * Returns:
+ *	RET_ERROR, RET_SPECIAL
+ */
+static int
+rec_vread(t)
+	BTREE *t;
+{
+	DBT data;
+	PAGE *h;
+	u_char *sp, *ep, *p;
+	size_t len, n, nsize;
+	int bval, status;
+	void *np;
+
+	h = NULL;
+	status = RET_ERROR;
+	bval = t->bt_bval;
+	for (len = 0;;) {
+		/*
+		 * The start of a line that hasn't been terminated yet is
+		 * kept at the front of the buffer; make room for a block
+		 * after it.
+		 */
+		if (t->bt_rdata.size < len + REC_RBLOCK) {
+			nsize = t->bt_rdata.size * 2;
+			if (nsize < len + REC_RBLOCK)
+				nsize = len + REC_RBLOCK;
+			np = t->bt_rdata.data == NULL ?
+			    malloc(nsize) : realloc(t->bt_rdata.data, nsize);
+			if (np == NULL)
+				goto err;
+			t->bt_rdata.data = np;
+			t->bt_rdata.size = nsize;
+		}
+		sp = t->bt_rdata.data;
+		if ((n = fread(sp + len,
+		    1, t->bt_rdata.size - len, t->bt_rfp)) == 0)
+			break;
+		for (ep = sp + len + n;
+		    (p = memchr(sp, bval, ep - sp)) != NULL; sp = p + 1) {
+			data.data = sp;
+			data.size = p - sp;
+			if (rec_append(t, &h, &data) != RET_SUCCESS)
+				goto err;
+		}
+		len = ep - sp;
+		if (len != 0 && sp != (u_char *)t->bt_rdata.data)
+			memmove(t->bt_rdata.data, sp, len);
+	}
+	if (ferror(t->bt_rfp))
+		goto err;
+
+	/* The last line may not have been terminated. */
+	if (len != 0) {
+		data.data = t->bt_rdata.data;
+		data.size = len;
+		if (rec_append(t, &h, &data) != RET_SUCCESS)
+			goto err;
+	}
+	F_SET(t, R_EOF);
+	status = RET_SPECIAL;
+
+err:	if (h != NULL && rec_unpin(t, h) != RET_SUCCESS)
+		status = RET_ERROR;
+	return (status);
+}
+
+/*
+ * REC_APPEND -- Add a record read from the file to the end of the tree.
+ *
+ * Parameters:
+ *	t:	tree
+ *	hp:	pinned last leaf page, or NULL
+ *	data:	record
+ *
+ * Records read from the file all go on the last leaf page, so the caller
+ * keeps that page pinned between calls and records are copied onto it
+ * directly instead of searching down from the root for each one.  The
+ * general insert routine is only used to split the page or for records
+ * that need overflow pages.  The caller releases any page left in *hp
+ * with rec_unpin.
+ *
+ * Returns:
+ *	RET_ERROR, RET_SUCCESS
+ */
+static int
+rec_append(t, hp, data)
+	BTREE *t;
+	PAGE **hp;
+	DBT *data;
+{
+	EPG *e;
+	PAGE *h;
+	indx_t index;
+	u_int32_t nbytes;
+	char *dest;
+
+	h = *hp;
+	*hp = NULL;
+	if (data->size > t->bt_ovflsize) {
+		if (h != NULL && rec_unpin(t, h) != RET_SUCCESS)
+			return (RET_ERROR);
+		return (__rec_iput(t, t->bt_nrecs, data, 0));
+	}
+
+	nbytes = NRLEAFDBT(data->size);
+	if (h == NULL) {
+		if ((e = __rec_search(t, t->bt_nrecs, SEARCH)) == NULL)
+			return (RET_ERROR);
+		h = e->page;
+		if (e->index != NEXTINDEX(h) ||
+		    h->upper - h->lower < nbytes + sizeof(indx_t)) {
+			mpool_put(t->bt_mp, h, 0);
+			return (__rec_iput(t, t->bt_nrecs, data, 0));
+		}
+		t->bt_rpin = t->bt_nrecs;
+	} else if (h->upper - h->lower < nbytes + sizeof(indx_t)) {
+		if (rec_unpin(t, h) != RET_SUCCESS)
+			return (RET_ERROR);
+		return (__rec_iput(t, t->bt_nrecs, data, 0));
+	}
+
+	index = NEXTINDEX(h);
+	h->lower += sizeof(indx_t);
+	h->linp[index] = h->upper -= nbytes;
+	dest = (char *)h + h->upper;
+	WR_RLEAF(dest, data, 0);
+
+	++t->bt_nrecs;
+	F_SET(t, B_MODIFIED);
+	*hp = h;
+	return (RET_SUCCESS);
+}
+
+/*
+ * REC_UNPIN -- Release the pinned last leaf page.
+ *
+ * The records copied onto the page didn't go through __rec_search, so
+ * the record counts of the internal entries on the path down to it are
+ * brought up to date here, all at once.  The path is still on the stack
+ * from the search that found the page, nothing else searches the tree
+ * while the page is pinned.
+ *
+ * Parameters:
+ *	t:	tree
+ *	h:	pinned last leaf page
+ *
+ * Returns:
+ *	RET_ERROR, RET_SUCCESS
+ */
+static int
+rec_unpin(t, h)
+	BTREE *t;
+	PAGE *h;
+{
+	EPGNO *parent;
+	recno_t n;
+
+	mpool_put(t->bt_mp, h, MPOOL_DIRTY);
+	if ((n = t->bt_nrecs - t->bt_rpin) == 0)
+		return (RET_SUCCESS);
+
+	/* The running sums of the internal pages are out of date. */
+	++t->bt_rgen;
+	while ((parent = BT_POP(t)) != NULL) {
+		if ((h = mpool_get(t->bt_mp, parent->pgno, 0)) == NULL)
+			return (RET_ERROR);
+		GETRINTERNAL(h, parent->index)->nrecs += n;
+		mpool_put(t->bt_mp, h, MPOOL_DIRTY);
+	}
 	return (RET_SUCCESS);
 }
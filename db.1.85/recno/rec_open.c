@@ -239,3 +239,59 @@ __rec_fd(dbp)
 	}
 	return (t->bt_rfd);
 }
+
+/*
+ * __REC_WFILTER -- have a routine told which backing file pages are about
+ *	to be written.
+ *
+ * Parameters:
+ *	dbp:	pointer to access method
+ *	pgwrite:	routine, called with the cookie and the page number
+ *	pgwcookie:	cookie
+ *	psizep:	page size return
+ *
+ * Returns:
+ *	RET_SUCCESS, RET_ERROR.
+ */
+int
+__rec_wfilter(dbp, pgwrite, pgwcookie, psizep)
+	const DB *dbp;
+	void (*pgwrite) __P((void *, pgno_t));
+	void *pgwcookie;
+	u_long *psizep;
+{
+	BTREE *t;
+
+	t = dbp->internal;
+
+	/* In-memory trees have no backing file. */
+	if (F_ISSET(t, B_INMEM)) {
+		errno = ENOENT;
+		return (RET_ERROR);
+	}
+	mpool_wfilter(t->bt_mp, pgwrite, pgwcookie);
+	*psizep = t->bt_psize;
+	return (RET_SUCCESS);
+}
+
+/*
+ * __REC_MPSTAT -- return the memory pool statistics.
+ *
+ * Parameters:
+ *	dbp:	pointer to access method
+ *	sp:	statistics return
+ *
+ * Returns:
+ *	RET_SUCCESS
+ */
+int
+__rec_mpstat(dbp, sp)
+	const DB *dbp;
+	MPOOLSTAT *sp;
+{
+	BTREE *t;
+
+	t = dbp->internal;
+	mpool_getstat(t->bt_mp, sp);
+	return (RET_SUCCESS);
+}
@@ -222,7 +222,7 @@ __rec_iput(t, nrec, data, flags)
 
 	/* __rec_search pins the returned page. */
 	if ((e = __rec_search(t, nrec,
-	    nrec > t->bt_nrecs || flags == R_IAFTER || flags == R_IBEFORE ?
+	    nrec >= t->bt_nrecs || flags == R_IAFTER || flags == R_IBEFORE ?
 	    SINSERT : SEARCH)) == NULL)
 		return (RET_ERROR);
 
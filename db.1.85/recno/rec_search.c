@@ -39,10 +39,13 @@ static char sccsid[] = "@(#)rec_search.c	8.4 (Berkeley) 7/14/94";
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <db.h>
 #include "recno.h"
 
+static recno_t	*rec_sums __P((BTREE *, PAGE *));
+
 /*
  * __REC_SEARCH -- Search a btree for a key.
  *
@@ -71,8 +74,8 @@ __rec_search(t, recno, op)
 	EPGNO *parent;
 	RINTERNAL *r;
 	pgno_t pg;
-	indx_t top;
-	recno_t total;
+	indx_t hi, i, mid, top;
+	recno_t target, total, *sums;
 	int sverrno;
 
 	BT_CLR(t);
@@ -84,12 +87,31 @@ __rec_search(t, recno, op)
 			t->bt_cur.index = recno - total;
 			return (&t->bt_cur);
 		}
-		for (index = 0, top = NEXTINDEX(h);;) {
+		top = NEXTINDEX(h);
+		if ((sums = rec_sums(t, h)) != NULL) {
+			/*
+			 * Find the first entry whose running sum passes the
+			 * record, the last entry if none does.
+			 */
+			target = recno - total;
+			for (index = 0, hi = top - 1; index < hi;) {
+				mid = index + (hi - index) / 2;
+				if (sums[mid] > target)
+					hi = mid;
+				else
+					index = mid + 1;
+			}
+			if (index > 0)
+				total += sums[index - 1];
 			r = GETRINTERNAL(h, index);
-			if (++index == top || total + r->nrecs > recno)
-				break;
-			total += r->nrecs;
-		}
+			++index;
+		} else
+			for (index = 0;;) {
+				r = GETRINTERNAL(h, index);
+				if (++index == top || total + r->nrecs > recno)
+					break;
+				total += r->nrecs;
+			}
 
 		BT_PUSH(t, pg, index - 1);
 		
@@ -97,10 +119,16 @@ __rec_search(t, recno, op)
 		switch (op) {
 		case SDELETE:
 			--GETRINTERNAL(h, (index - 1))->nrecs;
+			if (sums != NULL)
+				for (i = index - 1; i < top; ++i)
+					--sums[i];
 			mpool_put(t->bt_mp, h, MPOOL_DIRTY);
 			break;
 		case SINSERT:
 			++GETRINTERNAL(h, (index - 1))->nrecs;
+			if (sums != NULL)
+				for (i = index - 1; i < top; ++i)
+					++sums[i];
 			mpool_put(t->bt_mp, h, MPOOL_DIRTY);
 			break;
 		case SEARCH:
@@ -111,7 +139,8 @@ __rec_search(t, recno, op)
 	}
 	/* Try and recover the tree. */
 err:	sverrno = errno;
-	if (op != SEARCH)
+	if (op != SEARCH) {
+		++t->bt_rgen;
 		while  ((parent = BT_POP(t)) != NULL) {
 			if ((h = mpool_get(t->bt_mp, parent->pgno, 0)) == NULL)
 				break;
@@ -121,6 +150,58 @@ err:	sverrno = errno;
 				++GETRINTERNAL(h, parent->index)->nrecs;
                         mpool_put(t->bt_mp, h, MPOOL_DIRTY);
                 }
+	}
 	errno = sverrno;
 	return (NULL);
 }
+
+/*
+ * REC_SUMS -- Return the running record counts of an internal page.
+ *
+ * Each entry of an internal page holds the number of records under it,
+ * so finding the entry holding a record means summing the counts of the
+ * entries in front of it.  The running sums of recently searched pages
+ * are kept, indexed by page number, and __rec_search adjusts them as it
+ * changes the counts, so that each level of a search is a binary search.
+ * A split rewrites internal pages, and bumps the tree's generation number
+ * to discard them.
+ *
+ * Parameters:
+ *	t:	tree
+ *	h:	internal page
+ *
+ * Returns:
+ *	The sums, or NULL if they couldn't be allocated.
+ */
+static recno_t *
+rec_sums(t, h)
+	BTREE *t;
+	PAGE *h;
+{
+	RCOUNT *rc;
+	indx_t i, top;
+	recno_t total, *p;
+
+	if (t->bt_rcnt == NULL &&
+	    (t->bt_rcnt = calloc(RC_NSLOTS, sizeof(RCOUNT))) == NULL)
+		return (NULL);
+	rc = &t->bt_rcnt[h->pgno % RC_NSLOTS];
+	top = NEXTINDEX(h);
+	if (rc->pgno == h->pgno && rc->gen == t->bt_rgen && rc->nent == top)
+		return (rc->sums);
+
+	rc->pgno = P_INVALID;
+	if (rc->size < top) {
+		if ((p = rc->sums == NULL ? malloc(top * sizeof(recno_t)) :
+		    realloc(rc->sums, top * sizeof(recno_t))) == NULL)
+			return (NULL);
+		rc->sums = p;
+		rc->size = top;
+	}
+	for (total = 0, i = 0; i < top; ++i)
+		rc->sums[i] = total += GETRINTERNAL(h, i)->nrecs;
+	rc->pgno = h->pgno;
+	rc->gen = t->bt_rgen;
+	rc->nent = top;
+	return (rc->sums);
+}
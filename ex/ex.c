@@ -2071,7 +2071,7 @@ ex_load(SCR *sp)
 {
 	WIN *wp;
 	EXCMD *ecp;
-	RANGE *rp;
+	db_recno_t lno;
 
 	F_CLR(sp, SC_EX_GLOBAL);
 
@@ -2108,16 +2108,8 @@ ex_load(SCR *sp)
 		 * the command on a different line.
 		 */
 		if (FL_ISSET(ecp->agv_flags, AGV_ALL)) {
-			/* Discard any exhausted ranges. */
-			while ((rp = ecp->rq.cqh_first) != (void *)&ecp->rq)
-				if (rp->start > rp->stop) {
-					CIRCLEQ_REMOVE(&ecp->rq, rp, q);
-					free(rp);
-				} else
-					break;
-
-			/* If there's another range, continue with it. */
-			if (rp != (void *)&ecp->rq)
+			/* If there's another line in the ranges, continue. */
+			if (!ex_g_next(ecp, &lno))
 				break;
 
 			/* If it's a global/v command, fix up the last line. */
@@ -2131,6 +2123,7 @@ ex_load(SCR *sp)
 					if (sp->lno == 0)
 						sp->lno = 1;
 				}
+			ex_g_free(ecp);
 			free(ecp->o_cp);
 		}
 
@@ -2148,7 +2141,7 @@ ex_load(SCR *sp)
 	ecp->cp = ecp->o_cp;
 	MEMCPYW(ecp->cp, ecp->cp + ecp->o_clen, ecp->o_clen);
 	ecp->clen = ecp->o_clen;
-	ecp->range_lno = sp->lno = rp->start++;
+	ecp->range_lno = sp->lno = lno;
 
 	if (FL_ISSET(ecp->agv_flags, AGV_GLOBAL | AGV_V))
 		F_SET(sp, SC_EX_GLOBAL);
@@ -2164,7 +2157,6 @@ ex_discard(SCR *sp)
 {
 	WIN *wp;
 	EXCMD *ecp;
-	RANGE *rp;
 
 	/*
 	 * We know the first command can't be an AGV command, so we don't
@@ -2172,10 +2164,7 @@ ex_discard(SCR *sp)
 	 */
 	for (wp = sp->wp; (ecp = wp->ecq.lh_first) != &wp->excmd;) {
 		if (FL_ISSET(ecp->agv_flags, AGV_ALL)) {
-			while ((rp = ecp->rq.cqh_first) != (void *)&ecp->rq) {
-				CIRCLEQ_REMOVE(&ecp->rq, rp, q);
-				free(rp);
-			}
+			ex_g_free(ecp);
 			free(ecp->o_cp);
 		}
 		LIST_REMOVE(ecp, q);
@@ -2222,6 +2211,22 @@ ex_is_abbrev(SCR *sp, CHAR_T *name, size_t len)
 	    (cp == &cmds[C_ABBR] || cp == &cmds[C_UNABBREVIATE]));
 }
 
+/*
+ * ex_is_tag -
+ *	The vi text input routine needs to know if ex thinks this is a
+ *	tag command, so it can complete tag names instead of file names.
+ *
+ * PUBLIC: int ex_is_tag __P((SCR *, CHAR_T *, size_t));
+ */
+int
+ex_is_tag(SCR *sp, CHAR_T *name, size_t len)
+{
+	EXCMDLIST const *cp;
+
+	return ((cp = ex_comm_search(sp, name, len)) != NULL &&
+	    cp == &cmds[C_TAG]);
+}
+
 /*
  * ex_is_unmap -
  *	The vi text input routine needs to know if ex thinks this is an
@@ -61,7 +61,11 @@ extern EXCMDLIST const cmds[];		/* Table of ex commands. */
 	}								\
 }
 
-/* Range structures for global and @ commands. */
+/*
+ * Range structures for global and @ commands.  Once lines have been added
+ * or deleted under a command, its ranges hold the line numbers the lines
+ * had when that started, see ex/ex_global.c:ex_g_insdel().
+ */
 typedef struct _range RANGE;
 struct _range {				/* Global command range. */
 	CIRCLEQ_ENTRY(_range) q;	/* Linked list of ranges. */
@@ -91,6 +95,10 @@ struct _excmd {
 
 	CIRCLEQ_HEAD(_rh, _range) rq;	/* @/global range: linked list. */
 	db_recno_t   range_lno;		/* @/global range: set line number. */
+	db_recno_t   r_cnt;		/* @/global range: tracked lines. */
+	db_recno_t  *r_lno;		/* @/global range: original lines. */
+	long	    *r_delta;		/* @/global range: line offset tree. */
+	db_recno_t  *r_next;		/* @/global range: next live line. */
 	CHAR_T	 *o_cp;			/* Original @/global command. */
 	size_t	  o_clen;		/* Original @/global command length. */
 #define	AGV_AT		0x01		/* @ buffer execution. */
@@ -152,8 +152,8 @@ EXCMDLIST const cmds[] = {
 /* C_DISPLAY */
 	{L("display"),	ex_display,	0,
 	    "w1r",
-	    "display b[uffers] | c[onnections] | s[creens] | t[ags]",
-	    "display buffers, connections, screens or tags"},
+	    "display b[uffers] | c[onnections] | f[ile] | s[creens] | t[ags]",
+	    "display buffers, connections, file page cache, screens or tags"},
 /* C_EDIT */
 	{L("edit"),	ex_edit,	E_NEWSCREEN,
 	    "f1o",
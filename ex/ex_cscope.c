@@ -95,7 +95,10 @@ static void	 csc_file __P((SCR *,
 		    CSC *, char *, char **, size_t *, int *));
 static int	 get_paths __P((SCR *, CSC *));
 static CC const	*lookup_ccmd __P((char *));
-static int	 parse __P((SCR *, CSC *, TAGQ *, int *));
+static int	 parse __P((SCR *, CSC *, CSR *, TAGQ *, int *));
+static CSR	*query __P((SCR *, CSC *, size_t, char *));
+static int	 read_lines __P((SCR *, CSC *, CSR *));
+static void	 result_free __P((CSC *, CSR *));
 static int	 read_prompt __P((SCR *, CSC *));
 static int	 run_cscope __P((SCR *, CSC *, char *));
 static int	 start_cscopes __P((SCR *, EXCMD *));
@@ -200,7 +203,7 @@ cscope_add(SCR *sp, EXCMD *cmdp, CHAR_T *dname)
 	struct stat sb;
 	EX_PRIVATE *exp;
 	CSC *csc;
-	size_t len;
+	size_t dblen, len;
 	int cur_argc;
 	char *dbname, path[MAXPATHLEN];
 	char *np;
@@ -258,11 +261,15 @@ cscope_add(SCR *sp, EXCMD *cmdp, CHAR_T *dname)
 
 	/* Allocate a cscope connection structure and initialize its fields. */
 	len = strlen(np);
-	CALLOC_RET(sp, csc, CSC *, 1, sizeof(CSC) + len);
+	dblen = len + strlen(dbname) + 2;
+	CALLOC_RET(sp, csc, CSC *, 1, sizeof(CSC) + len + dblen);
 	csc->dname = csc->buf;
 	csc->dlen = len;
 	memcpy(csc->dname, np, len);
-	csc->mtime = sb.st_mtime;
+	csc->dbpath = csc->dname + len + 1;
+	(void)snprintf(csc->dbpath, dblen, "%s/%s", np, dbname);
+	csc->mtime = csc->rmtime = sb.st_mtime;
+	CIRCLEQ_INIT(&csc->csrq);
 
 	/* Get the search paths for the cscope. */
 	if (get_paths(sp, csc))
@@ -434,6 +441,7 @@ static int
 cscope_find(SCR *sp, EXCMD *cmdp, CHAR_T *pattern)
 {
 	CSC *csc, *csc_next;
+	CSR *csr;
 	EX_PRIVATE *exp;
 	FREF *frp;
 	TAGQ *rtqp, *tqp;
@@ -492,16 +500,12 @@ cscope_find(SCR *sp, EXCMD *cmdp, CHAR_T *pattern)
 		csc_next = csc->q.le_next;
 
 		/*
-		 * Send the command to the cscope program.  (We skip the
-		 * first two bytes of the command, because we stored the
-		 * search cscope command character and a leading space
-		 * there.)
+		 * Get the query's output.  (We skip the first two bytes of
+		 * the command, because we stored the search cscope command
+		 * character and a leading space there.)
 		 */
-		(void)fprintf(csc->to_fp, "%d%s\n", search, tqp->tag + 2);
-		(void)fflush(csc->to_fp);
-
-		/* Read the output. */
-		if (parse(sp, csc, tqp, &matches)) {
+		if ((csr = query(sp, csc, search, tqp->tag + 2)) == NULL ||
+		    parse(sp, csc, csr, tqp, &matches)) {
 			if (rtqp != NULL)
 				free(rtqp);
 			tagq_free(sp, tqp);
@@ -647,17 +651,70 @@ usage:		(void)csc_help(sp, "find");
 }
 
 /*
- * parse --
- *	Parse the cscope output.
+ * query --
+ *	Return the output of a cscope query, from an earlier identical
+ *	query if the database hasn't changed since, from the cscope
+ *	process otherwise.
+ */
+static CSR *
+query(SCR *sp, CSC *csc, size_t search, char *pattern)
+{
+	struct stat sb;
+	CSR *csr;
+	size_t len;
+
+	/*
+	 * If the database has been rebuilt, the cscope process may or may
+	 * not be reading the new one, so discard everything and ask again.
+	 */
+	if (stat(csc->dbpath, &sb) == 0 && sb.st_mtime != csc->rmtime) {
+		while (csc->csrq.cqh_first != (void *)&csc->csrq)
+			result_free(csc, csc->csrq.cqh_first);
+		csc->rmtime = sb.st_mtime;
+	}
+	for (csr = csc->csrq.cqh_first;
+	    csr != (void *)&csc->csrq; csr = csr->q.cqe_next)
+		if (csr->search == search && !strcmp(csr->pattern, pattern)) {
+			CIRCLEQ_REMOVE(&csc->csrq, csr, q);
+			CIRCLEQ_INSERT_HEAD(&csc->csrq, csr, q);
+			return (csr);
+		}
+
+	len = strlen(pattern);
+	CALLOC(sp, csr, CSR *, 1, sizeof(CSR) + len);
+	if (csr == NULL)
+		return (NULL);
+	csr->search = search;
+	memcpy(csr->pattern, pattern, len + 1);
+
+	/* Send the command to the cscope program, and read the output. */
+	(void)fprintf(csc->to_fp, "%d%s\n", search, pattern);
+	(void)fflush(csc->to_fp);
+	if (read_lines(sp, csc, csr)) {
+		if (csr->lines != NULL)
+			free(csr->lines);
+		free(csr);
+		return (NULL);
+	}
+
+	/* Keep the most recent queries. */
+#define	CSCOPE_NRESULTS	32
+	CIRCLEQ_INSERT_HEAD(&csc->csrq, csr, q);
+	if (++csc->ncsr > CSCOPE_NRESULTS)
+		result_free(csc, csc->csrq.cqh_last);
+	return (csr);
+}
+
+/*
+ * read_lines --
+ *	Read the cscope output.
  */
 static int
-parse(SCR *sp, CSC *csc, TAGQ *tqp, int *matchesp)
+read_lines(SCR *sp, CSC *csc, CSR *csr)
 {
-	TAG *tp;
-	db_recno_t slno;
-	size_t dlen, nlen, slen;
-	int ch, i, isolder, nlines;
-	char *dname, *name, *search, *p, *t, dummy[2], buf[2048];
+	size_t blen, len;
+	int ch, nlines;
+	char *p, dummy[2], buf[2048];
 
 	for (;;) {
 		if (!fgets(buf, sizeof(buf), csc->from_fp))
@@ -677,7 +734,7 @@ parse(SCR *sp, CSC *csc, TAGQ *tqp, int *matchesp)
 		msgq(sp, M_ERR, "%s: \"%s\"", csc->dname, buf);
 	}
 
-	while (nlines--) {
+	for (blen = 0; nlines--;) {
 		if (fgets(buf, sizeof(buf), csc->from_fp) == NULL)
 			goto io_err;
 
@@ -688,6 +745,44 @@ parse(SCR *sp, CSC *csc, TAGQ *tqp, int *matchesp)
 		}
 		*p = '\0';
 
+		len = p - buf + 1;
+		BINC_RETC(sp, csr->lines, blen, csr->len + len);
+		memcpy(csr->lines + csr->len, buf, len);
+		csr->len += len;
+		++csr->nlines;
+	}
+
+	return read_prompt(sp, csc);
+
+io_err:	if (feof(csc->from_fp))
+		errno = EIO;
+	msgq_str(sp, M_SYSERR, "%s", csc->dname);
+	terminate(sp, csc, 0);
+	return (1);
+}
+
+/*
+ * parse --
+ *	Parse the cscope output.
+ */
+static int
+parse(SCR *sp, CSC *csc, CSR *csr, TAGQ *tqp, int *matchesp)
+{
+	TAG *tp;
+	db_recno_t slno;
+	size_t dlen, len, nlen, plen, slen;
+	int i, isolder, n;
+	char *dname, *lp, *name, *pname, *search, *p, *t, buf[2048];
+
+	dname = NULL;
+	dlen = 0;
+	isolder = 0;
+	for (pname = NULL, plen = 0,
+	    lp = csr->lines, n = csr->nlines; n--; lp += len + 1) {
+		/* The saved output is reused, parse a copy of the line. */
+		len = strlen(lp);
+		memcpy(buf, lp, len + 1);
+
 		/*
 		 * The cscope output is in the following format:
 		 *
@@ -716,8 +811,16 @@ parse(SCR *sp, CSC *csc, TAGQ *tqp, int *matchesp)
 		search = p;
 		slen = strlen(p);
 
-		/* Resolve the file name. */
-		csc_file(sp, csc, name, &dname, &dlen, &isolder);
+		/*
+		 * Resolve the file name.  The output is grouped by file, so
+		 * only look again when the name changes.
+		 */
+		if (pname == NULL || plen != nlen || memcmp(pname, name, nlen)) {
+			isolder = 0;
+			csc_file(sp, csc, name, &dname, &dlen, &isolder);
+			pname = lp;
+			plen = nlen;
+		}
 
 		/*
 		 * If the file is older than the cscope database, that is,
@@ -739,10 +842,9 @@ parse(SCR *sp, CSC *csc, TAGQ *tqp, int *matchesp)
 		if (dlen != 0) {
 			memcpy(tp->fname, dname, dlen);
 			tp->fname[dlen] = '/';
-			++dlen;
 		}
-		memcpy(tp->fname + dlen, name, nlen + 1);
-		tp->fnlen = dlen + nlen;
+		memcpy(tp->fname + dlen + (dlen != 0), name, nlen + 1);
+		tp->fnlen = dlen + (dlen != 0) + nlen;
 		tp->slno = slno;
 		if (slen != 0) {
 			tp->search = (CHAR_T*)(tp->fname + tp->fnlen + 1);
@@ -752,14 +854,21 @@ parse(SCR *sp, CSC *csc, TAGQ *tqp, int *matchesp)
 
 		++*matchesp;
 	}
+	return (0);
+}
 
-	return read_prompt(sp, csc);
-
-io_err:	if (feof(csc->from_fp))
-		errno = EIO;
-	msgq_str(sp, M_SYSERR, "%s", csc->dname);
-	terminate(sp, csc, 0);
-	return (1);
+/*
+ * result_free --
+ *	Discard a query's output.
+ */
+static void
+result_free(CSC *csc, CSR *csr)
+{
+	CIRCLEQ_REMOVE(&csc->csrq, csr, q);
+	--csc->ncsr;
+	if (csr->lines != NULL)
+		free(csr->lines);
+	free(csr);
 }
 
 /*
@@ -891,6 +1000,8 @@ badno:			msgq(sp, M_ERR, "312|%d: no such cscope session", n);
 
 	/* Discard cscope connection information. */
 	LIST_REMOVE(csc, q);
+	while (csc->csrq.cqh_first != (void *)&csc->csrq)
+		result_free(csc, csc->csrq.cqh_first);
 	if (csc->pbuf != NULL)
 		free(csc->pbuf);
 	if (csc->paths != NULL)
@@ -30,9 +30,10 @@ static int	bdisplay __P((SCR *));
 static void	db __P((SCR *, CB *, u_char *));
 
 /*
- * ex_display -- :display b[uffers] | c[onnections] | s[creens] | t[ags]
+ * ex_display -- :display b[uffers] | c[onnections] | f[ile] | s[creens] | t[ags]
  *
- *	Display cscope connections, buffers, tags or screens.
+ *	Display cscope connections, buffers, page cache statistics for
+ *	the file, tags or screens.
  *
  * PUBLIC: int ex_display __P((SCR *, EXCMD *));
  */
@@ -52,6 +53,10 @@ ex_display(SCR *sp, EXCMD *cmdp)
 		if (!is_prefix(arg, L("connections")))
 			break;
 		return (cscope_display(sp));
+	case L('f'):
+		if (!is_prefix(arg, L("file")))
+			break;
+		return (db_pdisplay(sp));
 	case L('s'):
 		if (!is_prefix(arg, L("screens")))
 			break;
@@ -15,11 +15,16 @@ static const char sccsid[] = "$Id: ex_filter.c,v 10.44 2003/11/05 17:11:54 skimo
 
 #include <sys/types.h>
 #include <sys/queue.h>
+#ifdef HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
+#include <sys/time.h>
 
 #include <bitstring.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,7 +32,21 @@ static const char sccsid[] = "$Id: ex_filter.c,v 10.44 2003/11/05 17:11:54 skimo
 
 #include "../common/common.h"
 
-static int filter_ldisplay __P((SCR *, FILE *));
+/*
+ * The lines written to a utility are copied into a buffer of about this
+ * size, a block of lines at a time, and handed to write(2), not a line at
+ * a time through stdio.  Filters that move more than FILTER_BUSYSIZE bytes
+ * put up a busy message.
+ */
+#define	FILTER_BUFSIZE	(64 * 1024)	/* Write buffer size. */
+#define	FILTER_BLKLINES	(10 * INTERRUPT_CHECK)	/* Most lines per block. */
+#define	FILTER_BUSYSIZE	(1024 * 1024)	/* Bytes before a busy message. */
+
+static int filter_fill __P((SCR *,
+    db_recno_t *, db_recno_t, char **, size_t *, size_t *));
+static int filter_ldisplay __P((SCR *, CHAR_T *, size_t));
+static int filter_run __P((SCR *,
+    int, FILE *, MARK *, MARK *, enum filtertype, db_recno_t *));
 
 /*
  * ex_filter --
@@ -41,8 +60,8 @@ static int filter_ldisplay __P((SCR *, FILE *));
 int
 ex_filter(SCR *sp, EXCMD *cmdp, MARK *fm, MARK *tm, MARK *rp, CHAR_T *cmd, enum filtertype ftype)
 {
-	FILE *ifp, *ofp;
-	pid_t parent_writer_pid, utility_pid;
+	FILE *ofp;
+	pid_t utility_pid;
 	db_recno_t nread;
 	int input[2], output[2], rval;
 	char *name;
@@ -61,15 +80,13 @@ ex_filter(SCR *sp, EXCMD *cmdp, MARK *fm, MARK *tm, MARK *rp, CHAR_T *cmd, enum
 		return (1);
 
 	/*
-	 * There are three different processes running through this code.
-	 * They are the utility, the parent-writer and the parent-reader.
-	 * The parent-writer is the process that writes from the file to
-	 * the utility, the parent reader is the process that reads from
-	 * the utility.
+	 * There are two different processes running through this code.
+	 * They are the utility and the parent, which both writes from the
+	 * file to the utility and reads from the utility.
 	 *
 	 * Input and output are named from the utility's point of view.
-	 * The utility reads from input[0] and the parent(s) write to
-	 * input[1].  The parent(s) read from output[0] and the utility
+	 * The utility reads from input[0] and the parent writes to
+	 * input[1].  The parent reads from output[0] and the utility
 	 * writes to output[1].
 	 *
 	 * !!!
@@ -143,8 +160,8 @@ err:		if (input[0] != -1)
 		msgq_str(sp, M_SYSERR, O_STR(sp, O_SHELL), "execl: %s");
 		_exit (127);
 		/* NOTREACHED */
-	default:			/* Parent-reader, parent-writer. */
-		/* Close the pipe ends neither parent will use. */
+	default:			/* Parent. */
+		/* Close the pipe ends the parent won't use. */
 		if (input[0] != -1)
 			(void)close(input[0]);
 		(void)close(output[1]);
@@ -154,8 +171,8 @@ err:		if (input[0] != -1)
 	/*
 	 * FILTER_RBANG, FILTER_READ:
 	 *
-	 * Reading is the simple case -- we don't need a parent writer,
-	 * so the parent reads the output from the read end of the output
+	 * Reading is the simple case -- there's nothing to write, so
+	 * the parent reads the output from the read end of the output
 	 * pipe until it finishes, then waits for the child.  Ex_readfp
 	 * appends to the MARK, and closes ofp.
 	 *
@@ -188,95 +205,38 @@ err:		if (input[0] != -1)
 	/*
 	 * FILTER_BANG, FILTER_WRITE
 	 *
-	 * Here we need both a reader and a writer.  Temporary files are
-	 * expensive and we'd like to avoid disk I/O.  Using pipes has the
-	 * obvious starvation conditions.  It's done as follows:
+	 * Here we both write to and read from the utility.  Temporary files
+	 * are expensive and we'd like to avoid disk I/O.  Using pipes has the
+	 * obvious starvation conditions, so both pipes are made nonblocking,
+	 * and this process feeds the lines to the utility and reads back its
+	 * output, as each pipe is ready, see filter_run().
 	 *
-	 *	fork
-	 *	child
-	 *		write lines out
-	 *		exit
-	 *	parent
-	 *		FILTER_BANG:
-	 *			read lines into the file
-	 *			delete old lines
-	 *		FILTER_WRITE
-	 *			read and display lines
-	 *		wait for child
+	 *	FILTER_BANG:
+	 *		read lines into the file after the range
+	 *		delete old lines
+	 *	FILTER_WRITE
+	 *		read and display lines
+	 *	wait for the utility
 	 *
-	 * XXX
-	 * We get away without locking the underlying database because we know
-	 * that none of the records that we're reading will be modified until
-	 * after we've read them.  This depends on the fact that the current
-	 * B+tree implementation doesn't balance pages or similar things when
-	 * it inserts new records.  When the DB code has locking, we should
-	 * treat vi as if it were multiple applications sharing a database, and
-	 * do the required locking.  If necessary a work-around would be to do
-	 * explicit locking in the line.c:db_get() code, based on the flag set
-	 * here.
+	 * The output is appended after the range, so the lines being written
+	 * keep their line numbers while it's read in.
 	 */
-	F_SET(sp->ep, F_MULTILOCK);
-	switch (parent_writer_pid = fork()) {
-	case -1:			/* Error. */
-		msgq(sp, M_SYSERR, "fork");
-		(void)close(input[1]);
-		(void)close(output[0]);
+	if (filter_run(sp, input[1], ofp, fm, tm, ftype, &nread))
 		rval = 1;
-		break;
-	case 0:				/* Parent-writer. */
-		/*
-		 * Write the selected lines to the write end of the input
-		 * pipe.  This instance of ifp is closed by ex_writefp.
-		 */
-		(void)close(output[0]);
-		if ((ifp = fdopen(input[1], "w")) == NULL)
-			_exit (1);
-		_exit(ex_writefp(sp, "filter", ifp, fm, tm, NULL, NULL, 1));
-
-		/* NOTREACHED */
-	default:			/* Parent-reader. */
-		(void)close(input[1]);
-		if (ftype == FILTER_WRITE) {
-			/*
-			 * Read the output from the read end of the output
-			 * pipe and display it.  Filter_ldisplay closes ofp.
-			 */
-			if (filter_ldisplay(sp, ofp))
-				rval = 1;
-		} else {
-			/*
-			 * Read the output from the read end of the output
-			 * pipe.  Ex_readfp appends to the MARK and closes
-			 * ofp.
-			 */
-			if (ex_readfp(sp, "filter", ofp, tm, &nread, 1))
-				rval = 1;
-			sp->rptlines[L_ADDED] += nread;
-		}
-
-		/* Wait for the parent-writer. */
-		if (proc_wait(sp,
-		    (long)parent_writer_pid, "parent-writer", 0, 1))
-			rval = 1;
+	else if (ftype == FILTER_BANG) {
+		sp->rptlines[L_ADDED] += nread;
 
 		/* Delete any lines written to the utility. */
-		if (rval == 0 && ftype == FILTER_BANG &&
-		    (cut(sp, NULL, fm, tm, CUT_LINEMODE) ||
-		    del(sp, fm, tm, 1))) {
+		if (cut(sp, NULL, fm, tm, CUT_LINEMODE) || del(sp, fm, tm, 1))
 			rval = 1;
-			break;
-		}
-
-		/*
-		 * If the filter had no output, we may have just deleted
-		 * the cursor.  Don't do any real error correction, we'll
-		 * try and recover later.
-		 */
-		 if (rp->lno > 1 && !db_exist(sp, rp->lno))
-			--rp->lno;
-		break;
 	}
-	F_CLR(sp->ep, F_MULTILOCK);
+
+	/*
+	 * If the filter had no output, we may have just deleted the cursor.
+	 * Don't do any real error correction, we'll try and recover later.
+	 */
+	if (rp->lno > 1 && !db_exist(sp, rp->lno))
+		--rp->lno;
 
 	/*
 	 * !!!
@@ -285,7 +245,209 @@ err:		if (input[0] != -1)
 	 */
 uwait:	INT2CHAR(sp, cmd, STRLEN(cmd) + 1, np, nlen);
 	return (proc_wait(sp, (long)utility_pid, np,
-	    ftype == FILTER_READ && F_ISSET(sp, SC_VI) ? 1 : 0, 0) || rval);
+	    ftype == FILTER_READ && F_ISSET(sp, SC_VI) ? 1 : 0,
+	    ftype == FILTER_BANG || ftype == FILTER_WRITE) || rval);
+}
+
+/*
+ * filter_run --
+ *	Write a range of lines to the utility, and read back its output,
+ *	appending it to the file after the range for FILTER_BANG, and
+ *	displaying it for FILTER_WRITE.  Return the number of lines read
+ *	into the file in *nreadp.  Closes the descriptor and the FILE.
+ *
+ * The lines are copied to the utility, and its output is read back, in
+ * large blocks, as select(2) finds each pipe ready; everything happens in
+ * this process.  If the filter is interrupted, or fails, the lines read
+ * so far are deleted, and the range is left alone.
+ */
+static int
+filter_run(SCR *sp, int ifd, FILE *ofp, MARK *fm, MARK *tm,
+    enum filtertype ftype, db_recno_t *nreadp)
+{
+	struct sigaction act, oact;
+	struct timeval tv;
+	fd_set rdfd, wrfd;
+	EX_PRIVATE *exp;
+	GS *gp;
+	db_recno_t lno, n, wlno;
+	size_t blen, boff, bsize, moved, off, rlen, wlen;
+	ssize_t nw;
+	int eof, maxfd, ofd, rval;
+	char *bp, *msg;
+	CHAR_T *wp;
+
+	gp = sp->gp;
+	exp = EXP(sp);
+	*nreadp = 0;
+
+	/*
+	 * If the utility exits before reading all of its input, the write
+	 * fails with EPIPE; don't let the SIGPIPE kill us.
+	 */
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = SIG_IGN;
+	(void)sigemptyset(&act.sa_mask);
+	(void)sigaction(SIGPIPE, &act, &oact);
+
+	bp = NULL;
+	bsize = boff = blen = 0;
+	off = rlen = 0;
+	ofd = fileno(ofp);
+	msg = "325|Filtering...";
+	if (fcntl(ifd, F_SETFL, fcntl(ifd, F_GETFL, 0) | O_NONBLOCK) == -1 ||
+	    fcntl(ofd, F_SETFL, fcntl(ofd, F_GETFL, 0) | O_NONBLOCK) == -1) {
+		msgq(sp, M_SYSERR, "fcntl");
+		goto err;
+	}
+
+	for (lno = tm->lno, wlno = fm->lno, moved = 0, eof = 0; !eof;) {
+		/* Caller has to provide any interrupt message. */
+		if (INTERRUPTED(sp))
+			goto err;
+		if (moved >= FILTER_BUSYSIZE) {
+			gp->scr_busy(sp, msg, msg == NULL ? BUSY_UPDATE : BUSY_ON);
+			msg = NULL;
+		}
+
+		/*
+		 * Refill the write buffer once the utility has taken all of
+		 * it, and close its input once it has taken all of the lines.
+		 */
+		if (ifd != -1 && boff == blen) {
+			if (tm->lno == 0 || wlno > tm->lno) {
+				(void)close(ifd);
+				ifd = -1;
+			} else if (filter_fill(sp,
+			    &wlno, tm->lno, &bp, &bsize, &blen))
+				goto err;
+			boff = 0;
+		}
+
+		FD_ZERO(&rdfd);
+		FD_ZERO(&wrfd);
+		FD_SET(ofd, &rdfd);
+		maxfd = ofd;
+		if (ifd != -1) {
+			FD_SET(ifd, &wrfd);
+			if (ifd > maxfd)
+				maxfd = ifd;
+		}
+
+		/* Wake up once a second to check for interrupts. */
+		tv.tv_sec = 1;
+		tv.tv_usec = 0;
+		switch (select(maxfd + 1, &rdfd, &wrfd, NULL, &tv)) {
+		case -1:
+			if (errno == EINTR)
+				continue;
+			msgq(sp, M_SYSERR, "select");
+			goto err;
+		case 0:
+			continue;
+		}
+
+		if (ifd != -1 && FD_ISSET(ifd, &wrfd)) {
+			if ((nw = write(ifd, bp + boff, blen - boff)) >= 0) {
+				boff += nw;
+				moved += nw;
+			} else if (errno == EPIPE) {
+				/* The utility stopped reading. */
+				(void)close(ifd);
+				ifd = -1;
+			} else if (errno != EAGAIN && errno != EINTR) {
+				msgq(sp, M_SYSERR, "filter write");
+				goto err;
+			}
+		}
+
+		if (FD_ISSET(ofd, &rdfd)) {
+			if (ex_readblk(sp, ofd, &off, &rlen, &eof)) {
+				msgq(sp, M_SYSERR, "filter read");
+				goto err;
+			}
+			if (rlen == 0)
+				continue;
+			moved += rlen;
+			FILE2INT5(sp, exp->ibcw, exp->ibp, rlen, wp, wlen);
+			if (ftype == FILTER_WRITE) {
+				if (filter_ldisplay(sp, wp, wlen))
+					goto err;
+			} else {
+				if (db_append_block(sp, lno, wp, wlen, &n))
+					goto err;
+				lno += n;
+				*nreadp += n;
+			}
+		}
+	}
+
+	/*
+	 * An interrupt may have killed the utility, which looks just like the
+	 * end of its output.
+	 */
+	if (INTERRUPTED(sp)) {
+err:		rval = 1;
+
+		/* Put the range back the way it was. */
+		if (*nreadp != 0)
+			(void)db_delete_block(sp, tm->lno + 1, *nreadp);
+		*nreadp = 0;
+	} else
+		rval = 0;
+
+	if (ifd != -1)
+		(void)close(ifd);
+	(void)fclose(ofp);
+	if (bp != NULL)
+		free(bp);
+	(void)sigaction(SIGPIPE, &oact, NULL);
+	if (msg == NULL)
+		gp->scr_busy(sp, NULL, BUSY_OFF);
+	return (rval);
+}
+
+/*
+ * filter_fill --
+ *	Copy lines, starting at *lnop and ending no later than tline, into
+ *	the write buffer, until it holds at least FILTER_BUFSIZE bytes.
+ *	Return the number of bytes copied in *lenp.
+ */
+static int
+filter_fill(SCR *sp, db_recno_t *lnop, db_recno_t tline,
+    char **bpp, size_t *bsizep, size_t *lenp)
+{
+	db_recno_t lno, n;
+	size_t flen, len, tlen;
+	CHAR_T *p;
+	char *f;
+
+	for (lno = *lnop, tlen = 0;
+	    lno <= tline && tlen < FILTER_BUFSIZE; lno += n) {
+		/*
+		 * Copy a block of lines from where it's stored, if the lines
+		 * are stored that way, else copy the line.
+		 */
+		n = tline - lno + 1;
+		if (n > FILTER_BLKLINES)
+			n = FILTER_BLKLINES;
+		if (!db_block(sp, lno, FORWARD, &p, &len, &n)) {
+			f = (char *)p;
+			flen = len;
+		} else {
+			n = 1;
+			if (db_get(sp, lno, DBG_FATAL, &p, &len))
+				return (1);
+			INT2FILE(sp, p, len, f, flen);
+		}
+		BINC_RETC(sp, *bpp, *bsizep, tlen + flen + 1);
+		memcpy(*bpp + tlen, f, flen);
+		tlen += flen;
+		(*bpp)[tlen++] = '\n';
+	}
+	*lnop = lno;
+	*lenp = tlen;
+	return (0);
 }
 
 /*
@@ -297,21 +459,15 @@ uwait:	INT2CHAR(sp, cmd, STRLEN(cmd) + 1, np, nlen);
  * We use the ex print routines to make sure they're printable.
  */
 static int
-filter_ldisplay(SCR *sp, FILE *fp)
+filter_ldisplay(SCR *sp, CHAR_T *p, size_t len)
 {
-	size_t len;
-	size_t wlen;
-	CHAR_T *wp;
-
-	EX_PRIVATE *exp;
+	CHAR_T *ep, *t;
 
-	for (exp = EXP(sp); !ex_getline(sp, fp, &len) && !INTERRUPTED(sp);) {
-		FILE2INT5(sp, exp->ibcw, exp->ibp, len, wp, wlen);
-		if (ex_ldisplay(sp, wp, wlen, 0, 0))
-			break;
+	for (ep = p + len; p < ep; p = t + 1) {
+		if ((t = MEMCHR(p, '\n', ep - p)) == NULL)
+			t = ep;
+		if (ex_ldisplay(sp, p, t - p, 0, 0))
+			return (1);
 	}
-	if (ferror(fp))
-		msgq(sp, M_SYSERR, "filter read");
-	(void)fclose(fp);
 	return (0);
 }
@@ -29,7 +29,29 @@ static const char sccsid[] = "$Id: ex_global.c,v 10.30 2001/06/25 15:19:16 skimo
 
 enum which {GLOBAL, V};
 
-static int ex_g_setup __P((SCR *, EXCMD *, enum which));
+/*
+ * The lines to be matched are handed out in chunks, one to each thread;
+ * each thread matches its chunk with its own copy of the RE, because the
+ * RE engine caches state in the compiled RE.
+ */
+#define	GLOBAL_CHUNK	4096		/* Lines matched by a thread at once. */
+typedef struct _gmatch {
+	regex_t	 re;			/* The thread's copy of the RE. */
+	regex_t	*rep;			/* The RE to use. */
+	CHAR_T	*bp;			/* Line text. */
+	size_t	 blen;			/* Line text buffer length. */
+	size_t	 off[GLOBAL_CHUNK + 1];	/* Line offsets. */
+	int	 eval[GLOBAL_CHUNK];	/* Per-line regexec(3) results. */
+	db_recno_t nlines;		/* Number of lines. */
+} GMATCH;
+
+static void	 ex_g_add __P((EXCMD *, db_recno_t, long));
+static int	 ex_g_index __P((SCR *, EXCMD *));
+static db_recno_t ex_g_live __P((EXCMD *, db_recno_t));
+static void	*ex_g_match __P((void *));
+static int	 ex_g_range __P((SCR *, EXCMD *, db_recno_t));
+static int	 ex_g_setup __P((SCR *, EXCMD *, enum which));
+static long	 ex_g_sum __P((EXCMD *, db_recno_t));
 
 /*
  * ex_global -- [line [,line]] g[lobal][!] /pattern/ [commands]
@@ -65,14 +87,14 @@ ex_g_setup(SCR *sp, EXCMD *cmdp, enum which cmd)
 {
 	CHAR_T *ptrn, *p, *t;
 	EXCMD *ecp;
+	GMATCH *gm, *gms;
 	MARK abs;
-	RANGE *rp;
 	busy_t btype;
-	db_recno_t start, end;
-	regex_t *re;
 	regmatch_t match[1];
+	db_recno_t lno, start, end;
 	size_t len;
-	int cnt, delim, eval;
+	int delim, eval, i, nt, rval;
+	void **gmp;
 	CHAR_T *dbp;
 
 	NEEDFILE(sp, cmdp);
@@ -148,7 +170,6 @@ usage:		ex_emsg(sp, cmdp->cmd->usage, EXM_USAGE);
 		 */
 		sp->searchdir = FORWARD;
 	}
-	re = &sp->re_c;
 
 	/* The global commands always set the previous context mark. */
 	abs.lno = sp->lno;
@@ -191,57 +212,250 @@ usage:		ex_emsg(sp, cmdp->cmd->usage, EXM_USAGE);
 	 * each ex command.  There's a callback routine which the DB interface
 	 * routines call when a line is created or deleted.  This doesn't help
 	 * the layering much.
+	 *
+	 * The lines are matched by as many threads as the system has to offer,
+	 * a chunk of lines to each thread at a time.  The first thread uses
+	 * the screen's RE, the others compile their own copies of it.  Small
+	 * ranges don't need all of the threads, and a single thread matches
+	 * the lines in place, without copying them.
 	 */
+	nt = sp->gp->nthreads;
+	if (nt > (cmdp->addr2.lno - cmdp->addr1.lno) / GLOBAL_CHUNK + 1)
+		nt = (cmdp->addr2.lno - cmdp->addr1.lno) / GLOBAL_CHUNK + 1;
+	CALLOC_RET(sp, gms, GMATCH *, nt, sizeof(GMATCH));
+	CALLOC(sp, gmp, void **, nt, sizeof(void *));
+	if (gmp == NULL) {
+		free(gms);
+		return (1);
+	}
+	rval = 1;
+	gms[0].rep = &sp->re_c;
+	for (i = 1; i < nt; ++i) {
+		if (re_compile(sp, sp->re, sp->re_len,
+		    NULL, NULL, &gms[i].re, SEARCH_MSG))
+			goto err;
+		gms[i].rep = &gms[i].re;
+	}
+
 	btype = BUSY_ON;
-	cnt = INTERRUPT_CHECK;
 	for (start = cmdp->addr1.lno,
-	    end = cmdp->addr2.lno; start <= end; ++start) {
-		if (cnt-- == 0) {
-			if (INTERRUPTED(sp)) {
-				LIST_REMOVE(ecp, q);
-				free(ecp->cp);
-				free(ecp);
-				break;
-			}
-			search_busy(sp, btype);
-			btype = BUSY_UPDATE;
-			cnt = INTERRUPT_CHECK;
-		}
-		if (db_get(sp, start, DBG_FATAL, &dbp, &len))
-			return (1);
-		match[0].rm_so = 0;
-		match[0].rm_eo = len;
-		switch (eval =
-		    regexec(&sp->re_c, dbp, 0, match, REG_STARTEND)) {
-		case 0:
-			if (cmd == V)
-				continue;
-			break;
-		case REG_NOMATCH:
-			if (cmd == GLOBAL)
-				continue;
-			break;
-		default:
-			re_error(sp, eval, &sp->re_c);
+	    end = cmdp->addr2.lno; start <= end;) {
+		if (INTERRUPTED(sp)) {
+			LIST_REMOVE(ecp, q);
+			ex_g_free(ecp);
+			free(ecp->cp);
+			free(ecp);
 			break;
 		}
+		search_busy(sp, btype);
+		btype = BUSY_UPDATE;
 
-		/* If follows the last entry, extend the last entry's range. */
-		if ((rp = ecp->rq.cqh_last) != (void *)&ecp->rq &&
-		    rp->stop == start - 1) {
-			++rp->stop;
-			continue;
+		/* Copy out a chunk of lines for each thread, and match them. */
+		for (lno = start, i = 0; i < nt && lno <= end; ++i) {
+			gm = gmp[i] = &gms[i];
+			for (gm->nlines = 0;
+			    gm->nlines < GLOBAL_CHUNK && lno <= end;
+			    ++gm->nlines, ++lno) {
+				if (db_get(sp, lno, DBG_FATAL, &dbp, &len))
+					goto err;
+				if (nt == 1) {
+					match[0].rm_so = 0;
+					match[0].rm_eo = len;
+					gm->eval[gm->nlines] = regexec(gm->rep,
+					    dbp, 0, match, REG_STARTEND);
+					continue;
+				}
+				BINC_GOTOW(sp, gm->bp, gm->blen,
+				    gm->off[gm->nlines] + len);
+				MEMCPYW(gm->bp + gm->off[gm->nlines], dbp, len);
+				gm->off[gm->nlines + 1] =
+				    gm->off[gm->nlines] + len;
+			}
 		}
+		if (nt > 1)
+			(void)sp->gp->run_wait(sp->wp, ex_g_match, gmp, i);
 
-		/* Allocate a new range, and append it to the list. */
-		CALLOC(sp, rp, RANGE *, 1, sizeof(RANGE));
-		if (rp == NULL)
-			return (1);
-		rp->start = rp->stop = start;
-		CIRCLEQ_INSERT_TAIL(&ecp->rq, rp, q);
+		/* Add the selected lines to the list, in order. */
+		for (gm = gms; gm < gms + i; ++gm)
+			for (lno = 0; lno < gm->nlines; ++lno, ++start) {
+				switch (eval = gm->eval[lno]) {
+				case 0:
+					if (cmd == V)
+						continue;
+					break;
+				case REG_NOMATCH:
+					if (cmd == GLOBAL)
+						continue;
+					break;
+				default:
+					re_error(sp, eval, gm->rep);
+					break;
+				}
+				if (ex_g_range(sp, ecp, start))
+					goto err;
+			}
 	}
 	search_busy(sp, BUSY_OFF);
+	rval = 0;
+
+alloc_err:
+err:	for (i = 0; i < nt; ++i) {
+		if (gms[i].rep == &gms[i].re)
+			regfree(&gms[i].re);
+		if (gms[i].bp != NULL)
+			free(gms[i].bp);
+	}
+	free(gms);
+	free(gmp);
+	return (rval);
+}
+
+/*
+ * ex_g_match --
+ *	Match a chunk of lines, in a thread of its own.
+ */
+static void *
+ex_g_match(void *arg)
+{
+	GMATCH *gm;
+	regmatch_t match[1];
+	db_recno_t cnt;
+
+	gm = arg;
+	for (cnt = 0; cnt < gm->nlines; ++cnt) {
+		match[0].rm_so = 0;
+		match[0].rm_eo = gm->off[cnt + 1] - gm->off[cnt];
+		gm->eval[cnt] = regexec(gm->rep,
+		    gm->bp + gm->off[cnt], 0, match, REG_STARTEND);
+	}
+	return (NULL);
+}
+
+/*
+ * ex_g_range --
+ *	Add a line to the list of lines passed to the command.
+ */
+static int
+ex_g_range(SCR *sp, EXCMD *ecp, db_recno_t lno)
+{
+	RANGE *rp;
+
+	/* If follows the last entry, extend the last entry's range. */
+	if ((rp = ecp->rq.cqh_last) != (void *)&ecp->rq &&
+	    rp->stop == lno - 1) {
+		++rp->stop;
+		return (0);
+	}
+
+	/* Allocate a new range, and append it to the list. */
+	CALLOC_RET(sp, rp, RANGE *, 1, sizeof(RANGE));
+	rp->start = rp->stop = lno;
+	CIRCLEQ_INSERT_TAIL(&ecp->rq, rp, q);
+	return (0);
+}
+
+/*
+ * The ranges of a global or @ command are adjusted for each line added or
+ * deleted by the command, and in a large file there may be thousands of
+ * them.  Rather than renumbering every range after the change each time,
+ * the first change indexes the lines in the ranges, and turns the ranges
+ * into ranges of the index: each tracked line's current line number is
+ * its original line number plus the sum of the offsets in a Fenwick tree
+ * at or before it.  Adding or deleting a line adds one offset, so it's
+ * O(log N) in the number of tracked lines, however many ranges there are,
+ * and the index is only as large as the lines in the ranges, not the
+ * lines they're spread over.  Deleted lines are skipped over when the
+ * command moves on to the next line; r_next is a union-find of the next
+ * live line, so the skipping is cheap as well.
+ *
+ * Deleting a tracked line adds its -1 after it, not at it, so a deleted
+ * line never has a greater current line number than the tracked line
+ * after it, and current line numbers never decrease through the index.
+ */
+#define	R_CUR(ecp, i)							\
+	((long)(ecp)->r_lno[i] + ex_g_sum(ecp, i))
+
+/*
+ * ex_g_sum --
+ *	Return the sum of the offsets up to a tracked line.
+ */
+static long
+ex_g_sum(EXCMD *ecp, db_recno_t i)
+{
+	long sum;
+
+	for (sum = 0; i > 0; i &= i - 1)
+		sum += ecp->r_delta[i];
+	return (sum);
+}
+
+/*
+ * ex_g_add --
+ *	Move a tracked line, and all of the lines after it.
+ */
+static void
+ex_g_add(EXCMD *ecp, db_recno_t i, long delta)
+{
+	for (; i <= ecp->r_cnt; i += i & -i)
+		ecp->r_delta[i] += delta;
+}
+
+/*
+ * ex_g_live --
+ *	Return the first tracked line at or after a line that hasn't been
+ *	deleted, or r_cnt + 1.
+ */
+static db_recno_t
+ex_g_live(EXCMD *ecp, db_recno_t i)
+{
+	db_recno_t *np;
+
+	for (np = ecp->r_next; np[i] != i; i = np[i])
+		np[i] = np[np[i]];
+	return (i);
+}
+
+/*
+ * ex_g_index --
+ *	Start tracking the lines in the ranges of a command.
+ */
+static int
+ex_g_index(SCR *sp, EXCMD *ecp)
+{
+	RANGE *rp;
+	db_recno_t i, lno;
+
+	for (ecp->r_cnt = 0, rp = ecp->rq.cqh_first;
+	    rp != (void *)&ecp->rq; rp = rp->q.cqe_next)
+		ecp->r_cnt += rp->stop - rp->start + 1;
+	CALLOC_RET(sp, ecp->r_delta, long *, ecp->r_cnt + 1, sizeof(long));
+	MALLOC_GOTO(sp, ecp->r_next,
+	    db_recno_t *, (ecp->r_cnt + 2) * sizeof(db_recno_t));
+	MALLOC_GOTO(sp, ecp->r_lno,
+	    db_recno_t *, (ecp->r_cnt + 1) * sizeof(db_recno_t));
+	for (i = 0; i <= ecp->r_cnt + 1; ++i)
+		ecp->r_next[i] = i;
+
+	/* Number the lines, and renumber the ranges to match. */
+	for (i = 1, rp = ecp->rq.cqh_first;
+	    rp != (void *)&ecp->rq; rp = rp->q.cqe_next) {
+		for (lno = rp->start, rp->start = i; lno <= rp->stop; ++lno)
+			ecp->r_lno[i++] = lno;
+		rp->stop = i - 1;
+	}
 	return (0);
+
+alloc_err:
+	msgq(sp, M_SYSERR, NULL);
+	free(ecp->r_delta);
+	if (ecp->r_next != NULL)
+		free(ecp->r_next);
+	if (ecp->r_lno != NULL)
+		free(ecp->r_lno);
+	ecp->r_delta = NULL;
+	ecp->r_next = NULL;
+	ecp->r_lno = NULL;
+	return (1);
 }
 
 /*
@@ -254,7 +468,8 @@ int
 ex_g_insdel(SCR *sp, lnop_t op, db_recno_t lno)
 {
 	EXCMD *ecp;
-	RANGE *nrp, *rp;
+	db_recno_t i, k, step;
+	long sum;
 
 	/* All insert/append operations are done as inserts. */
 	if (op == LINE_APPEND)
@@ -266,54 +481,105 @@ ex_g_insdel(SCR *sp, lnop_t op, db_recno_t lno)
 	for (ecp = sp->wp->ecq.lh_first; ecp != NULL; ecp = ecp->q.le_next) {
 		if (!FL_ISSET(ecp->agv_flags, AGV_AT | AGV_GLOBAL | AGV_V))
 			continue;
-		for (rp = ecp->rq.cqh_first; rp != (void *)&ecp->rq; rp = nrp) {
-			nrp = rp->q.cqe_next;
-
-			/* If range less than the line, ignore it. */
-			if (rp->stop < lno)
-				continue;
-			
-			/*
-			 * If range greater than the line, decrement or
-			 * increment the range.
-			 */
-			if (rp->start > lno) {
-				if (op == LINE_DELETE) {
-					--rp->start;
-					--rp->stop;
-				} else {
-					++rp->start;
-					++rp->stop;
-				}
-				continue;
-			}
-
-			/*
-			 * Lno is inside the range, decrement the end point
-			 * for deletion, and split the range for insertion.
-			 * In the latter case, since we're inserting a new
-			 * element, neither range can be exhausted.
-			 */
-			if (op == LINE_DELETE) {
-				if (rp->start > --rp->stop) {
-					CIRCLEQ_REMOVE(&ecp->rq, rp, q);
-					free(rp);
-				}
-			} else {
-				CALLOC_RET(sp, nrp, RANGE *, 1, sizeof(RANGE));
-				nrp->start = lno + 1;
-				nrp->stop = rp->stop + 1;
-				rp->stop = lno - 1;
-				CIRCLEQ_INSERT_AFTER(&ecp->rq, rp, nrp, q);
-				rp = nrp;
-			}
-		}
 
 		/*
 		 * If the command deleted/inserted lines, the cursor moves to
 		 * the line after the deleted/inserted line.
 		 */
 		ecp->range_lno = lno;
+
+		if (ecp->rq.cqh_first == (void *)&ecp->rq)
+			continue;
+		if (ecp->r_delta == NULL && ex_g_index(sp, ecp))
+			return (1);
+
+		/*
+		 * Find the first tracked line at or after lno: descend the
+		 * tree past every line that's before it.
+		 */
+		for (step = 1; step <= ecp->r_cnt / 2; step <<= 1);
+		for (i = 0, sum = 0; step > 0; step >>= 1)
+			if (i + step <= ecp->r_cnt &&
+			    (long)ecp->r_lno[i + step] + sum +
+			    ecp->r_delta[i + step] < (long)lno) {
+				i += step;
+				sum += ecp->r_delta[i];
+			}
+		if (++i > ecp->r_cnt)
+			continue;
+
+		/*
+		 * An insert moves everything from there on.  So does deleting
+		 * an untracked line; deleting a tracked line moves everything
+		 * after it, and the line is dropped from its range.
+		 */
+		if (op == LINE_DELETE) {
+			k = ex_g_live(ecp, i);
+			if (k <= ecp->r_cnt && R_CUR(ecp, k) == (long)lno) {
+				ecp->r_next[k] = k + 1;
+				i = k + 1;
+			}
+			ex_g_add(ecp, i, -1);
+		} else
+			ex_g_add(ecp, i, 1);
 	}
 	return (0);
 }
+
+/*
+ * ex_g_next --
+ *	Return the next line of the ranges of a command, discarding any
+ *	exhausted ranges.  Return 1 if there are none left.
+ *
+ * PUBLIC: int ex_g_next __P((EXCMD *, db_recno_t *));
+ */
+int
+ex_g_next(EXCMD *ecp, db_recno_t *lnop)
+{
+	RANGE *rp;
+	db_recno_t i;
+
+	while ((rp = ecp->rq.cqh_first) != (void *)&ecp->rq) {
+		if (ecp->r_delta == NULL) {
+			if (rp->start <= rp->stop) {
+				*lnop = rp->start++;
+				return (0);
+			}
+		} else {
+			i = ex_g_live(ecp, rp->start);
+			if (i <= rp->stop) {
+				*lnop = R_CUR(ecp, i);
+				rp->start = i + 1;
+				return (0);
+			}
+		}
+		CIRCLEQ_REMOVE(&ecp->rq, rp, q);
+		free(rp);
+	}
+	return (1);
+}
+
+/*
+ * ex_g_free --
+ *	Discard the ranges of a command.
+ *
+ * PUBLIC: void ex_g_free __P((EXCMD *));
+ */
+void
+ex_g_free(EXCMD *ecp)
+{
+	RANGE *rp;
+
+	while ((rp = ecp->rq.cqh_first) != (void *)&ecp->rq) {
+		CIRCLEQ_REMOVE(&ecp->rq, rp, q);
+		free(rp);
+	}
+	if (ecp->r_delta != NULL) {
+		free(ecp->r_delta);
+		free(ecp->r_next);
+		free(ecp->r_lno);
+		ecp->r_delta = NULL;
+		ecp->r_next = NULL;
+		ecp->r_lno = NULL;
+	}
+}
@@ -73,7 +73,7 @@ ex_copy(SCR *sp, EXCMD *cmdp)
 		sp->lno = m.lno + (cnt - 1);
 		sp->cno = 0;
 	}
-err:	text_lfree(&cb.textq);
+err:	cut_free(&cb);
 	return (rval);
 }
 
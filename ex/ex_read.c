@@ -25,10 +25,13 @@ static const char sccsid[] = "$Id: ex_read.c,v 10.44 2001/06/25 15:19:19 skimo E
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "../common/common.h"
 #include "../vi/vi.h"
 
+#define	EX_RDSIZE	(256 * 1024)	/* Input read size. */
+
 /*
  * ex_read --	:read [file]
  *		:read [!cmd]
@@ -293,6 +296,10 @@ ex_read(SCR *sp, EXCMD *cmdp)
  * ex_readfp --
  *	Read lines into the file.
  *
+ * The input is read in large blocks, see ex_readblk(), and each block's
+ * complete lines are appended to the file as a group, see db_append_block().
+ * The FILE is only used for its descriptor.
+ *
  * PUBLIC: int ex_readfp __P((SCR *, char *, FILE *, MARK *, db_recno_t *, int));
  */
 int
@@ -300,10 +307,10 @@ ex_readfp(SCR *sp, char *name, FILE *fp, MARK *fm, db_recno_t *nlinesp, int sile
 {
 	EX_PRIVATE *exp;
 	GS *gp;
-	db_recno_t lcnt, lno;
-	size_t len;
+	db_recno_t lcnt, lno, n;
+	size_t blen, off;
 	u_long ccnt;			/* XXX: can't print off_t portably. */
-	int nf, rval;
+	int eof, nf, rval;
 	char *p;
 	size_t wlen;
 	CHAR_T *wp;
@@ -318,20 +325,25 @@ ex_readfp(SCR *sp, char *name, FILE *fp, MARK *fm, db_recno_t *nlinesp, int sile
 	ccnt = 0;
 	lcnt = 0;
 	p = "147|Reading...";
-	for (lno = fm->lno; !ex_getline(sp, fp, &len); ++lno, ++lcnt) {
-		if ((lcnt + 1) % INTERRUPT_CHECK == 0) {
-			if (INTERRUPTED(sp))
-				break;
-			if (!silent) {
-				gp->scr_busy(sp, p,
-				    p == NULL ? BUSY_UPDATE : BUSY_ON);
-				p = NULL;
-			}
-		}
-		FILE2INT5(sp, exp->ibcw, exp->ibp, len, wp, wlen);
-		if (db_append(sp, 1, lno, wp, wlen))
+	for (lno = fm->lno, blen = off = 0, eof = 0; !eof;) {
+		if (ex_readblk(sp, fileno(fp), &off, &blen, &eof))
+			goto err;
+		if (blen == 0)
+			continue;
+		FILE2INT5(sp, exp->ibcw, exp->ibp, blen, wp, wlen);
+		if (db_append_block(sp, lno, wp, wlen, &n))
 			goto err;
-		ccnt += len;
+		lno += n;
+		lcnt += n;
+		ccnt += blen - (exp->ibp[blen - 1] == '\n' ? n : n - 1);
+
+		/* Caller has to provide any interrupt message. */
+		if (INTERRUPTED(sp))
+			break;
+		if (!silent) {
+			gp->scr_busy(sp, p, p == NULL ? BUSY_UPDATE : BUSY_ON);
+			p = NULL;
+		}
 	}
 
 	if (ferror(fp) || fclose(fp))
@@ -360,3 +372,49 @@ err:		msgq_str(sp, M_SYSERR, name, "%s");
 		gp->scr_busy(sp, NULL, BUSY_OFF);
 	return (rval);
 }
+
+/*
+ * ex_readblk --
+ *	Read once from a file descriptor into the input buffer, and return
+ *	the length of the complete lines at the start of the buffer, or, at
+ *	end of file, of everything left, in *blenp.  On entry, *blenp is the
+ *	length returned by the previous call, and those bytes are discarded;
+ *	*offp is the number of bytes in the buffer, so a partial line at the
+ *	end of one block is kept for the next.  The buffer grows if a line
+ *	doesn't fit.  A read that's interrupted, or that would block, returns
+ *	no lines.
+ *
+ * PUBLIC: int ex_readblk __P((SCR *, int, size_t *, size_t *, int *));
+ */
+int
+ex_readblk(SCR *sp, int fd, size_t *offp, size_t *blenp, int *eofp)
+{
+	EX_PRIVATE *exp;
+	size_t len;
+	ssize_t nr;
+	char *t;
+
+	exp = EXP(sp);
+	if ((len = *offp - *blenp) != 0 && *blenp != 0)
+		memmove(exp->ibp, exp->ibp + *blenp, len);
+	*offp = len;
+	*blenp = 0;
+
+	if (exp->ibp_len - len < EX_RDSIZE / 2)
+		BINC_RETC(sp, exp->ibp, exp->ibp_len, len + EX_RDSIZE);
+	if ((nr = read(fd, exp->ibp + len, exp->ibp_len - len)) < 0)
+		return (errno != EINTR && errno != EAGAIN);
+	if (nr == 0) {
+		*eofp = 1;
+		*blenp = len;
+		return (0);
+	}
+
+	/* Only the new text can end a line. */
+	*offp = len + nr;
+	for (t = exp->ibp + *offp; t > exp->ibp + len && t[-1] != '\n';)
+		--t;
+	if (t > exp->ibp + len)
+		*blenp = t - exp->ibp;
+	return (0);
+}
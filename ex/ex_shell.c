@@ -162,9 +162,9 @@ proc_wait(SCR *sp, long int pid, const char *cmd, int silent, int okpipe)
 	}
 
 	/*
-	 * Display the utility's exit status.  Ignore SIGPIPE from the
-	 * parent-writer, as that only means that the utility chose to
-	 * exit before reading all of its input.
+	 * Display the utility's exit status.  Ignore SIGPIPE if the caller
+	 * says so, as that only means that the caller stopped reading the
+	 * utility's output.
 	 */
 	if (WIFSIGNALED(pstat) && (!okpipe || WTERMSIG(pstat) != SIGPIPE)) {
 		for (; isblank(*cmd); ++cmd);
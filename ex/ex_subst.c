@@ -320,7 +320,7 @@ ex_subtilde(SCR *sp, EXCMD *cmdp)
 		REALLOC(sp, lb, CHAR_T *, lblen * sizeof(CHAR_T));	\
 		if (lb == NULL) {					\
 			lbclen = 0;					\
-			return (1);					\
+			goto err;					\
 		}							\
 	}								\
 	MEMCPYW(lb + lbclen, l, len);					\
@@ -489,6 +489,14 @@ noargs:	if (F_ISSET(sp, SC_VI) && sp->c_suffix && (lflag || nflag || pflag)) {
 	bp = lb = NULL;
 	blen = lbclen = lblen = 0;
 
+	/*
+	 * Unless the user is confirming each change, and so has to see the
+	 * changes as they're made, make them as a batch: the screen is only
+	 * updated once, at the end.
+	 */
+	if (!sp->c_suffix)
+		(void)db_batch(sp, 1);
+
 	/* For each line... */
 	lno = cmdp->addr1.lno == 0 ? 1 : cmdp->addr1.lno;
 	for (matched = quit = 0,
@@ -870,6 +878,8 @@ endmatch:	if (!linechanged)
 err:		rval = 1;
 	}
 
+	if (!sp->c_suffix && db_batch(sp, 0))
+		rval = 1;
 	if (bp != NULL)
 		FREE_SPACEW(sp, bp, blen);
 	if (lb != NULL)
@@ -918,6 +928,7 @@ iclower:	for (p = ptrn, len = plen; len > 0; ++p, --len)
 	/* If we're replacing a saved value, clear the old one. */
 	if (LF_ISSET(SEARCH_CSEARCH) && F_ISSET(sp, SC_RE_SEARCH)) {
 		regfree(&sp->re_c);
+		regfree(&sp->re_bc);
 		F_CLR(sp, SC_RE_SEARCH);
 	}
 	if (LF_ISSET(SEARCH_CSUBST) && F_ISSET(sp, SC_RE_SUBST)) {
@@ -991,8 +1002,22 @@ iclower:	for (p = ptrn, len = plen; len > 0; ++p, --len)
 		return (1);
 	}
 
-	if (LF_ISSET(SEARCH_CSEARCH))
+	/*
+	 * Searches look through blocks of lines at a time where they can,
+	 * which takes a copy of the search RE that treats newlines as line
+	 * boundaries.  It's not used for single lines because they may, in
+	 * rare cases, contain newlines.
+	 */
+	if (LF_ISSET(SEARCH_CSEARCH)) {
+		if ((rval = regcomp(&sp->re_bc,
+		    ptrn, reflags | REG_NEWLINE)) != 0) {
+			if (LF_ISSET(SEARCH_MSG))
+				re_error(sp, rval, &sp->re_bc);
+			regfree(rep);
+			return (1);
+		}
 		F_SET(sp, SC_RE_SEARCH);
+	}
 	if (LF_ISSET(SEARCH_CSUBST))
 		F_SET(sp, SC_RE_SUBST);
 
@@ -45,9 +45,11 @@ static const char sccsid[] = "$Id: ex_tag.c,v 10.50 2004/03/16 14:09:11 skimo Ex
 static char	*binary_search __P((char *, char *, char *));
 static int	 compare __P((char *, char *, char *));
 static void	 ctag_file __P((SCR *, TAGF *, char *, char **, size_t *));
+static int	 ctag_map __P((SCR *, TAGF *));
 static int	 ctag_search __P((SCR *, CHAR_T *, size_t, char *));
 static int	 ctag_sfile __P((SCR *, TAGF *, TAGQ *, char *));
 static TAGQ	*ctag_slist __P((SCR *, CHAR_T *));
+static void	 ctag_unmap __P((SCR *, TAGF *));
 static char	*linear_search __P((char *, char *, char *, long));
 static int	 tag_copy __P((SCR *, TAG *, TAG **));
 static int	 tag_pop __P((SCR *, TAGQ *, int));
@@ -605,6 +607,8 @@ tagf_copy(SCR *sp, TAGF *otfp, TAGF **tfpp)
 
 	MALLOC_RET(sp, tfp, TAGF *, sizeof(TAGF));
 	*tfp = *otfp;
+	tfp->map = NULL;
+	tfp->maplen = 0;
 
 	/* XXX: Allocate as part of the TAGF structure!!! */
 	if ((tfp->name = strdup(otfp->name)) == NULL)
@@ -681,6 +685,7 @@ tagf_free(SCR *sp, TAGF *tfp)
 
 	exp = EXP(sp);
 	TAILQ_REMOVE(&exp->tagfq, tfp, q);
+	ctag_unmap(sp, tfp);
 	free(tfp->name);
 	free(tfp);
 	return (0);
@@ -879,6 +884,8 @@ ex_tagf_alloc(SCR *sp, char *str)
 				}
 				memcpy(tfp->name, t, len);
 				tfp->name[len] = '\0';
+				tfp->map = NULL;
+				tfp->maplen = 0;
 				tfp->flags = 0;
 				TAILQ_INSERT_TAIL(&exp->tagfq, tfp, q);
 			}
@@ -1046,51 +1053,24 @@ alloc_err:
 static int
 ctag_sfile(SCR *sp, TAGF *tfp, TAGQ *tqp, char *tname)
 {
-	struct stat sb;
 	TAG *tp;
-	size_t dlen, nlen, slen;
-	int fd, i, nf1, nf2;
-	char *back, *cname, *dname, *front, *map, *name, *p, *search, *t;
+	size_t blen, dlen, llen, nlen, slen;
+	int i, nf1, nf2;
+	char *back, *bp, *cname, *dname, *front, *name, *p, *search, *t;
 	CHAR_T *wp;
 	size_t wlen;
 	long tl;
 
-	if ((fd = open(tfp->name, O_RDONLY, 0)) < 0) {
-		tfp->errnum = errno;
+	if (ctag_map(sp, tfp))
 		return (1);
-	}
-
-	/*
-	 * XXX
-	 * Some old BSD systems require MAP_FILE as an argument when mapping
-	 * regular files.
-	 */
-#ifndef MAP_FILE
-#define	MAP_FILE	0
-#endif
-	/*
-	 * XXX
-	 * We'd like to test if the file is too big to mmap.  Since we don't
-	 * know what size or type off_t's or size_t's are, what the largest
-	 * unsigned integral type is, or what random insanity the local C
-	 * compiler will perpetrate, doing the comparison in a portable way
-	 * is flatly impossible.  Hope mmap fails if the file is too large.
-	 */
-	if (fstat(fd, &sb) != 0 ||
-	    (map = mmap(NULL, (size_t)sb.st_size, PROT_READ | PROT_WRITE,
-	    MAP_FILE | MAP_PRIVATE, fd, (off_t)0)) == (caddr_t)-1) {
-		tfp->errnum = errno;
-		(void)close(fd);
-		return (1);
-	}
 
 	tl = O_VAL(sp, O_TAGLENGTH);
-	front = map;
-	back = front + sb.st_size;
+	front = tfp->map;
+	back = front + tfp->maplen;
 	front = binary_search(tname, front, back);
 	front = linear_search(tname, front, back, tl);
 	if (front == NULL)
-		goto done;
+		return (0);
 
 	/*
 	 * Initialize and link in the tag structure(s).  The historic ctags
@@ -1107,19 +1087,26 @@ ctag_sfile(SCR *sp, TAGF *tfp, TAGQ *tqp, char *tname)
 	 *	<tag> <filename> <line number> | <pattern>
 	 *
 	 * Figure out how long everything is so we can allocate in one swell
-	 * foop, but discard anything that looks wrong.
+	 * foop, but discard anything that looks wrong.  The mapping is kept
+	 * for later lookups and is read-only, so each line is copied before
+	 * it's broken into tokens.
 	 */
+	GET_SPACE_RETC(sp, bp, blen, 256);
 	for (;;) {
-		/* Nul-terminate the end of the line. */
+		/* Find the end of the line. */
 		for (p = front; p < back && *p != '\n'; ++p);
 		if (p == back || *p != '\n')
 			break;
-		*p = '\0';
+
+		/* Copy and nul-terminate the line. */
+		llen = p - front;
+		ADD_SPACE_GOTO(sp, char, bp, blen, llen + 1);
+		memcpy(bp, front, llen);
+		bp[llen] = '\0';
 
 		/* Update the pointers for the next time. */
-		t = p + 1;
-		p = front;
-		front = t;
+		front = p + 1;
+		p = bp;
 
 		/* Break the line into tokens. */
 		for (i = 0; i < 2 && (t = strsep(&p, "\t ")) != NULL; ++i)
@@ -1175,13 +1162,94 @@ corrupt:		p = msg_print(sp, tname, &nf1);
 	}
 
 alloc_err:
-done:	if (munmap(map, (size_t)sb.st_size))
-		msgq(sp, M_SYSERR, "munmap");
+	FREE_SPACE(sp, bp, blen);
+	return (0);
+}
+
+/*
+ * ctag_map --
+ *	Map a tags file, reusing the mapping from an earlier search if
+ *	the file hasn't changed since.
+ */
+static int
+ctag_map(SCR *sp, TAGF *tfp)
+{
+	struct stat sb;
+	int fd;
+	char *map;
+
+	/*
+	 * Tags files can be very large, and a tag command, or a completion,
+	 * may search them repeatedly.  Keep the file mapped between searches
+	 * and only remap it if it's been replaced or rewritten, which costs
+	 * a stat per search instead of a mapping and the page faults to bring
+	 * the binary search path back in.
+	 */
+	if (stat(tfp->name, &sb) != 0) {
+		tfp->errnum = errno;
+		ctag_unmap(sp, tfp);
+		return (1);
+	}
+	if (tfp->map != NULL && sb.st_dev == tfp->dev &&
+	    sb.st_ino == tfp->ino && sb.st_mtime == tfp->mtime &&
+	    sb.st_size == (off_t)tfp->maplen)
+		return (0);
+	ctag_unmap(sp, tfp);
+
+	if ((fd = open(tfp->name, O_RDONLY, 0)) < 0) {
+		tfp->errnum = errno;
+		return (1);
+	}
+
+	/*
+	 * XXX
+	 * Some old BSD systems require MAP_FILE as an argument when mapping
+	 * regular files.
+	 */
+#ifndef MAP_FILE
+#define	MAP_FILE	0
+#endif
+	/*
+	 * XXX
+	 * We'd like to test if the file is too big to mmap.  Since we don't
+	 * know what size or type off_t's or size_t's are, what the largest
+	 * unsigned integral type is, or what random insanity the local C
+	 * compiler will perpetrate, doing the comparison in a portable way
+	 * is flatly impossible.  Hope mmap fails if the file is too large.
+	 */
+	if (fstat(fd, &sb) != 0 ||
+	    (map = mmap(NULL, (size_t)sb.st_size, PROT_READ,
+	    MAP_FILE | MAP_PRIVATE, fd, (off_t)0)) == (caddr_t)-1) {
+		tfp->errnum = errno;
+		(void)close(fd);
+		return (1);
+	}
 	if (close(fd))
 		msgq(sp, M_SYSERR, "close");
+
+	tfp->map = map;
+	tfp->maplen = sb.st_size;
+	tfp->dev = sb.st_dev;
+	tfp->ino = sb.st_ino;
+	tfp->mtime = sb.st_mtime;
 	return (0);
 }
 
+/*
+ * ctag_unmap --
+ *	Discard a tags file mapping.
+ */
+static void
+ctag_unmap(SCR *sp, TAGF *tfp)
+{
+	if (tfp->map == NULL)
+		return;
+	if (munmap(tfp->map, tfp->maplen))
+		msgq(sp, M_SYSERR, "munmap");
+	tfp->map = NULL;
+	tfp->maplen = 0;
+}
+
 /*
  * ctag_file --
  *	Search for the right path to this file.
@@ -1330,3 +1398,74 @@ compare(register char *s1, register char *s2, register char *back)
 	return (*s1 ? GREATER : s2 < back &&
 	    (*s2 != '\t' && *s2 != ' ') ? LESS : EQUAL);
 }
+
+/*
+ * ex_tag_complete --
+ *	Append the names of the tags starting with a prefix to the command's
+ *	argument list, for vi's tag name completion.
+ *
+ * PUBLIC: int ex_tag_complete __P((SCR *, EXCMD *, CHAR_T *, size_t));
+ */
+int
+ex_tag_complete(SCR *sp, EXCMD *excp, CHAR_T *prefix, size_t plen)
+{
+	EX_PRIVATE *exp;
+	TAGF *tfp;
+	size_t blen, len, nlen, wlen;
+	int first, i;
+	char *back, *bp, *front, *lp, *np, *p;
+	CHAR_T *wp;
+
+	/* An empty prefix would list every tag. */
+	if (plen == 0)
+		return (0);
+
+	INT2CHAR(sp, prefix, plen, np, nlen);
+	GET_SPACE_RETC(sp, bp, blen, nlen + 1);
+	memcpy(bp, np, nlen);
+	bp[nlen] = '\0';
+
+	/*
+	 * The tags are sorted, so the matches are adjacent, starting at the
+	 * first line the binary search finds.  Tags with several locations
+	 * are listed once; only tags already found in an earlier tags file
+	 * have to be searched for.
+	 */
+	exp = EXP(sp);
+	for (tfp = exp->tagfq.tqh_first;
+	    tfp != NULL && !INTERRUPTED(sp); tfp = tfp->q.tqe_next) {
+		if (ctag_map(sp, tfp))
+			continue;
+		front = tfp->map;
+		back = front + tfp->maplen;
+		front = binary_search(bp, front, back);
+		if ((front = linear_search(bp, front, back, nlen)) == NULL)
+			continue;
+		for (first = excp->argc, lp = NULL, len = 0;
+		    front < back && !INTERRUPTED(sp);) {
+			for (p = front; p < back &&
+			    *p != '\t' && *p != ' ' && *p != '\n'; ++p);
+			if ((size_t)(p - front) < nlen ||
+			    memcmp(front, bp, nlen))
+				break;
+			if (lp == NULL || (size_t)(p - front) != len ||
+			    memcmp(front, lp, len)) {
+				lp = front;
+				len = p - front;
+				CHAR2INT(sp, lp, len, wp, wlen);
+				for (i = 0; i < first; ++i)
+					if (excp->argv[i]->len == wlen &&
+					    !MEMCMP(excp->argv[i]->bp, wp, wlen))
+						break;
+				if (i == first && argv_exp0(sp, excp, wp, wlen))
+					goto err;
+			}
+			SKIP_PAST_NEWLINE(front, back);
+		}
+	}
+	FREE_SPACE(sp, bp, blen);
+	return (0);
+
+err:	FREE_SPACE(sp, bp, blen);
+	return (1);
+}
@@ -16,6 +16,7 @@ static const char sccsid[] = "$Id: ex_write.c,v 10.38 2001/06/25 15:19:22 skimo
 #include <sys/types.h>
 #include <sys/queue.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 #include <bitstring.h>
 #include <ctype.h>
@@ -32,6 +33,30 @@ static const char sccsid[] = "$Id: ex_write.c,v 10.38 2001/06/25 15:19:22 skimo
 enum which {WN, WQ, WRITE, XIT};
 static int exwr __P((SCR *, EXCMD *, enum which));
 
+/*
+ * Lines are written by gathering them into a large buffer and handing the
+ * buffer to writev(2), not a line at a time through stdio.  Runs of lines
+ * that are stored as the file would hold them, i.e., unchanged lines of a
+ * file in a line store, aren't copied at all: they're written from where
+ * they're stored, by their own I/O vector.
+ */
+#define	WR_BUFSIZE	(256 * 1024)	/* Gather buffer size. */
+#define	WR_NIOV		64		/* I/O vectors per write. */
+#define	WR_BLKLINES	(100 * INTERRUPT_CHECK)	/* Most lines per block. */
+
+typedef struct {
+	int	 fd;			/* File descriptor. */
+	char	*bp;			/* Gather buffer. */
+	size_t	 off;			/* Start of the open buffer segment. */
+	size_t	 len;			/* End of the open buffer segment. */
+	struct iovec iov[WR_NIOV];	/* Pending I/O vectors. */
+	int	 niov;			/* Number of pending I/O vectors. */
+} WRBUF;
+
+static int wr_block __P((WRBUF *, char *, size_t));
+static int wr_copy __P((WRBUF *, char *, size_t));
+static int wr_flush __P((WRBUF *));
+
 /*
  * ex_wn --	:wn[!] [>>] [file]
  *	Write to a file and switch to the next one.
@@ -279,8 +304,9 @@ ex_writefp(SCR *sp, char *name, FILE *fp, MARK *fm, MARK *tm, u_long *nlno, u_lo
 {
 	struct stat sb;
 	GS *gp;
+	WRBUF wr;
 	u_long ccnt;			/* XXX: can't print off_t portably. */
-	db_recno_t fline, tline, lcnt;
+	db_recno_t fline, tline, lcnt, ichk, n;
 	size_t len;
 	int rval;
 	char *msg;
@@ -298,12 +324,6 @@ ex_writefp(SCR *sp, char *name, FILE *fp, MARK *fm, MARK *tm, u_long *nlno, u_lo
 	}
 
 	/*
-	 * The vi filter code has multiple processes running simultaneously,
-	 * and one of them calls ex_writefp().  The "unsafe" function calls
-	 * in this code are to db_get() and msgq().  Db_get() is safe, see
-	 * the comment in ex_filter.c:ex_filter() for details.  We don't call
-	 * msgq if the multiple process bit in the EXF is set.
-	 *
 	 * !!!
 	 * Historic vi permitted files of 0 length to be written.  However,
 	 * since the way vi got around dealing with "empty" files was to
@@ -315,10 +335,17 @@ ex_writefp(SCR *sp, char *name, FILE *fp, MARK *fm, MARK *tm, u_long *nlno, u_lo
 	ccnt = 0;
 	lcnt = 0;
 	msg = "253|Writing...";
+	wr.fd = fileno(fp);
+	wr.off = wr.len = 0;
+	wr.niov = 0;
+	if ((wr.bp = malloc(WR_BUFSIZE)) == NULL || fflush(fp))
+		goto err;
 	if (tline != 0)
-		for (; fline <= tline; ++fline, ++lcnt) {
+		for (ichk = INTERRUPT_CHECK - 1;
+		    fline <= tline; fline += n, lcnt += n) {
 			/* Caller has to provide any interrupt message. */
-			if ((lcnt + 1) % INTERRUPT_CHECK == 0) {
+			if (lcnt >= ichk) {
+				ichk = lcnt + INTERRUPT_CHECK;
 				if (INTERRUPTED(sp))
 					break;
 				if (!silent) {
@@ -327,19 +354,32 @@ ex_writefp(SCR *sp, char *name, FILE *fp, MARK *fm, MARK *tm, u_long *nlno, u_lo
 					msg = NULL;
 				}
 			}
-			if (db_get(sp, fline, DBG_FATAL, &p, &len))
-				goto err;
-			INT2FILE(sp, p, len, f, flen);
-			if (fwrite(f, 1, flen, fp) != flen)
-				goto err;
-			ccnt += len;
-			if (putc('\n', fp) != '\n')
-				break;
-			++ccnt;
-		}
 
-	if (fflush(fp))
+			/*
+			 * Write a block of lines where it's stored, if the
+			 * lines are stored that way, else copy the line.
+			 */
+			n = tline - fline + 1;
+			if (n > WR_BLKLINES)
+				n = WR_BLKLINES;
+			if (!db_block(sp, fline, FORWARD, &p, &len, &n)) {
+				if (wr_block(&wr, (char *)p, len))
+					goto err;
+			} else {
+				n = 1;
+				if (db_get(sp, fline, DBG_FATAL, &p, &len))
+					goto err;
+				INT2FILE(sp, p, len, f, flen);
+				if (wr_copy(&wr, f, flen))
+					goto err;
+			}
+			ccnt += len + 1;
+		}
+	if (wr_flush(&wr))
 		goto err;
+	free(wr.bp);
+	wr.bp = NULL;
+
 	/*
 	 * XXX
 	 * I don't trust NFS -- check to make sure that we're talking to
@@ -354,9 +394,10 @@ ex_writefp(SCR *sp, char *name, FILE *fp, MARK *fm, MARK *tm, u_long *nlno, u_lo
 
 	rval = 0;
 	if (0) {
-err:		if (!F_ISSET(sp->ep, F_MULTILOCK))
-			msgq_str(sp, M_SYSERR, name, "%s");
+err:		msgq_str(sp, M_SYSERR, name, "%s");
 		(void)fclose(fp);
+		if (wr.bp != NULL)
+			free(wr.bp);
 		rval = 1;
 	}
 
@@ -370,3 +411,90 @@ err:		if (!F_ISSET(sp->ep, F_MULTILOCK))
 	}
 	return (rval);
 }
+
+/*
+ * wr_copy --
+ *	Copy a line and its newline into the gather buffer.
+ */
+static int
+wr_copy(WRBUF *wp, char *p, size_t len)
+{
+	if (wp->len + len + 1 > WR_BUFSIZE) {
+		if (wr_flush(wp))
+			return (1);
+
+		/* Lines longer than the buffer are written where they are. */
+		if (len + 1 > WR_BUFSIZE) {
+			wp->iov[0].iov_base = p;
+			wp->iov[0].iov_len = len;
+			wp->niov = 1;
+			if (wr_flush(wp))
+				return (1);
+			len = 0;
+		}
+	}
+	memcpy(wp->bp + wp->len, p, len);
+	wp->len += len;
+	wp->bp[wp->len++] = '\n';
+	return (0);
+}
+
+/*
+ * wr_block --
+ *	Add a block of lines to be written from where they're stored, and
+ *	copy its final newline into the gather buffer.
+ */
+static int
+wr_block(WRBUF *wp, char *p, size_t len)
+{
+	if ((wp->niov + 3 > WR_NIOV ||
+	    wp->len + 1 > WR_BUFSIZE) && wr_flush(wp))
+		return (1);
+	if (wp->len > wp->off) {
+		wp->iov[wp->niov].iov_base = wp->bp + wp->off;
+		wp->iov[wp->niov].iov_len = wp->len - wp->off;
+		++wp->niov;
+		wp->off = wp->len;
+	}
+	wp->iov[wp->niov].iov_base = p;
+	wp->iov[wp->niov].iov_len = len;
+	++wp->niov;
+	wp->bp[wp->len++] = '\n';
+	return (0);
+}
+
+/*
+ * wr_flush --
+ *	Write the pending I/O vectors and the open buffer segment.
+ */
+static int
+wr_flush(WRBUF *wp)
+{
+	struct iovec *iovp;
+	ssize_t nw;
+	int cnt;
+
+	if (wp->len > wp->off) {
+		wp->iov[wp->niov].iov_base = wp->bp + wp->off;
+		wp->iov[wp->niov].iov_len = wp->len - wp->off;
+		++wp->niov;
+	}
+	for (iovp = wp->iov, cnt = wp->niov; cnt > 0;) {
+		if ((nw = writev(wp->fd, iovp, cnt)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return (1);
+		}
+
+		/* Skip what was written; pipes may take less than asked. */
+		for (; cnt > 0 && (size_t)nw >= iovp->iov_len; ++iovp, --cnt)
+			nw -= iovp->iov_len;
+		if (cnt > 0) {
+			iovp->iov_base = (char *)iovp->iov_base + nw;
+			iovp->iov_len -= nw;
+		}
+	}
+	wp->niov = 0;
+	wp->off = wp->len = 0;
+	return (0);
+}
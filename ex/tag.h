@@ -11,6 +11,22 @@
  *	$Id: tag.h,v 10.8 2000/07/14 14:29:22 skimo Exp $ (Berkeley) $Date: 2000/07/14 14:29:22 $
  */
 
+/*
+ * Cscope query results.  The cscope process is run with -d, so it never
+ * rebuilds its database, and the answer to a query only changes if the
+ * database file does.  The output of the most recent queries is kept for
+ * each connection, most recently used first, and repeated queries are
+ * answered from it without a round-trip to the cscope process.
+ */
+struct _csr {
+	CIRCLEQ_ENTRY(_csr) q;	/* Linked list of query results. */
+	size_t	 search;	/* Cscope query number. */
+	char	*lines;		/* Output lines, each nul-terminated. */
+	size_t	 len;		/* Length of the output lines. */
+	int	 nlines;	/* Number of output lines. */
+	char	 pattern[1];	/* Variable length query pattern. */
+};
+
 /*
  * Cscope connection information.  One of these is maintained per cscope
  * connection, linked from the EX_PRIVATE structure.
@@ -20,9 +36,14 @@ struct _csc {
 
 	char	*dname;		/* Base directory of this cscope connection. */
 	size_t	 dlen;		/* Length of base directory. */
+	char	*dbpath;	/* Path of the cscope database. */
 	pid_t	 pid;		/* PID of the connected cscope process. */
 	time_t	 mtime;		/* Last modification time of cscope database. */
 
+	CIRCLEQ_HEAD(_csrh, _csr) csrq;	/* Query results. */
+	int	 ncsr;		/* Number of query results. */
+	time_t	 rmtime;	/* Database modification time of results. */
+
 	FILE	*from_fp;	/* from cscope: FILE. */
 	int	 from_fd;	/* from cscope: file descriptor. */
 	FILE	*to_fp;		/* to cscope: FILE. */
@@ -44,6 +65,12 @@ struct _tagf {			/* Tag files. */
 	char	*name;		/* Tag file name. */
 	int	 errnum;	/* Errno. */
 
+	char	*map;		/* Mapped tag file, kept between searches. */
+	size_t	 maplen;	/* Mapped length. */
+	dev_t	 dev;		/* Mapped file's device, */
+	ino_t	 ino;		/*    inode, */
+	time_t	 mtime;		/*    and modification time. */
+
 #define	TAGF_ERR	0x01	/* Error occurred. */
 #define	TAGF_ERR_WARN	0x02	/* Error reported. */
 	u_int8_t flags;
@@ -43,7 +43,7 @@ ip_waddstr(SCR *sp, const CHAR_T *str, size_t len)
 	ipb.code = SI_WADDSTR;
 	ipb.len1 = len * sizeof(CHAR_T);
 	ipb.str1 = (char *)str;
-	rval = vi_send(ipp->o_fd, "a", &ipb);
+	rval = vi_queue(ipp, "a", &ipb);
 	/* XXXX */
 	ipp->col += len;
 
@@ -78,7 +78,7 @@ ip_addstr(SCR *sp, const char *str, size_t len)
 	ipb.code = SI_ADDSTR;
 	ipb.len1 = len;
 	ipb.str1 = str;
-	rval = vi_send(ipp->o_fd, "a", &ipb);
+	rval = vi_queue(ipp, "a", &ipb);
 	/* XXXX */
 	ipp->col += len;
 
@@ -108,7 +108,7 @@ ip_attr(SCR *sp, scr_attr_t attribute, int on)
 	ipb.val1 = attribute;
 	ipb.val2 = on;
 
-	return (vi_send(ipp->o_fd, "12", &ipb));
+	return (vi_queue(ipp, "12", &ipb));
 }
 
 /*
@@ -138,7 +138,7 @@ ip_bell(SCR *sp)
 
 	ipb.code = SI_BELL;
 
-	return (vi_send(ipp->o_fd, NULL, &ipb));
+	return (vi_queue(ipp, NULL, &ipb));
 }
 
 /*
@@ -158,11 +158,13 @@ ip_busy(SCR *sp, const char *str, busy_t bval)
 		ipb.code = SI_BUSY_ON;
 		ipb.str1 = str;
 		ipb.len1 = strlen(str);
-		(void)vi_send(ipp->o_fd, "a", &ipb);
+		(void)vi_queue(ipp, "a", &ipb);
+		(void)vi_flush(ipp);
 		break;
 	case BUSY_OFF:
 		ipb.code = SI_BUSY_OFF;
-		(void)vi_send(ipp->o_fd, NULL, &ipb);
+		(void)vi_queue(ipp, NULL, &ipb);
+		(void)vi_flush(ipp);
 		break;
 	case BUSY_UPDATE:
 		break;
@@ -225,7 +227,7 @@ ip_clrtoeol(SCR *sp)
 
 	ipb.code = SI_CLRTOEOL;
 
-	return (vi_send(ipp->o_fd, NULL, &ipb));
+	return (vi_queue(ipp, NULL, &ipb));
 }
 
 /*
@@ -268,7 +270,7 @@ ip_deleteln(SCR *sp)
 	if (!F_ISSET(sp, SC_SCR_EXWROTE) && IS_SPLIT(sp)) {
 		ipb.code = SI_REWRITE;
 		ipb.val1 = RLNO(sp, LASTLINE(sp));
-		if (vi_send(ipp->o_fd, "1", &ipb))
+		if (vi_queue(ipp, "1", &ipb))
 			return (1);
 	}
 
@@ -277,7 +279,7 @@ ip_deleteln(SCR *sp)
 	 * and other screens must support that semantic.
 	 */
 	ipb.code = SI_DELETELN;
-	return (vi_send(ipp->o_fd, NULL, &ipb));
+	return (vi_queue(ipp, NULL, &ipb));
 }
 
 /*
@@ -319,7 +321,7 @@ ip_insertln(SCR *sp)
 
 	ipb.code = SI_INSERTLN;
 
-	return (vi_send(ipp->o_fd, NULL, &ipb));
+	return (vi_queue(ipp, NULL, &ipb));
 }
 
 /*
@@ -376,7 +378,7 @@ ip_move(SCR *sp, size_t lno, size_t cno)
 	ipb.code = SI_MOVE;
 	ipb.val1 = RLNO(sp, lno);
 	ipb.val2 = RCNO(sp, cno);
-	return (vi_send(ipp->o_fd, "12", &ipb));
+	return (vi_queue(ipp, "12", &ipb));
 }
 
 /*
@@ -390,6 +392,7 @@ ip_msg(SCR *sp, mtype_t mtype, char *line, size_t len)
 	if (F_ISSET(ipp, IP_ON_ALTERNATE))
 		vs_msg(sp, mtype, line, len);
 	else {
+		(void)vi_flush(ipp);
 		write(ipp->t_fd, line, len);
 		F_CLR(sp, SC_EX_WAIT_NO);
 	}
@@ -431,15 +434,20 @@ ip_refresh(SCR *sp, int repaint)
 	if (ipb.val1 != ipp->sb_top ||
 	    ipb.val2 != ipp->sb_num || ipb.val3 != ipp->sb_total) {
 		ipb.code = SI_SCROLLBAR;
-		(void)vi_send(ipp->o_fd, "123", &ipb);
+		(void)vi_queue(ipp, "123", &ipb);
 		ipp->sb_top = ipb.val1;
 		ipp->sb_num = ipb.val2;
 		ipp->sb_total = ipb.val3;
 	}
 
-	/* Refresh/repaint the screen. */
+	/*
+	 * Refresh/repaint the screen.  Everything queued since the last
+	 * refresh goes to the front-end in a single write.
+	 */
 	ipb.code = repaint ? SI_REDRAW : SI_REFRESH;
-	return (vi_send(ipp->o_fd, NULL, &ipb));
+	if (vi_queue(ipp, NULL, &ipb))
+		return (1);
+	return (vi_flush(ipp));
 }
 
 /*
@@ -457,7 +465,7 @@ ip_rename(SCR *sp, char *name, int on)
 	ipb.code = SI_RENAME;
 	ipb.str1 = name;
 	ipb.len1 = name ? strlen(name) : 0;
-	return (vi_send(ipp->o_fd, "a", &ipb));
+	return (vi_queue(ipp, "a", &ipb));
 }
 
 /*
@@ -476,7 +484,7 @@ ip_reply(SCR *sp, int status, char *msg)
 	ipb.val1 = status;
 	ipb.str1 = msg == NULL ? "" : msg;
 	ipb.len1 = strlen(ipb.str1);
-	return (vi_send(ipp->o_fd, "1a", &ipb));
+	return (vi_queue(ipp, "1a", &ipb));
 }
 
 /*
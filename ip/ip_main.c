@@ -157,7 +157,8 @@ run_editor(void * vp)
 
 	/* Send the quit message. */
 	ipb.code = SI_QUIT;
-	(void)vi_send(ipp->o_fd, NULL, &ipb);
+	(void)vi_queue(ipp, NULL, &ipb);
+	(void)vi_flush(ipp);
 
 	/* Give the screen a couple of seconds to deal with it. */
 	sleep(2);
@@ -166,6 +167,8 @@ run_editor(void * vp)
 	win_end(wp);
 
 #if defined(DEBUG) || defined(PURIFY) || defined(LIBRARY)
+	if (ipp->obuf != NULL)
+		free(ipp->obuf);
 	free(ipp);
 #endif
 	return NULL;
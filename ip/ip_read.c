@@ -111,6 +111,7 @@ typedef enum { INP_OK=0, INP_EOF, INP_ERR, INP_TIMEOUT } input_t;
 
 static input_t	ip_read __P((SCR *, IP_PRIVATE *, struct timeval *, int, int*));
 static int	ip_resize __P((SCR *, u_int32_t, u_int32_t));
+static u_int32_t ip_string __P((SCR *, IP_PRIVATE *, EVENT *, u_int32_t));
 static int	ip_trans __P((SCR *, IP_PRIVATE *, EVENT *));
 
 /*
@@ -172,6 +173,9 @@ ip_wevent(WIN *wp, SCR *sp, EVENT *evp, u_int32_t flags, int ms)
 		tp = &t;
 	}
 
+	/* Nothing more to do until there's input: write the screen. */
+	(void)vi_flush(ipp);
+
 	/* Read input events. */
 	for (;;) {
 		switch (ip_read(sp, ipp, tp, termread, &nr)) {
@@ -336,6 +340,11 @@ ip_trans(SCR *sp, IP_PRIVATE *ipp, EVENT *evp)
 				MEMCPYW(ipp->tbuf, wp, wlen);
 				evp->e_str1 = ipp->tbuf;
 				evp->e_len1 = wlen;
+				if (evp->e_event == E_STRING) {
+					skip = ip_string(sp,
+					    ipp, evp, skip + val);
+					break;
+				}
 			} else {
 				CHAR2INT(sp, ipp->ibuf + skip, val,
 					 wp, wlen);
@@ -355,6 +364,39 @@ ip_trans(SCR *sp, IP_PRIVATE *ipp, EVENT *evp)
 	return (1);
 }
 
+/*
+ * ip_string --
+ *	Coalesce the complete input strings that follow an input string
+ *	into a single event, so a burst of keys is handled at once.  The
+ *	offset is that of the message after the first string, and the
+ *	offset of the first message not coalesced is returned.
+ */
+static u_int32_t
+ip_string(SCR *sp, IP_PRIVATE *ipp, EVENT *evp, u_int32_t skip)
+{
+	u_int32_t val;
+	CHAR_T *wp;
+	size_t wlen;
+
+	/*
+	 * The input strings can't hold more characters than ibuf holds
+	 * bytes, and tbuf is as large as ibuf.
+	 */
+	while (ipp->iblen >= skip + IPO_CODE_LEN + IPO_INT_LEN &&
+	    ipp->ibuf[skip] == VI_STRING) {
+		memcpy(&val, ipp->ibuf + skip + IPO_CODE_LEN, IPO_INT_LEN);
+		val = ntohl(val);
+		if (ipp->iblen < skip + IPO_CODE_LEN + IPO_INT_LEN + val)
+			break;
+		skip += IPO_CODE_LEN + IPO_INT_LEN;
+		CHAR2INT(sp, ipp->ibuf + skip, val, wp, wlen);
+		MEMCPYW(ipp->tbuf + evp->e_len1, wp, wlen);
+		evp->e_len1 += wlen;
+		skip += val;
+	}
+	return (skip);
+}
+
 /* 
  * ip_resize --
  *	Reset the options for a resize event.
@@ -129,6 +129,6 @@ ip_optchange(SCR *sp, int offset, char *str, u_long *valp)
 	ipb.str1 = (char*)opt->name;
 	ipb.len1 = STRLEN(opt->name) * sizeof(CHAR_T);
 
-	(void)vi_send(ipp->o_fd, "ab1", &ipb);
+	(void)vi_queue(ipp, "ab1", &ipb);
 	return (0);
 }
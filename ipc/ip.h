@@ -32,11 +32,17 @@ typedef struct _ip_private {
 	db_recno_t	 sb_top;	/* scrollbar: top line on screen. */
 	size_t	 sb_num;	/* scrollbar: number of lines on screen. */
 
+#define	IP_IBUFLEN	4096	/* Input buffer size. */
 	size_t	 iblen;		/* Input buffer length. */
 	size_t	 iskip;		/* Returned input buffer. */
-	char	 ibuf[256];	/* Input buffer. */
+	char	 ibuf[IP_IBUFLEN];	/* Input buffer. */
 
-	CHAR_T 	 tbuf[256];	/* Input keys. */
+	CHAR_T 	 tbuf[IP_IBUFLEN];	/* Input keys. */
+
+#define	IP_OBUFMAX	8192	/* Output buffer flush threshold. */
+	char	*obuf;		/* Output buffer. */
+	size_t	 oblen;		/* Output buffer size. */
+	size_t	 olen;		/* Output buffer length. */
 
 #define	IP_IN_EX  	0x0001  /* Currently running ex. */
 #define IP_ON_ALTERNATE 0x0002	/* Alternate on. */
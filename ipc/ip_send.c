@@ -34,10 +34,7 @@ vi_send(int ofd, char *fmt, IP_BUF *ipbp)
 {
 	static char *bp;
 	static size_t blen;
-	size_t off;
-	u_int32_t ilen;
-	int nlen, n, nw;
-	char *p;
+	size_t len;
 
 	/*
 	 * Have not created the channel to vi yet?  -- RAZ
@@ -52,13 +49,55 @@ vi_send(int ofd, char *fmt, IP_BUF *ipbp)
 		abort();
 	}
 
-	if (blen == 0 && (bp = malloc(blen = 512)) == NULL)
+	len = 0;
+	if (vi_append(&bp, &blen, &len, fmt, ipbp))
 		return (1);
+	return (vi_write(ofd, bp, len));
+}
+
+/*
+ * vi_append --
+ *	Construct an IP buffer at the end of a message buffer, growing
+ *	the buffer as necessary.  The messages are self-delimiting, so
+ *	any number of them can be written to the channel at once.
+ *
+ * PUBLIC: int vi_append __P((char **, size_t *, size_t *, char *, IP_BUF *));
+ */
+int
+vi_append(char **bpp, size_t *blenp, size_t *lenp, char *fmt, IP_BUF *ipbp)
+{
+	u_int32_t ilen;
+	size_t nlen;
+	char *bp, *p;
+
+	/* Compute the length of the message. */
+	nlen = IPO_CODE_LEN;
+	if (fmt != NULL)
+		for (p = fmt; *p != '\0'; ++p)
+			switch (*p) {
+			case '1':
+			case '2':
+			case '3':
+				nlen += IPO_INT_LEN;
+				break;
+			case 'a':
+				nlen += IPO_INT_LEN + ipbp->len1;
+				break;
+			case 'b':
+				nlen += IPO_INT_LEN + ipbp->len2;
+				break;
+			}
+
+	nlen += *lenp;
+	if (nlen > *blenp) {
+		if ((bp = realloc(*bpp, *blenp * 2 + nlen)) == NULL)
+			return (1);
+		*bpp = bp;
+		*blenp = *blenp * 2 + nlen;
+	}
 
-	p = bp;
-	nlen = 0;
+	p = *bpp + *lenp;
 	*p++ = ipbp->code;
-	nlen += IPO_CODE_LEN;
 
 	if (fmt != NULL)
 		for (; *fmt != '\0'; ++fmt)
@@ -71,42 +110,72 @@ vi_send(int ofd, char *fmt, IP_BUF *ipbp)
 				goto value;
 			case '3':				/* Value #3. */
 				ilen = htonl(ipbp->val3);
-value:				nlen += IPO_INT_LEN;
-				if (nlen >= blen) {
-					blen = blen * 2 + nlen;
-					off = p - bp;
-					if ((bp = realloc(bp, blen)) == NULL)
-						return (1);
-					p = bp + off;
-				}
-				memcpy(p, &ilen, IPO_INT_LEN);
+value:				memcpy(p, &ilen, IPO_INT_LEN);
 				p += IPO_INT_LEN;
 				break;
 			case 'a':				/* String #1. */
+				ilen = htonl(ipbp->len1);
+				memcpy(p, &ilen, IPO_INT_LEN);
+				p += IPO_INT_LEN;
+				memcpy(p, ipbp->str1, ipbp->len1);
+				p += ipbp->len1;
+				break;
 			case 'b':				/* String #2. */
-				ilen = *fmt == 'a' ? ipbp->len1 : ipbp->len2;
-				nlen += IPO_INT_LEN + ilen;
-				if (nlen >= blen) {
-					blen = blen * 2 + nlen;
-					off = p - bp;
-					if ((bp = realloc(bp, blen)) == NULL)
-						return (1);
-					p = bp + off;
-				}
-				ilen = htonl(ilen);
+				ilen = htonl(ipbp->len2);
 				memcpy(p, &ilen, IPO_INT_LEN);
 				p += IPO_INT_LEN;
-				if (*fmt == 'a') {
-					memcpy(p, ipbp->str1, ipbp->len1);
-					p += ipbp->len1;
-				} else {
-					memcpy(p, ipbp->str2, ipbp->len2);
-					p += ipbp->len2;
-				}
+				memcpy(p, ipbp->str2, ipbp->len2);
+				p += ipbp->len2;
 				break;
 			}
-	for (n = p - bp, p = bp; n > 0; n -= nw, p += nw)
-		if ((nw = write(ofd, p, n)) < 0)
+	*lenp = nlen;
+	return (0);
+}
+
+/*
+ * vi_write --
+ *	Write a buffer of IP messages to the channel.
+ *
+ * PUBLIC: int vi_write __P((int, char *, size_t));
+ */
+int
+vi_write(int ofd, char *bp, size_t len)
+{
+	ssize_t nw;
+
+	for (; len > 0; len -= nw, bp += nw)
+		if ((nw = write(ofd, bp, len)) < 0)
 			return (1);
 	return (0);
 }
+
+/*
+ * vi_queue --
+ *	Construct an IP buffer and queue it for the front-end.
+ *
+ * PUBLIC: int vi_queue __P((IP_PRIVATE *, char *, IP_BUF *));
+ */
+int
+vi_queue(IP_PRIVATE *ipp, char *fmt, IP_BUF *ipbp)
+{
+	if (vi_append(&ipp->obuf, &ipp->oblen, &ipp->olen, fmt, ipbp))
+		return (1);
+	return (ipp->olen >= IP_OBUFMAX ? vi_flush(ipp) : 0);
+}
+
+/*
+ * vi_flush --
+ *	Write any queued IP buffers to the front-end.
+ *
+ * PUBLIC: int vi_flush __P((IP_PRIVATE *));
+ */
+int
+vi_flush(IP_PRIVATE *ipp)
+{
+	size_t len;
+
+	if ((len = ipp->olen) == 0)
+		return (0);
+	ipp->olen = 0;
+	return (vi_write(ipp->o_fd, ipp->obuf, len));
+}
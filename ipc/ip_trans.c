@@ -33,7 +33,7 @@ static const char sccsid[] = "$Id: ip_trans.c,v 8.18 2001/06/25 15:19:25 skimo E
 #include "ip.h"
 #include "ipc_def.h"
 
-static char ibuf[2048];				/* Input buffer. */
+static char ibuf[32768];				/* Input buffer. */
 static size_t ibuf_len;				/* Length of current input. */
 
 extern IPFUNLIST const ipfuns[];
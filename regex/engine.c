@@ -96,6 +96,11 @@ static RCHAR_T *backref __P((struct match *m, RCHAR_T *start, RCHAR_T *stop, sop
 static RCHAR_T *fast __P((struct match *m, RCHAR_T *start, RCHAR_T *stop, sopno startst, sopno stopst));
 static RCHAR_T *slow __P((struct match *m, RCHAR_T *start, RCHAR_T *stop, sopno startst, sopno stopst));
 static states step __P((struct re_guts *g, sopno start, sopno stop, states bef, int ch, states aft));
+#ifdef CACHESTATES
+static RCHAR_T *dfast __P((struct match *m, RCHAR_T *start, RCHAR_T *stop, sopno startst, sopno stopst));
+static int dfainit __P((struct re_guts *g));
+static int dfastate __P((struct re_dfa *d, states st));
+#endif
 #define	BOL	(OUT+1)
 #define	EOL	(BOL+1)
 #define	BOLEOL	(BOL+2)
@@ -168,12 +173,19 @@ int eflags;
 
 	/* prescreening; this does wonders for this rather slow code */
 	if (g->must != NULL) {
-		for (dp = start; dp < stop; dp++)
-			if (*dp == g->must[0] && stop - dp >= g->mlen &&
-				MEMCMP(dp, g->must, (size_t)g->mlen) == 0)
-				break;
-		if (dp == stop)		/* we didn't find g->must */
-			return(REG_NOMATCH);
+		if ((dp = mfind(g, start, stop)) == NULL)
+			return(REG_NOMATCH);	/* we didn't find g->must */
+
+		/* a literal RE matches the first instance of its string */
+		if (g->iflags&LITERAL) {
+			if (nmatch > 0) {
+				pmatch[0].rm_so = dp - string;
+				pmatch[0].rm_eo = dp - string + g->mlen;
+			}
+			for (i = 1; i < nmatch; i++)
+				pmatch[i].rm_so = pmatch[i].rm_eo = -1;
+			return(0);
+		}
 	}
 
 	/* match struct setup */
@@ -711,6 +723,13 @@ sopno stopst;
 	register int i;
 	register RCHAR_T *coldp;	/* last p after which no match was underway */
 
+#ifdef CACHESTATES
+	/* the DFA cache knows only the whole RE */
+	if (startst == m->g->firststate+1 && stopst == m->g->laststate &&
+				(m->g->dfa != NULL || dfainit(m->g) == 0))
+		return(dfast(m, start, stop, startst, stopst));
+#endif
+
 	CLEAR(st);
 	SET1(st, startst);
 	st = step(m->g, startst, stopst, st, NOTHING, st);
@@ -779,6 +798,196 @@ sopno stopst;
 		return(NULL);
 }
 
+#ifdef CACHESTATES
+/*
+ - dfast - fast(), using and extending the DFA cache
+ == static RCHAR_T *dfast(register struct match *m, RCHAR_T *start, \
+ ==	RCHAR_T *stop, sopno startst, sopno stopst);
+ */
+static RCHAR_T *			/* where tentative match ended, or NULL */
+dfast(m, start, stop, startst, stopst)
+register struct match *m;
+RCHAR_T *start;
+RCHAR_T *stop;
+sopno startst;
+sopno stopst;
+{
+	register struct re_dfa *d = m->g->dfa;
+	register states st;
+	register states fresh;
+	register RCHAR_T *p = start;
+	register int c = (start == m->beginp) ? OUT : *(start-1);
+	register int lastc;	/* previous c */
+	register int flagch;
+	register int i;
+	register int ds;	/* DFA state of st, or -1 */
+	register int nds;	/* next DFA state */
+	register RCHAR_T *coldp;	/* last p after which no match was underway */
+
+	CLEAR(st);
+	SET1(st, startst);
+	st = step(m->g, startst, stopst, st, NOTHING, st);
+	ASSIGN(fresh, st);
+	ds = dfastate(d, st);
+	coldp = NULL;
+	for (;;) {
+		/* next character */
+		lastc = c;
+		c = (p == m->endp) ? OUT : *p;
+		if (EQ(st, fresh))
+			coldp = p;
+
+		/* is there an EOL and/or BOL between lastc and c? */
+		flagch = '\0';
+		i = 0;
+		if ( (lastc == '\n' && m->g->cflags&REG_NEWLINE) ||
+				(lastc == OUT && !(m->eflags&REG_NOTBOL)) ) {
+			flagch = BOL;
+			i = m->g->nbol;
+		}
+		if ( (c == '\n' && m->g->cflags&REG_NEWLINE) ||
+				(c == OUT && !(m->eflags&REG_NOTEOL)) ) {
+			flagch = (flagch == BOL) ? BOLEOL : EOL;
+			i += m->g->neol;
+		}
+		if (i != 0) {
+			for (; i > 0; i--)
+				st = step(m->g, startst, stopst, st, flagch, st);
+			ds = dfastate(d, st);
+		}
+
+		/* how about a word boundary? */
+		if (d->words) {
+			if ( (flagch == BOL || (lastc != OUT && !ISWORD(lastc))) &&
+						(c != OUT && ISWORD(c)) ) {
+				flagch = BOW;
+			}
+			if ( (lastc != OUT && ISWORD(lastc)) &&
+					(flagch == EOL || (c != OUT && !ISWORD(c))) ) {
+				flagch = EOW;
+			}
+			if (flagch == BOW || flagch == EOW) {
+				st = step(m->g, startst, stopst, st, flagch, st);
+				ds = dfastate(d, st);
+			}
+		}
+
+		/* are we done? */
+		if (ISSET(st, stopst) || p == stop)
+			break;		/* NOTE BREAK OUT */
+
+		/* no, we must deal with this character */
+		assert(c != OUT);
+		if (sizeof(RCHAR_T) != 1 && (unsigned)c >= NC) {
+			st = step(m->g, startst, stopst, st, c, fresh);
+			ds = dfastate(d, st);
+		} else if (ds >= 0 && (nds = d->trans[ds*NC + (uch)c]) >= 0) {
+			ds = nds;
+			st = d->sets[ds];
+		} else {
+			st = step(m->g, startst, stopst, st, c, fresh);
+			nds = dfastate(d, st);
+			if (ds >= 0)
+				d->trans[ds*NC + (uch)c] = nds;
+			ds = nds;
+		}
+		p++;
+	}
+
+	assert(coldp != NULL);
+	m->coldp = coldp;
+	if (ISSET(st, stopst))
+		return(p+1);
+	else
+		return(NULL);
+}
+
+/*
+ - dfainit - set up an empty DFA cache
+ == static int dfainit(register struct re_guts *g);
+ */
+static int			/* 0 success, -1 failure */
+dfainit(g)
+register struct re_guts *g;
+{
+	register struct re_dfa *d;
+	register sopno i;
+	register int n;
+
+	d = (struct re_dfa *)malloc(sizeof(struct re_dfa));
+	if (d == NULL)
+		return(-1);
+	d->nstates = 0;
+	d->nalloc = 8;
+	d->sets = (int *)malloc(d->nalloc * sizeof(int));
+	d->trans = (short *)malloc(d->nalloc * NC * sizeof(short));
+	if (d->sets == NULL || d->trans == NULL) {
+		if (d->sets != NULL)
+			free(d->sets);
+		if (d->trans != NULL)
+			free(d->trans);
+		free(d);
+		return(-1);
+	}
+	for (n = 0; n < d->nalloc * NC; n++)
+		d->trans[n] = -1;
+	for (n = 0; n < DFA_HSIZE; n++)
+		d->hash[n] = -1;
+	d->words = 0;
+	for (i = 0; i < g->nstates; i++)
+		if (OP(g->strip[i]) == OBOW || OP(g->strip[i]) == OEOW)
+			d->words = 1;
+	g->dfa = d;
+	return(0);
+}
+
+/*
+ - dfastate - find, or add, the DFA state for a set of strip states
+ == static int dfastate(register struct re_dfa *d, states st);
+ */
+static int			/* DFA state, or -1 if the cache is full */
+dfastate(d, st)
+register struct re_dfa *d;
+states st;
+{
+	register int h;
+	register int n;
+	register int *sets;
+	register short *trans;
+
+	for (h = ((unsigned)st * 2654435761U) % DFA_HSIZE;
+				(n = d->hash[h]) != -1; h = (h + 1) % DFA_HSIZE)
+		if (d->sets[n] == st)
+			return(n);
+
+	if (d->nstates == DFA_MAXSTATES)
+		return(-1);
+	if (d->nstates == d->nalloc) {
+		n = d->nalloc * 2;
+		sets = (int *)realloc(d->sets, n * sizeof(int));
+		if (sets == NULL)
+			return(-1);
+		d->sets = sets;
+		trans = (short *)realloc(d->trans, n * NC * sizeof(short));
+		if (trans == NULL)
+			return(-1);
+		d->trans = trans;
+		for (h = d->nalloc * NC; h < n * NC; h++)
+			trans[h] = -1;
+		d->nalloc = n;
+
+		/* find the free slot again */
+		for (h = ((unsigned)st * 2654435761U) % DFA_HSIZE;
+				d->hash[h] != -1; h = (h + 1) % DFA_HSIZE)
+			continue;
+	}
+	n = d->nstates++;
+	d->sets[n] = st;
+	d->hash[h] = n;
+	return(n);
+}
+#endif
+
 /*
  - slow - step through the string more deliberately
  == static RCHAR_T *slow(register struct match *m, RCHAR_T *start, \
@@ -118,6 +118,7 @@ static void dofwd __P((struct parse *p, sopno pos, sop value));
 static void enlarge __P((struct parse *p, sopno size));
 static void stripsnug __P((struct parse *p, struct re_guts *g));
 static void findmust __P((struct parse *p, struct re_guts *g));
+static int charrank __P((int c));
 static sopno pluscount __P((struct parse *p, struct re_guts *g));
 
 #ifdef __cplusplus
@@ -233,6 +234,8 @@ regcomp(regex_t *preg, const RCHAR_T *pattern, int cflags)
 	g->neol = 0;
 	g->must = NULL;
 	g->mlen = 0;
+	g->mrare = -1;
+	g->dfa = NULL;
 	g->nsub = 0;
 #if 0
 	g->ncategories = 1;	/* category 0 is "everything else" */
@@ -1541,6 +1544,7 @@ findmust(struct parse *p, register struct re_guts *g)
 	register sop s;
 	register RCHAR_T *cp;
 	register sopno i;
+	register int rank;
 
 	/* avoid making error situations worse */
 	if (p->error != 0)
@@ -1604,6 +1608,44 @@ findmust(struct parse *p, register struct re_guts *g)
 	}
 	assert(cp == g->must + g->mlen);
 	*cp++ = '\0';		/* just on general principles */
+
+	/*
+	 * Set up to find must quickly: the shifts for Boyer-Moore-Horspool,
+	 * hashed on the low byte of wide characters, and the rarest-looking
+	 * character, if it looks rare enough to scan for on its own.  A
+	 * single character is always scanned for; Boyer-Moore-Horspool
+	 * can't skip anything then.
+	 */
+	for (i = 0; i < NC; i++)
+		g->mskip[i] = g->mlen;
+	for (i = 0; i < g->mlen - 1; i++)
+		g->mskip[(uch)g->must[i]] = g->mlen - 1 - i;
+	g->mrare = -1;
+	for (i = g->mlen - 1, rank = g->mlen == 1 ? 0 : 1; i >= 0; i--)
+		if (charrank(g->must[i]) > rank) {
+			g->mrare = i;
+			rank = charrank(g->must[i]);
+		}
+
+	/* a RE that's nothing but its must string needs no engine */
+	if (g->nstates == g->mlen + 2)
+		g->iflags |= LITERAL;
+}
+
+/*
+ - charrank - guess how rare a character is in text, higher is rarer
+ == static int charrank(int c);
+ */
+static int
+charrank(int c)
+{
+	if (c == ' ' || c == '\t' || (c >= 'a' && c <= 'z'))
+		return(1);
+	if (c >= '0' && c <= '9')
+		return(2);
+	if ((c >= 'A' && c <= 'Z') || (c > ' ' && c < 0177))
+		return(3);
+	return(4);
 }
 
 /*
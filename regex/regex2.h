@@ -133,6 +133,25 @@ typedef struct {
 #define	MCsub(p, cs, cp)	mcsub(p, cs, cp)
 #define	MCin(p, cs, cp)	mcin(p, cs, cp)
 
+/*
+ * Cache of the deterministic automaton that fast() simulates, built up
+ * as the RE is used, so that a character costs a table lookup rather
+ * than a step through the strip.  Each DFA state is a set of strip
+ * states, in the small (bit vector) state representation; REs needing
+ * the large one don't use the cache.  Once DFA_MAXSTATES states exist,
+ * transitions to new ones are computed with step() as before.
+ */
+#define	DFA_MAXSTATES	128
+#define	DFA_HSIZE	(DFA_MAXSTATES*2)	/* power of 2 */
+struct re_dfa {
+	int nstates;		/* number of DFA states */
+	int nalloc;		/* number of DFA states allocated */
+	int words;		/* does the RE use word boundaries? */
+	int *sets;		/* -> int [nalloc] strip states of each */
+	short *trans;		/* -> short [nalloc][NC] next DFA state */
+	short hash[DFA_HSIZE];	/* DFA states hashed by strip states */
+};
+
 /* stuff for character categories */
 typedef RCHAR_T cat_t;
 
@@ -155,6 +174,7 @@ struct re_guts {
 #		define	USEBOL	01	/* used ^ */
 #		define	USEEOL	02	/* used $ */
 #		define	BAD	04	/* something wrong */
+#		define	LITERAL	010	/* RE is just the must string */
 	int nbol;		/* number of ^ used */
 	int neol;		/* number of $ used */
 #if 0
@@ -163,6 +183,9 @@ struct re_guts {
 #endif
 	RCHAR_T *must;		/* match must contain this string */
 	int mlen;		/* length of must */
+	int mrare;		/* index of rare char in must, or -1 */
+	int mskip[NC];		/* Boyer-Moore-Horspool shifts for must */
+	struct re_dfa *dfa;	/* DFA cache, built by regexec() */
 	size_t nsub;		/* copy of re_nsub */
 	int backrefs;		/* does it use back references? */
 	sopno nplus;		/* how deep does it nest +s? */
@@ -61,6 +61,52 @@ static char sccsid[] = "@(#)regexec.c	8.2 (Berkeley) 3/16/94";
 
 static int nope = 0;		/* for use in asserts; shuts lint up */
 
+static RCHAR_T *mfind __P((struct re_guts *g, RCHAR_T *start, RCHAR_T *stop));
+
+/*
+ - mfind - find the first instance of the must string, for prescreening
+ == static RCHAR_T *mfind(register struct re_guts *g, RCHAR_T *start, \
+ ==	RCHAR_T *stop);
+ *
+ * If the must string has a character that's likely to be rare, look for
+ * it with memchr(3), which is typically vectorized, and compare the rest
+ * of the string where it's found.  Otherwise, use Boyer-Moore-Horspool.
+ */
+static RCHAR_T *		/* NULL if not found */
+mfind(g, start, stop)
+register struct re_guts *g;
+RCHAR_T *start;
+RCHAR_T *stop;
+{
+	register RCHAR_T *dp;
+	register RCHAR_T *last;
+	register RCHAR_T c;
+	register int mlen = g->mlen;
+	register int r = g->mrare;
+
+	if (stop - start < mlen)
+		return(NULL);
+	last = stop - mlen;		/* last place it could start */
+
+	if (sizeof(RCHAR_T) == 1 && r >= 0) {
+		c = g->must[r];
+		for (dp = start + r;; dp++) {
+			dp = memchr(dp, c, (size_t)(last + r + 1 - dp));
+			if (dp == NULL)
+				return(NULL);
+			if (MEMCMP(dp - r, g->must, (size_t)mlen) == 0)
+				return(dp - r);
+		}
+	}
+
+	c = g->must[mlen - 1];
+	for (dp = start; dp <= last; dp += g->mskip[(uch)dp[mlen - 1]])
+		if (dp[mlen - 1] == c &&
+		    MEMCMP(dp, g->must, (size_t)mlen - 1) == 0)
+			return(dp);
+	return(NULL);
+}
+
 /* macros for manipulating states, small version */
 #define	states	int
 #define	states1	int		/* for later use in regexec() decision */
@@ -85,9 +131,12 @@ static int nope = 0;		/* for use in asserts; shuts lint up */
 #define	ISSETBACK(v, n)	((v) & ((unsigned)here >> (n)))
 /* function names */
 #define SNAMES			/* engine.c looks after details */
+#define	CACHESTATES		/* fast() uses the DFA cache */
 
 #include "engine.c"
 
+#undef	CACHESTATES
+
 /* now undo things */
 #undef	states
 #undef	CLEAR
@@ -43,6 +43,7 @@ static char sccsid[] = "@(#)regfree.c	8.2 (Berkeley) 3/16/94";
 
 #include <sys/types.h>
 #include <stdio.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <regex.h>
 
@@ -75,5 +76,10 @@ regfree(regex_t *preg)
 		free((char *)g->setbits);
 	if (g->must != NULL)
 		free(g->must);
+	if (g->dfa != NULL) {
+		free(g->dfa->sets);
+		free(g->dfa->trans);
+		free(g->dfa);
+	}
 	free((char *)g);
 }
@@ -89,6 +89,11 @@ v_screen_end(SCR *sp)
 		free(vip->rep);
 	if (vip->ps != NULL)
 		free(vip->ps);
+	vs_lfree(vip);
+	if (vip->rhash != NULL)
+		free(vip->rhash);
+	if (vip->rbuf != NULL)
+		free(vip->rbuf);
 
 	if (HMAP != NULL)
 		free(HMAP);
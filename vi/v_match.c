@@ -34,10 +34,12 @@ static const char sccsid[] = "$Id: v_match.c,v 10.10 2001/06/25 15:19:32 skimo E
 int
 v_match(SCR *sp, VICMD *vp)
 {
-	VCS cs;
 	MARK *mp;
+	db_recno_t lno;
+	dir_t dir;
 	size_t cno, len, off;
-	int cnt, isempty, matchc, startc, (*gc)__P((SCR *, VCS *));
+	long cnt;
+	int isempty, matchc, startc;
 	CHAR_T *p;
 
 	/*
@@ -61,35 +63,35 @@ nomatch:		msgq(sp, M_BERR, "184|No match character on this line");
 		switch (startc = p[off]) {
 		case '(':
 			matchc = ')';
-			gc = cs_next;
+			dir = FORWARD;
 			break;
 		case ')':
 			matchc = '(';
-			gc = cs_prev;
+			dir = BACKWARD;
 			break;
 		case '[':
 			matchc = ']';
-			gc = cs_next;
+			dir = FORWARD;
 			break;
 		case ']':
 			matchc = '[';
-			gc = cs_prev;
+			dir = BACKWARD;
 			break;
 		case '{':
 			matchc = '}';
-			gc = cs_next;
+			dir = FORWARD;
 			break;
 		case '}':
 			matchc = '{';
-			gc = cs_prev;
+			dir = BACKWARD;
 			break;
 		case '<':
 			matchc = '>';
-			gc = cs_next;
+			dir = FORWARD;
 			break;
 		case '>':
 			matchc = '<';
-			gc = cs_prev;
+			dir = BACKWARD;
 			break;
 		default:
 			continue;
@@ -97,30 +99,36 @@ nomatch:		msgq(sp, M_BERR, "184|No match character on this line");
 		break;
 	}
 
-	cs.cs_lno = vp->m_start.lno;
-	cs.cs_cno = off;
-	if (cs_init(sp, &cs))
-		return (1);
-	for (cnt = 1;;) {
-		if (gc(sp, &cs))
+	/*
+	 * Scan a line at a time, letting the motion index skip the lines
+	 * that can't hold the match.
+	 */
+	for (cnt = 1, lno = vp->m_start.lno;;) {
+		if (db_get(sp, lno, 0, &p, &len))
+			break;
+		if (dir == FORWARD) {
+			for (cno = lno == vp->m_start.lno ? off + 1 : 0;
+			    cno < len; ++cno)
+				if (p[cno] == startc)
+					++cnt;
+				else if (p[cno] == matchc && --cnt == 0)
+					goto found;
+		} else
+			for (cno = lno == vp->m_start.lno ? off : len; cno > 0;)
+				if (p[--cno] == startc)
+					++cnt;
+				else if (p[cno] == matchc && --cnt == 0)
+					goto found;
+		if (mindex_skip(sp, lno, dir, startc, &cnt, &lno))
 			return (1);
-		if (cs.cs_flags != 0) {
-			if (cs.cs_flags == CS_EOF || cs.cs_flags == CS_SOF)
-				break;
-			continue;
-		}
-		if (cs.cs_ch == startc)
-			++cnt;
-		else if (cs.cs_ch == matchc && --cnt == 0)
+		if (lno == OOBLNO)
 			break;
 	}
-	if (cnt) {
-		msgq(sp, M_BERR, "185|Matching character not found");
-		return (1);
-	}
+	msgq(sp, M_BERR, "185|Matching character not found");
+	return (1);
 
-	vp->m_stop.lno = cs.cs_lno;
-	vp->m_stop.cno = cs.cs_cno;
+found:	vp->m_stop.lno = lno;
+	vp->m_stop.cno = cno;
 
 	/*
 	 * If moving right, non-motion commands move to the end of the range.
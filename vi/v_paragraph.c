@@ -32,6 +32,7 @@ static const char sccsid[] = "$Id: v_paragraph.c,v 10.10 2001/06/25 15:19:32 ski
 		if (!--cnt)						\
 			goto found;					\
 		pstate = P_INBLANK;					\
+		continue;						\
 	}								\
 	/*								\
 	 * !!!								\
@@ -68,7 +69,7 @@ v_paragraphf(SCR *sp, VICMD *vp)
 {
 	enum { P_INTEXT, P_INBLANK } pstate;
 	size_t lastlen, len;
-	db_recno_t cnt, lastlno, lno;
+	db_recno_t cnt, lastlno, lno, nlno;
 	int isempty;
 	CHAR_T *p;
 	char *lp;
@@ -118,6 +119,14 @@ v_paragraphf(SCR *sp, VICMD *vp)
 	}
 
 	for (;;) {
+		/* Skip the lines that can't change the state. */
+		if (mindex_next(sp, lno, FORWARD,
+		    pstate == P_INTEXT ? MI_BLANK | MI_FF | MI_DOT : MI_TEXT,
+		    &nlno))
+			return (1);
+		if (nlno != lno + 1 &&
+		    db_get(sp, lno = nlno - 1, 0, &p, &len))
+			goto eof;
 		lastlno = lno;
 		lastlen = len;
 		if (db_get(sp, ++lno, 0, &p, &len))
@@ -270,7 +279,12 @@ v_paragraphb(SCR *sp, VICMD *vp)
 	}
 
 	for (;;) {
-		if (db_get(sp, --lno, 0, &p, &len))
+		/* Skip the lines that can't change the state. */
+		if (mindex_next(sp, lno, BACKWARD,
+		    pstate == P_INTEXT ? MI_BLANK | MI_FF | MI_DOT : MI_TEXT,
+		    &lno))
+			return (1);
+		if (db_get(sp, lno, 0, &p, &len))
 			goto sof;
 		switch (pstate) {
 		case P_INTEXT:
@@ -66,6 +66,7 @@ v_sectionf(SCR *sp, VICMD *vp)
 {
 	db_recno_t cnt, lno;
 	size_t len;
+	u_int mask;
 	CHAR_T *p;
 	char *list, *lp;
 
@@ -94,7 +95,13 @@ v_sectionf(SCR *sp, VICMD *vp)
 		}
 
 	cnt = F_ISSET(vp, VC_C1SET) ? vp->count : 1;
-	for (lno = vp->m_start.lno; !db_get(sp, ++lno, 0, &p, &len);) {
+	mask = MI_LBRACE | MI_FF | MI_DOT | (ISMOTION(vp) ? MI_RBRACE : 0);
+	for (lno = vp->m_start.lno;;) {
+		/* Skip the lines that can't start a section. */
+		if (mindex_next(sp, lno, FORWARD, mask, &lno))
+			return (1);
+		if (db_get(sp, lno, 0, &p, &len))
+			break;
 		if (len == 0)
 			continue;
 		if (p[0] == '{' || ISMOTION(vp) && p[0] == '}') {
@@ -187,7 +194,13 @@ v_sectionb(SCR *sp, VICMD *vp)
 		return (1);
 
 	cnt = F_ISSET(vp, VC_C1SET) ? vp->count : 1;
-	for (lno = vp->m_start.lno; !db_get(sp, --lno, 0, &p, &len);) {
+	for (lno = vp->m_start.lno;;) {
+		/* Skip the lines that can't start a section. */
+		if (mindex_next(sp,
+		    lno, BACKWARD, MI_LBRACE | MI_FF | MI_DOT, &lno))
+			return (1);
+		if (db_get(sp, lno, 0, &p, &len))
+			break;
 		if (len == 0)
 			continue;
 		if (p[0] == '{') {
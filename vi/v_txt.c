@@ -186,6 +186,7 @@ txt_map_end(SCR *sp)
 			for (cnt = sp->t_rows; cnt <= sp->t_maxrows; ++cnt) {
 				(void)sp->gp->scr_move(sp, cnt, 0);
 				(void)sp->gp->scr_clrtoeol(sp);
+				vs_rdamage(sp, cnt);
 			}
 			TMAP = HMAP + (sp->t_rows - 1);
 		} else
@@ -1994,12 +1995,12 @@ txt_fc(SCR *sp, TEXT *tp, int *redrawp)
 	CHAR_T s_ch;
 	EXCMD cmd;
 	size_t indx, len, nlen, off;
-	int argc, trydir;
+	int argc, istag, trydir;
 	CHAR_T *p, *t;
 	char *np;
 	size_t nplen;
 
-	trydir = 0;
+	istag = trydir = 0;
 	*redrawp = 0;
 
 	/*
@@ -2021,6 +2022,20 @@ retry:		for (len = 0,
 				break;
 		}
 
+	/*
+	 * If the word is the first argument of a tag command, complete tag
+	 * names from the tags files instead of file names.
+	 */
+	if (!trydir) {
+		for (t = tp->lb; t < p && (ISBLANK(*t) || *t == ':'); ++t);
+		for (nlen = 0; t + nlen < p && ISALPHA(t[nlen]); ++nlen);
+		if (nlen != 0 && ex_is_tag(sp, t, nlen)) {
+			for (t += nlen; t < p && *t == '!'; ++t);
+			for (off = 0; t + off < p && ISBLANK(t[off]); ++off);
+			istag = off != 0 && t + off == p;
+		}
+	}
+
 	/*
 	 * Get enough space for a wildcard character.
 	 *
@@ -2037,7 +2052,8 @@ retry:		for (len = 0,
 
 	/* Build an ex command, and call the ex expansion routines. */
 	ex_cinit(sp, &cmd, 0, 0, OOBLNO, OOBLNO, 0);
-	if (argv_exp2(sp, &cmd, p, len + 1)) {
+	if (istag ? ex_tag_complete(sp, &cmd, p, len) :
+	    argv_exp2(sp, &cmd, p, len + 1)) {
 		p[len] = s_ch;
 		return (0);
 	}
@@ -2060,7 +2076,7 @@ retry:		for (len = 0,
 		/* If haven't done a directory test, do it now. */
 		INT2CHAR(sp, cmd.argv[0]->bp, cmd.argv[0]->len + 1,
 			 np, nplen);
-		if (!trydir &&
+		if (!trydir && !istag &&
 		    !stat(np, &sb) && S_ISDIR(sb.st_mode)) {
 			p += len;
 			goto isdir;
@@ -2118,7 +2134,7 @@ retry:		for (len = 0,
 
 	/* If a single match and it's a directory, retry it. */
 	INT2CHAR(sp, cmd.argv[0]->bp, cmd.argv[0]->len + 1, np, nplen);
-	if (argc == 1 && !stat(np, &sb) && S_ISDIR(sb.st_mode)) {
+	if (argc == 1 && !istag && !stat(np, &sb) && S_ISDIR(sb.st_mode)) {
 isdir:		if (tp->owrite == 0) {
 			off = p - tp->lb;
 			BINC_RETW(sp, tp->lb, tp->lb_len, tp->len + 1);
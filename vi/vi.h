@@ -219,6 +219,55 @@ typedef enum { CNOTSET, FSEARCH, fSEARCH, TSEARCH, tSEARCH } cdir_t;
 typedef enum { AB_NOTSET, AB_NOTWORD, AB_INWORD } abb_t;
 typedef enum { Q_NOTSET, Q_BNEXT, Q_BTHIS, Q_VNEXT, Q_VTHIS } quote_t;
 
+/*
+ * VS_CKPT --
+ *	Where a screen line starts in a line, and the state of formatting
+ *	the line at that point.
+ */
+typedef struct _vs_ckpt {
+	size_t	 off;			/* 0-N: offset of the next character. */
+	size_t	 scno;			/* Screen column count. */
+	size_t	 curoff;		/* Column in the screen line. */
+} VS_CKPT;
+
+typedef struct _vs_ckpts {
+	VS_CKPT	*ck;			/* Checkpoints, one per screen line. */
+	size_t	 n;			/* Number of checkpoints. */
+	size_t	 blen;			/* Checkpoint buffer length. */
+} VS_CKPTS;
+
+/*
+ * VS_LAYOUT --
+ *	The layout of a line on the screen: the number of screen lines it
+ *	takes, and where each of them starts.  The routines that format lines
+ *	each have their own rules about characters that cross screen lines,
+ *	and so their own checkpoints.  Entries are keyed by line number, and
+ *	by the screen width and options they were built for.
+ */
+typedef struct _vs_layout {
+	db_recno_t lno;			/* 1-N: line, OOBLNO if unused. */
+	size_t	 cols;			/* Screen columns. */
+	u_long	 ts;			/* Tabstop. */
+	u_int8_t opts;			/* VSL_O_* options. */
+#define	VSL_O_LEFTRIGHT	0x01
+#define	VSL_O_LIST	0x02
+#define	VSL_O_NUMBER	0x04
+
+	size_t	 len;			/* Line length. */
+	size_t	 ncols;			/* vs_columns: line columns. */
+	size_t	 screens;		/* vs_screens: screen lines. */
+	VS_CKPTS c;			/* vs_columns checkpoints. */
+	VS_CKPTS l;			/* vs_line checkpoints. */
+	VS_CKPTS p;			/* vs_colpos checkpoints. */
+
+#define	VSL_COLUMNS	0x01		/* ncols, screens and c are valid. */
+#define	VSL_LINE	0x02		/* l is valid. */
+#define	VSL_COLPOS	0x04		/* p is valid. */
+	u_int8_t flags;
+} VS_LAYOUT;
+
+#define	VS_NLAYOUT	64		/* Layout cache entries, power of 2. */
+
 /* Vi private, per-screen memory. */
 typedef struct _vi_private {
 	VICMD	cmd;		/* Current command, motion. */
@@ -292,9 +341,16 @@ typedef struct _vi_private {
 #define	_TMAP(sp)	(VIP(sp)->t_smap)
 #define	TMAP		_TMAP(sp)
 
-	db_recno_t	ss_lno;	/* 1-N: vi_opt_screens cached line number. */
-	size_t	ss_screens;	/* vi_opt_screens cached return value. */
-#define	VI_SCR_CFLUSH(vip)	vip->ss_lno = OOBLNO
+	VS_LAYOUT *layout;	/* Line layout cache. */
+#define	VI_SCR_CFLUSH(vip)	vs_lflush(vip)
+
+	u_int32_t *rhash;	/* Hashes of the painted rows, 0 if unknown. */
+	size_t	rh_rows;	/* Rows, offsets, columns they're good for. */
+	size_t	rh_roff;
+	size_t	rh_coff;
+	size_t	rh_cols;
+	CHAR_T	*rbuf;		/* Row being painted. */
+	size_t	rblen;
 
 	size_t	srows;		/* 1-N: rows in the terminal/window. */
 	db_recno_t	olno;		/* 1-N: old cursor file line. */
@@ -20,6 +20,7 @@ static const char sccsid[] = "$Id: vs_line.c,v 10.38 2002/01/19 21:59:07 skimo E
 #include <bitstring.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../common/common.h"
@@ -31,6 +32,9 @@ static const char sccsid[] = "$Id: vs_line.c,v 10.38 2002/01/19 21:59:07 skimo E
 #define	TABCH	' '
 #endif
 
+static u_int32_t  vs_rhash __P((u_int32_t, const void *, size_t));
+static u_int32_t *vs_rslot __P((SCR *, size_t));
+
 /*
  * vs_line --
  *	Update one line on the screen.
@@ -40,17 +44,20 @@ static const char sccsid[] = "$Id: vs_line.c,v 10.38 2002/01/19 21:59:07 skimo E
 int
 vs_line(SCR *sp, SMAP *smp, size_t *yp, size_t *xp)
 {
-	char *kp;
+	char *kp, *mp;
 	GS *gp;
 	SMAP *tsmp;
-	size_t chlen, cno_cnt, cols_per_screen, len, nlen;
+	VI_PRIVATE *vip;
+	size_t chlen, cno_cnt, cols_per_screen, len, mlen, nlen, rlen;
 	size_t offset_in_char, offset_in_line, oldx, oldy;
 	size_t scno, skip_cols, skip_screens;
-	int dne, is_cached, is_partial, is_tab, no_draw;
+	u_int32_t h, *rhp;
+	int clr, dne, is_cached, is_partial, is_tab, no_draw;
 	int list_tab, list_dollar;
 	CHAR_T *p;
 	CHAR_T *cbp, *ecbp, cbuf[128];
 	CHAR_T ch;
+	char nbuf[32];
 
 #if defined(DEBUG) && 0
 	vtrace(sp, "vs_line: row %u: line: %u off: %u\n",
@@ -87,9 +94,18 @@ vs_line(SCR *sp, SMAP *smp, size_t *yp, size_t *xp)
 	 * return to whereever we started from.
 	 */
 	gp = sp->gp;
+	vip = VIP(sp);
 	(void)gp->scr_cursor(sp, &oldy, &oldx);
 	(void)gp->scr_move(sp, smp - HMAP, 0);
 
+	/*
+	 * The row is built up in pieces, the line number, a marker for
+	 * empty lines, the text and whether the rest of the row is cleared,
+	 * and only written once it's complete; see vs_rslot().
+	 */
+	mp = NULL;
+	clr = mlen = nlen = rlen = 0;
+
 	/* Get the line. */
 	dne = db_get(sp, smp->lno, 0, &p, &len);
 
@@ -137,11 +153,9 @@ vs_line(SCR *sp, SMAP *smp, size_t *yp, size_t *xp)
 		 */
 		if (O_ISSET(sp, O_NUMBER)) {
 			cols_per_screen -= O_NUMBER_LENGTH;
-			if ((!dne || smp->lno == 1) && skip_cols == 0) {
-				nlen = snprintf((char*)cbuf,
-				    sizeof(cbuf), O_NUMBER_FMT, smp->lno);
-				(void)gp->scr_addstr(sp, (char*)cbuf, nlen);
-			}
+			if ((!dne || smp->lno == 1) && skip_cols == 0)
+				nlen = snprintf(nbuf,
+				    sizeof(nbuf), O_NUMBER_FMT, smp->lno);
 		}
 	}
 
@@ -183,13 +197,12 @@ vs_line(SCR *sp, SMAP *smp, size_t *yp, size_t *xp)
 			} else
 				if (list_dollar) {
 					ch = L('$');
-empty:					(void)gp->scr_addstr(sp,
-					    KEY_NAME(sp, ch), KEY_LEN(sp, ch));
+empty:					mp = KEY_NAME(sp, ch);
+					mlen = KEY_LEN(sp, ch);
 				}
 
-		(void)gp->scr_clrtoeol(sp);
-		(void)gp->scr_move(sp, oldy, oldx);
-		return (0);
+		clr = 1;
+		goto paint;
 	}
 
 	/* If we shortened this line in another screen, the cursor
@@ -256,6 +269,18 @@ empty:					(void)gp->scr_addstr(sp,
 		goto display;
 	}
 
+	/* Test to see if the line's layout is cached. */
+	if (!vs_lstart(sp,
+	    smp->lno, skip_screens, &offset_in_line, &offset_in_char)) {
+		smp->c_sboff = offset_in_line;
+		smp->c_scoff = offset_in_char;
+		p = &p[offset_in_line];
+
+		/* Set cols_per_screen to 2nd and later line length. */
+		cols_per_screen = sp->cols;
+		goto display;
+	}
+
 	scno = 0;
 	offset_in_line = 0;
 	offset_in_char = 0;
@@ -407,8 +432,9 @@ display:
 			continue;
 
 #define	FLUSH {								\
-	*cbp = '\0';							\
-	(void)gp->scr_waddstr(sp, cbuf, cbp - cbuf);			\
+	BINC_RETW(sp, vip->rbuf, vip->rblen, rlen + (cbp - cbuf));	\
+	MEMCPYW(vip->rbuf + rlen, cbuf, cbp - cbuf);			\
+	rlen += cbp - cbuf;						\
 	cbp = cbuf;							\
 }
 		/*
@@ -469,17 +495,159 @@ display:
 
 		/* If still didn't paint the whole line, clear the rest. */
 		if (scno < cols_per_screen)
-			(void)gp->scr_clrtoeol(sp);
+			clr = 1;
 	}
 
 	/* Flush any buffered characters. */
 	if (cbp > cbuf)
 		FLUSH;
 
+	/*
+	 * Write the row, unless the screen already shows exactly this.  If
+	 * we're here for the cursor, the row is already correct or isn't
+	 * ours to paint, and it's written as before but no longer trusted.
+	 */
+paint:	if ((rhp = vs_rslot(sp, smp - HMAP)) != NULL) {
+		h = 2166136261U;
+		h = vs_rhash(h, nbuf, nlen);
+		h = vs_rhash(h, mp, mlen);
+		h = vs_rhash(h, vip->rbuf, rlen * sizeof(CHAR_T));
+		h = vs_rhash(h, &clr, sizeof(clr));
+		if (h == 0)
+			h = 1;
+		if (is_cached || no_draw)
+			*rhp = 0;
+		else if (*rhp == h)
+			goto ret1;
+		else
+			*rhp = h;
+	}
+	if (nlen != 0)
+		(void)gp->scr_addstr(sp, nbuf, nlen);
+	if (mlen != 0)
+		(void)gp->scr_addstr(sp, mp, mlen);
+	if (rlen != 0)
+		(void)gp->scr_waddstr(sp, vip->rbuf, rlen);
+	if (clr)
+		(void)gp->scr_clrtoeol(sp);
+
 ret1:	(void)gp->scr_move(sp, oldy, oldx);
 	return (0);
 }
 
+/*
+ * vs_rhash --
+ *	Add bytes to a row's hash (FNV-1a).
+ */
+static u_int32_t
+vs_rhash(u_int32_t h, const void *p, size_t len)
+{
+	const u_char *s;
+
+	for (s = p; len > 0; --len)
+		h = (h ^ *s++) * 16777619;
+	return (h);
+}
+
+/*
+ * vs_rslot --
+ *	Return the place to record what a screen row holds, NULL if the row
+ *	isn't tracked.
+ *
+ * vs_line() keeps a hash of each row it writes, and doesn't write a row
+ * again when the hash is unchanged, so repainting a screen only costs the
+ * rows that are actually different.  Anything else that writes a row has
+ * to forget it with vs_rdamage(), or move it with vs_rscroll().  The info
+ * line is shared with messages and the colon command line, and is never
+ * tracked.  The hashes are for one screen geometry, and are discarded if
+ * the screen is moved or resized.
+ */
+static u_int32_t *
+vs_rslot(SCR *sp, size_t row)
+{
+	VI_PRIVATE *vip;
+
+	vip = VIP(sp);
+	if (row >= LASTLINE(sp))
+		return (NULL);
+	if (vip->rh_rows != sp->rows || vip->rh_roff != sp->roff ||
+	    vip->rh_coff != sp->coff || vip->rh_cols != sp->cols) {
+		if (vip->rhash != NULL)
+			free(vip->rhash);
+		vip->rh_rows = 0;
+		CALLOC_NOMSG(sp, vip->rhash, u_int32_t *,
+		    sp->rows, sizeof(u_int32_t));
+		if (vip->rhash == NULL)
+			return (NULL);
+		vip->rh_rows = sp->rows;
+		vip->rh_roff = sp->roff;
+		vip->rh_coff = sp->coff;
+		vip->rh_cols = sp->cols;
+	}
+	return (vip->rhash + row);
+}
+
+/*
+ * vs_rdamage --
+ *	Forget what a screen row holds, it was written by someone other
+ *	than vs_line().
+ *
+ * PUBLIC: void vs_rdamage __P((SCR *, size_t));
+ */
+void
+vs_rdamage(SCR *sp, size_t row)
+{
+	VI_PRIVATE *vip;
+
+	vip = VIP(sp);
+	if (row < vip->rh_rows)
+		vip->rhash[row] = 0;
+}
+
+/*
+ * vs_rscroll --
+ *	Move what the screen rows hold when the row is deleted (the rows
+ *	below it move up) or a row is inserted (the rows below it move
+ *	down), in both cases leaving the info line in place.
+ *
+ * PUBLIC: void vs_rscroll __P((SCR *, size_t, int));
+ */
+void
+vs_rscroll(SCR *sp, size_t row, int isdelete)
+{
+	VI_PRIVATE *vip;
+	size_t last;
+
+	vip = VIP(sp);
+	if (vip->rh_rows == 0 || row >= (last = LASTLINE(sp)))
+		return;
+	if (isdelete) {
+		memmove(vip->rhash + row, vip->rhash + row + 1,
+		    (last - row - 1) * sizeof(u_int32_t));
+		vip->rhash[last - 1] = 0;
+	} else {
+		memmove(vip->rhash + row + 1, vip->rhash + row,
+		    (last - row - 1) * sizeof(u_int32_t));
+		vip->rhash[row] = 0;
+	}
+}
+
+/*
+ * vs_rflush --
+ *	Forget what all of the screen rows hold.
+ *
+ * PUBLIC: void vs_rflush __P((SCR *));
+ */
+void
+vs_rflush(SCR *sp)
+{
+	VI_PRIVATE *vip;
+
+	vip = VIP(sp);
+	if (vip->rh_rows != 0)
+		memset(vip->rhash, 0, vip->rh_rows * sizeof(u_int32_t));
+}
+
 /*
  * vs_number --
  *	Repaint the numbers on all the lines.
@@ -534,6 +702,7 @@ vs_number(SCR *sp)
 		(void)gp->scr_move(sp, smp - HMAP, 0);
 		len = snprintf(nbuf, sizeof(nbuf), O_NUMBER_FMT, smp->lno);
 		(void)gp->scr_addstr(sp, nbuf, len);
+		vs_rdamage(sp, smp - HMAP);
 	}
 	(void)gp->scr_move(sp, oldy, oldx);
 	return (0);
@@ -427,6 +427,7 @@ vs_output(SCR *sp, mtype_t mtype, const char *line, int llen)
 					    LASTLINE(sp) - 1, 0);
 					(void)gp->scr_clrtoeol(sp);
 					(void)vs_divider(sp);
+					vs_rdamage(sp, LASTLINE(sp) - 1);
 					F_SET(vip, VIP_DIVIDER);
 					++vip->totalcount;
 					++vip->linecount;
@@ -750,6 +751,7 @@ vs_scroll(SCR *sp, int *continuep, sw_t wtype)
 {
 	GS *gp;
 	VI_PRIVATE *vip;
+	size_t row;
 
 	gp = sp->gp;
 	vip = VIP(sp);
@@ -759,9 +761,11 @@ vs_scroll(SCR *sp, int *continuep, sw_t wtype)
 		 * delete the line above the first line output so preserve the
 		 * maximum amount of the screen.
 		 */
-		(void)gp->scr_move(sp, vip->totalcount <
-		    sp->rows ? LASTLINE(sp) - vip->totalcount : 0, 0);
+		row = vip->totalcount <
+		    sp->rows ? LASTLINE(sp) - vip->totalcount : 0;
+		(void)gp->scr_move(sp, row, 0);
 		(void)gp->scr_deleteln(sp);
+		vs_rscroll(sp, row, 1);
 
 		/* If there are screens below us, push them back into place. */
 		if (sp->q.cqe_next != (void *)&sp->wp->scrq) {
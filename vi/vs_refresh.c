@@ -158,6 +158,13 @@ vs_paint(SCR *sp, u_int flags)
 	vip = VIP(sp);
 	didpaint = leftright_warp = 0;
 
+	/*
+	 * If the screen image is wrong or ex wrote over it, don't trust
+	 * what vs_line() thinks is in the rows.
+	 */
+	if (F_ISSET(sp, SC_SCR_REDRAW) || F_ISSET(vip, VIP_N_EX_PAINT))
+		vs_rflush(sp);
+
 	/*
 	 * 5: Reformat the lines.
 	 *
@@ -251,6 +258,7 @@ small_fill:			(void)gp->scr_move(sp, LASTLINE(sp), 0);
 				    --sp->t_rows, --TMAP) {
 					(void)gp->scr_move(sp, TMAP - HMAP, 0);
 					(void)gp->scr_clrtoeol(sp);
+					vs_rdamage(sp, TMAP - HMAP);
 				}
 				if (vs_sm_fill(sp, LNO, P_FILL))
 					return (1);
@@ -313,8 +321,12 @@ small_fill:			(void)gp->scr_move(sp, LASTLINE(sp), 0);
 		/*
 		 * If less than a half screen from the bottom of the file,
 		 * put the last line of the file on the bottom of the screen.
+		 * Don't look for the last line if there are more than half
+		 * a screen of lines after this one.
 		 */
-bottom:		if (db_last(sp, &lastline))
+bottom:		if (db_exist(sp, LNO + HALFTEXT(sp)))
+			goto middle;
+		if (db_last(sp, &lastline))
 			return (1);
 		tmp.lno = LNO;
 		tmp.coff = HMAP->coff;
@@ -651,6 +663,7 @@ paint:	for (smp = HMAP; smp <= TMAP; ++smp)
 		for (cnt = sp->t_rows; cnt <= sp->t_maxrows; ++cnt) {
 			(void)gp->scr_move(sp, cnt, 0);
 			(void)gp->scr_clrtoeol(sp);
+			vs_rdamage(sp, cnt);
 		}
 
 	didpaint = 1;
@@ -20,11 +20,23 @@ static const char sccsid[] = "$Id: vs_relative.c,v 10.18 2001/07/08 13:02:48 ski
 #include <bitstring.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../common/common.h"
 #include "vi.h"
 
+/* Screen lines needed for a number of columns, at least one. */
+#define	VS_SCREENS(sp, n)						\
+	((n) == 0 ? 1 : (n) / (sp)->cols + ((n) % (sp)->cols ? 1 : 0))
+
+static VS_CKPT	 *vs_ckfind __P((VS_CKPTS *, size_t));
+static int	  vs_ckadd __P((SCR *, VS_CKPTS *, size_t, size_t, size_t));
+static VS_LAYOUT *vs_layout __P((SCR *, db_recno_t, u_int));
+static int	  vs_lcolpos __P((SCR *, VS_LAYOUT *, CHAR_T *, size_t));
+static int	  vs_lcolumns __P((SCR *, VS_LAYOUT *, CHAR_T *, size_t));
+static int	  vs_lline __P((SCR *, VS_LAYOUT *, CHAR_T *, size_t));
+
 /*
  * vs_column --
  *	Return the logical column of the cursor in the line.
@@ -55,7 +67,8 @@ vs_column(SCR *sp, size_t *colp)
 size_t
 vs_screens(SCR *sp, db_recno_t lno, size_t *cnop)
 {
-	size_t cols, screens;
+	VS_LAYOUT *lp;
+	size_t cols;
 
 	/* Left-right screens are simple, it's always 1. */
 	if (O_ISSET(sp, O_LEFTRIGHT))
@@ -68,24 +81,14 @@ vs_screens(SCR *sp, db_recno_t lno, size_t *cnop)
 	 * one.
 	 */
 	if (cnop == NULL) {
-		if (VIP(sp)->ss_lno == lno)
-			return (VIP(sp)->ss_screens);
+		if ((lp = vs_layout(sp, lno, VSL_COLUMNS)) != NULL)
+			return (lp->screens);
 	} else if (*cnop == 0)
 		return (1);
 
 	/* Figure out how many columns the line/column needs. */
 	cols = vs_columns(sp, NULL, lno, cnop, NULL);
-
-	screens = (cols / sp->cols + (cols % sp->cols ? 1 : 0));
-	if (screens == 0)
-		screens = 1;
-
-	/* Cache the value. */
-	if (cnop == NULL) {
-		VIP(sp)->ss_lno = lno;
-		VIP(sp)->ss_screens = screens;
-	}
-	return (screens);
+	return (VS_SCREENS(sp, cols));
 }
 
 /*
@@ -98,10 +101,26 @@ vs_screens(SCR *sp, db_recno_t lno, size_t *cnop)
 size_t
 vs_columns(SCR *sp, CHAR_T *lp, db_recno_t lno, size_t *cnop, size_t *diffp)
 {
+	VS_CKPT *ck;
+	VS_LAYOUT *ly;
 	size_t chlen, cno, curoff, last, len, scno;
 	int ch, leftright, listset;
 	CHAR_T *p;
 
+	/*
+	 * Lines in the file have a cached layout.  The line's columns are
+	 * simple, a column within the line is found from the start of its
+	 * screen line.
+	 */
+	ly = NULL;
+	if (lp == NULL && diffp == NULL &&
+	    (ly = vs_layout(sp, lno, VSL_COLUMNS)) != NULL) {
+		if (cnop == NULL)
+			return (ly->ncols);
+		if (*cnop >= ly->len)
+			ly = NULL;
+	}
+
 	/*
 	 * Initialize the screen offset.
 	 */
@@ -134,6 +153,13 @@ done:		if (diffp != NULL)		/* XXX */
 	 */
 	p = lp;
 	curoff = 0;
+	cno = cnop == NULL ? 0 : *cnop;
+	if (ly != NULL && (ck = vs_ckfind(&ly->c, cno)) != NULL) {
+		p += ck->off;
+		cno -= ck->off;
+		scno = ck->scno;
+		curoff = ck->curoff;
+	}
 
 	/* Macro to return the display length of any signal character. */
 #define	CHLEN(val) (ch = *(UCHAR_T *)p++) == '\t' &&			\
@@ -163,7 +189,7 @@ done:		if (diffp != NULL)		/* XXX */
 			TAB_RESET;
 		}
 	else
-		for (cno = *cnop;; --cno) {
+		for (;; --cno) {
 			chlen = CHLEN(curoff);
 			last = scno;
 			scno += chlen;
@@ -223,6 +249,8 @@ vs_rcm(SCR *sp, db_recno_t lno, int islast)
 size_t
 vs_colpos(SCR *sp, db_recno_t lno, size_t cno)
 {
+	VS_CKPT *ck;
+	VS_LAYOUT *ly;
 	size_t chlen, curoff, len, llen, off, scno;
 	int ch, leftright, listset;
 	CHAR_T *lp, *p;
@@ -241,7 +269,21 @@ vs_colpos(SCR *sp, db_recno_t lno, size_t cno)
 	/* Discard screen (logical) lines. */
 	off = cno / sp->cols;
 	cno %= sp->cols;
-	for (scno = 0, p = lp, len = llen; off--;) {
+	scno = 0;
+	p = lp;
+	len = llen;
+
+	/* Start at the screen line, if the line's layout is cached. */
+	if (off != 0 && (ly = vs_layout(sp, lno, VSL_COLPOS)) != NULL) {
+		if (off > ly->p.n)
+			return (llen - 1);
+		ck = ly->p.ck + off - 1;
+		scno = ck->scno;
+		p += ck->off;
+		len -= ck->off;
+		off = 0;
+	}
+	while (off--) {
 		for (; len && scno < sp->cols; --len)
 			scno += CHLEN(scno);
 
@@ -292,3 +334,294 @@ vs_colpos(SCR *sp, db_recno_t lno, size_t cno)
 	/* No such character; return the start of the last character. */
 	return (llen - 1);
 }
+
+/*
+ * vs_lstart --
+ *	Return where vs_line() starts displaying a screen line of a folded
+ *	line: the offset of the first character, and how many of its columns
+ *	were displayed on the screen line before.  Return 1 if the line isn't
+ *	cached, or doesn't have that many screen lines.
+ *
+ * PUBLIC: int vs_lstart __P((SCR *, db_recno_t, size_t, size_t *, size_t *));
+ */
+int
+vs_lstart(SCR *sp, db_recno_t lno, size_t skip, size_t *offp, size_t *coffp)
+{
+	VS_CKPT *ck;
+	VS_LAYOUT *ly;
+
+	if (skip == 0 || O_ISSET(sp, O_LEFTRIGHT) ||
+	    (ly = vs_layout(sp, lno, VSL_LINE)) == NULL || skip > ly->l.n)
+		return (1);
+	ck = ly->l.ck + skip - 1;
+	*offp = ck->off;
+	*coffp = ck->curoff;
+	return (0);
+}
+
+/*
+ * vs_lchange --
+ *	Discard the cached layouts of a range of changed lines.  Inserting
+ *	or deleting lines changes the numbers of all of the lines after them.
+ *
+ * PUBLIC: void vs_lchange __P((SCR *, db_recno_t, db_recno_t));
+ */
+void
+vs_lchange(SCR *sp, db_recno_t start, db_recno_t stop)
+{
+	VS_LAYOUT *ly;
+	size_t cnt;
+
+	if (VIP(sp) == NULL || (ly = VIP(sp)->layout) == NULL)
+		return;
+	if (start == stop) {
+		ly += start & (VS_NLAYOUT - 1);
+		if (ly->lno == start)
+			ly->lno = OOBLNO;
+		return;
+	}
+	for (cnt = VS_NLAYOUT; cnt-- > 0; ++ly)
+		if (ly->lno >= start && ly->lno <= stop)
+			ly->lno = OOBLNO;
+}
+
+/*
+ * vs_lflush --
+ *	Discard all of the cached layouts.
+ *
+ * PUBLIC: void vs_lflush __P((VI_PRIVATE *));
+ */
+void
+vs_lflush(VI_PRIVATE *vip)
+{
+	VS_LAYOUT *ly;
+	size_t cnt;
+
+	if ((ly = vip->layout) != NULL)
+		for (cnt = VS_NLAYOUT; cnt-- > 0; ++ly)
+			ly->lno = OOBLNO;
+}
+
+/*
+ * vs_lfree --
+ *	Free the layout cache.
+ *
+ * PUBLIC: void vs_lfree __P((VI_PRIVATE *));
+ */
+void
+vs_lfree(VI_PRIVATE *vip)
+{
+	VS_LAYOUT *ly;
+	size_t cnt;
+
+	if ((ly = vip->layout) == NULL)
+		return;
+	for (cnt = VS_NLAYOUT; cnt-- > 0; ++ly) {
+		if (ly->c.ck != NULL)
+			free(ly->c.ck);
+		if (ly->l.ck != NULL)
+			free(ly->l.ck);
+		if (ly->p.ck != NULL)
+			free(ly->p.ck);
+	}
+	free(vip->layout);
+	vip->layout = NULL;
+}
+
+/*
+ * vs_layout --
+ *	Return the cached layout of a line, building the parts of it that
+ *	the caller wants.  Return NULL if the line can't be cached.
+ */
+static VS_LAYOUT *
+vs_layout(SCR *sp, db_recno_t lno, u_int which)
+{
+	VI_PRIVATE *vip;
+	VS_LAYOUT *ly;
+	size_t len;
+	u_int8_t opts;
+	CHAR_T *p;
+
+	/* Lines being input aren't in the file. */
+	if (F_ISSET(sp, SC_TINPUT | SC_TINPUT_INFO))
+		return (NULL);
+
+	vip = VIP(sp);
+	if (vip->layout == NULL) {
+		CALLOC_NOMSG(sp,
+		    vip->layout, VS_LAYOUT *, VS_NLAYOUT, sizeof(VS_LAYOUT));
+		if (vip->layout == NULL)
+			return (NULL);
+	}
+
+	opts = (O_ISSET(sp, O_LEFTRIGHT) ? VSL_O_LEFTRIGHT : 0) |
+	    (O_ISSET(sp, O_LIST) ? VSL_O_LIST : 0) |
+	    (O_ISSET(sp, O_NUMBER) ? VSL_O_NUMBER : 0);
+	ly = vip->layout + (lno & (VS_NLAYOUT - 1));
+	if (ly->lno != lno || ly->cols != sp->cols ||
+	    ly->ts != O_VAL(sp, O_TABSTOP) || ly->opts != opts) {
+		ly->lno = OOBLNO;
+		ly->flags = 0;
+	}
+	if ((ly->flags & which) == which)
+		return (ly);
+
+	if (db_get(sp, lno, 0, &p, &len))
+		return (NULL);
+	ly->lno = lno;
+	ly->cols = sp->cols;
+	ly->ts = O_VAL(sp, O_TABSTOP);
+	ly->opts = opts;
+	ly->len = len;
+
+	if (which & VSL_COLUMNS && !(ly->flags & VSL_COLUMNS) &&
+	    vs_lcolumns(sp, ly, p, len))
+		goto err;
+	if (which & VSL_LINE && !(ly->flags & VSL_LINE) &&
+	    vs_lline(sp, ly, p, len))
+		goto err;
+	if (which & VSL_COLPOS && !(ly->flags & VSL_COLPOS) &&
+	    vs_lcolpos(sp, ly, p, len))
+		goto err;
+	ly->flags |= which;
+	return (ly);
+
+err:	ly->lno = OOBLNO;
+	return (NULL);
+}
+
+/*
+ * vs_lcolumns --
+ *	Build the vs_columns() layout of a line: format the line as it does,
+ *	noting the state at the start of each screen line.
+ */
+static int
+vs_lcolumns(SCR *sp, VS_LAYOUT *ly, CHAR_T *lp, size_t len)
+{
+	size_t chlen, curoff, scno;
+	int ch, leftright, listset;
+	CHAR_T *p;
+
+	ly->c.n = 0;
+	scno = O_ISSET(sp, O_NUMBER) ? O_NUMBER_LENGTH : 0;
+	if (len != 0) {
+		listset = O_ISSET(sp, O_LIST);
+		leftright = O_ISSET(sp, O_LEFTRIGHT);
+		for (p = lp, curoff = 0; len--;) {
+			chlen = CHLEN(curoff);
+			scno += chlen;
+			if ((curoff += chlen) < sp->cols || leftright)
+				continue;
+			if (ch == '\t') {
+				curoff = 0;
+				scno -= scno % sp->cols;
+			} else
+				curoff -= sp->cols;
+			if (vs_ckadd(sp, &ly->c, p - lp, scno, curoff))
+				return (1);
+		}
+		if (listset)
+			scno += KEY_LEN(sp, '$');
+	}
+	ly->ncols = scno;
+	ly->screens = VS_SCREENS(sp, scno);
+	return (0);
+}
+
+/*
+ * vs_lline --
+ *	Build the vs_line() layout of a line: format the line as it does,
+ *	noting where each screen line after the first starts.
+ */
+static int
+vs_lline(SCR *sp, VS_LAYOUT *ly, CHAR_T *p, size_t len)
+{
+	size_t chlen, cols_per_screen, off, scno;
+	int list_tab;
+	CHAR_T ch;
+
+	ly->l.n = 0;
+	list_tab = O_ISSET(sp, O_LIST);
+	cols_per_screen = sp->cols;
+	if (O_ISSET(sp, O_NUMBER))
+		cols_per_screen -= O_NUMBER_LENGTH;
+	for (scno = 0, off = 0; off < len; ++off) {
+		chlen = (ch = p[off]) == L('\t') && !list_tab ?
+		    TAB_OFF(scno) : KEY_COL(sp, ch);
+		if ((scno += chlen) < cols_per_screen)
+			continue;
+		scno -= cols_per_screen;
+		cols_per_screen = sp->cols;
+		if (scno != 0 ? vs_ckadd(sp, &ly->l, off, 0, chlen - scno) :
+		    vs_ckadd(sp, &ly->l, off + 1, 0, 0))
+			return (1);
+	}
+	return (0);
+}
+
+/*
+ * vs_lcolpos --
+ *	Build the vs_colpos() layout of a line: discard screen lines as it
+ *	does, noting the state after each one.
+ */
+static int
+vs_lcolpos(SCR *sp, VS_LAYOUT *ly, CHAR_T *lp, size_t len)
+{
+	size_t scno;
+	int ch, leftright, listset;
+	CHAR_T *p;
+
+	ly->p.n = 0;
+	listset = O_ISSET(sp, O_LIST);
+	leftright = O_ISSET(sp, O_LEFTRIGHT);
+	for (scno = 0, p = lp;;) {
+		for (; len && scno < sp->cols; --len)
+			scno += CHLEN(scno);
+		if (len == 0)
+			return (0);
+		if (leftright && ch == '\t')
+			scno = 0;
+		else
+			scno -= sp->cols;
+		if (vs_ckadd(sp, &ly->p, p - lp, scno, 0))
+			return (1);
+	}
+	/* NOTREACHED */
+}
+
+/*
+ * vs_ckadd --
+ *	Add a checkpoint.
+ */
+static int
+vs_ckadd(SCR *sp, VS_CKPTS *ckp, size_t off, size_t scno, size_t curoff)
+{
+	VS_CKPT *ck;
+
+	BINC_RET(sp, VS_CKPT,
+	    ckp->ck, ckp->blen, (ckp->n + 1) * sizeof(VS_CKPT));
+	ck = ckp->ck + ckp->n++;
+	ck->off = off;
+	ck->scno = scno;
+	ck->curoff = curoff;
+	return (0);
+}
+
+/*
+ * vs_ckfind --
+ *	Return the last checkpoint at or before a character, if any.
+ */
+static VS_CKPT *
+vs_ckfind(VS_CKPTS *ckp, size_t cno)
+{
+	size_t base, idx, lim;
+
+	for (base = 0, lim = ckp->n; lim != 0; lim >>= 1) {
+		idx = base + (lim >> 1);
+		if (ckp->ck[idx].off <= cno) {
+			base = idx + 1;
+			--lim;
+		}
+	}
+	return (base == 0 ? NULL : ckp->ck + base - 1);
+}
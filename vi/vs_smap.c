@@ -111,10 +111,9 @@ vs_change(SCR *sp, db_recno_t lno, lnop_t op)
 	F_SET(vip, VIP_N_REFRESH);
 
 	/*
-	 * Invalidate the line size cache, and invalidate the cursor if it's
-	 * on this line,
+	 * Invalidate the cursor if it's on this line.  The line's cached
+	 * layout was discarded when the line changed, see scr_update().
 	 */
-	VI_SCR_CFLUSH(vip);
 	if (sp->lno == lno)
 		F_SET(vip, VIP_CUR_INVALID);
 
@@ -159,6 +158,26 @@ vs_change(SCR *sp, db_recno_t lno, lnop_t op)
 	return (0);
 }
 
+/*
+ * vs_change_range --
+ *	Make a change to the screen for a range of replaced lines.
+ *
+ * PUBLIC: int vs_change_range __P((SCR *, db_recno_t, db_recno_t));
+ */
+int
+vs_change_range(SCR *sp, db_recno_t start, db_recno_t stop)
+{
+	/* Only the lines in the map need repainting. */
+	if (start < HMAP->lno)
+		start = HMAP->lno;
+	if (stop > TMAP->lno)
+		stop = TMAP->lno;
+	for (; start <= stop; ++start)
+		if (vs_change(sp, start, LINE_RESET))
+			return (1);
+	return (0);
+}
+
 /*
  * vs_sm_fill --
  *	Fill in the screen map, placing the specified line at the
@@ -206,7 +225,14 @@ vs_sm_fill(SCR *sp, db_recno_t lno, pos_t pos)
 			goto top;
 		}
 
-		/* See if less than half a screen from the bottom. */
+		/*
+		 * See if less than half a screen from the bottom.  Every line
+		 * takes at least one screen line, so if there are more than
+		 * half a screen of lines after it, it's not, and there's no
+		 * need to find the last line.
+		 */
+		if (db_exist(sp, lno + HALFTEXT(sp) + 1))
+			goto middle;
 		if (db_last(sp, &tmp.lno))
 			return (1);
 		tmp.coff = 0;
@@ -799,6 +825,7 @@ vs_deleteln(SCR *sp, int cnt)
 			(void)gp->scr_move(sp, LASTLINE(sp), 0);
 			(void)gp->scr_insertln(sp);
 			(void)gp->scr_move(sp, oldy, oldx);
+			vs_rscroll(sp, oldy, 1);
 		}
 	}
 	return (0);
@@ -970,6 +997,7 @@ vs_sm_erase(SCR *sp)
 	for (; sp->t_rows > sp->t_minrows; --sp->t_rows, --TMAP) {
 		(void)gp->scr_move(sp, TMAP - HMAP, 0);
 		(void)gp->scr_clrtoeol(sp);
+		vs_rdamage(sp, TMAP - HMAP);
 	}
 	return (0);
 }
@@ -1033,6 +1061,7 @@ vs_insertln(SCR *sp, int cnt)
 			(void)gp->scr_deleteln(sp);
 			(void)gp->scr_move(sp, oldy, oldx);
 			(void)gp->scr_insertln(sp);
+			vs_rscroll(sp, oldy, 0);
 		}
 	}
 	return (0);